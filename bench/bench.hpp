@@ -0,0 +1,50 @@
+#ifndef THENABLE_BENCH_HPP_INCLUDED
+#define THENABLE_BENCH_HPP_INCLUDED
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+/*
+ * Runs f once to warm up, then the given number of times, and prints the average time per operation,
+ * where each call of f does batch operations. The sum of whatever f returns is printed too, so the compiler can't drop the work.
+ * */
+template <typename Functor>
+inline double measure_batch( const char *name, long iterations, long batch, Functor &&f ) {
+    long sink = static_cast<long>( f( 0 ));
+
+    auto start = std::chrono::steady_clock::now();
+
+    for( long i = 0; i < iterations; ++i ) {
+        sink += static_cast<long>( f( i ));
+    }
+
+    double ns = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count() / ( iterations * batch );
+
+    std::printf( "%-48s %12.1f ns   (%ld)\n", name, ns, sink );
+
+    return ns;
+}
+
+template <typename Functor>
+inline double measure( const char *name, long iterations, Functor &&f ) {
+    return measure_batch( name, iterations, 1, std::forward<Functor>( f ));
+}
+
+/*
+ * Lets the iteration count be scaled down from the command line for quick runs
+ * */
+inline long scaled( int argc, char **argv, long iterations ) {
+    if( argc > 1 ) {
+        double scale = std::atof( argv[1] );
+
+        if( scale > 0 ) {
+            iterations = static_cast<long>( iterations * scale );
+        }
+    }
+
+    return iterations > 0 ? iterations : 1;
+}
+
+#endif //THENABLE_BENCH_HPP_INCLUDED
@@ -0,0 +1,97 @@
+#include <thenable/experimental.hpp>
+
+#include "bench.hpp"
+
+#include <atomic>
+#include <new>
+
+using namespace thenable;
+using namespace thenable::experimental;
+
+static std::atomic<long> allocated{ 0 };
+
+void *operator new( std::size_t n ) {
+    allocated.fetch_add( static_cast<long>( n ), std::memory_order_relaxed );
+
+    if( void *p = std::malloc( n ? n : 1 )) {
+        return p;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete( void *p ) noexcept {
+    std::free( p );
+}
+
+void operator delete( void *p, std::size_t ) noexcept {
+    std::free( p );
+}
+
+/*
+ * The memory held by a large number of pending futures, and the time to check all of them
+ * */
+template <typename Promise, typename Future>
+static void pending( const char *name, long count ) {
+    std::vector<Promise> ps;
+    std::vector<Future>  fs;
+
+    ps.reserve( count );
+    fs.reserve( count );
+
+    long before = allocated.load();
+
+    for( long i = 0; i < count; ++i ) {
+        ps.emplace_back();
+
+        fs.push_back( ps.back().get_future());
+    }
+
+    double bytes = double( allocated.load() - before ) / count;
+
+    auto start = std::chrono::steady_clock::now();
+
+    long ready = 0;
+
+    for( auto &f : fs ) {
+        ready += f.is_ready();
+    }
+
+    double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+
+    std::printf( "%-16s %2zu byte handle, %6.1f heap bytes per pending future, is_ready over all %6.2f ms (%ld)\n",
+                 name, sizeof( Future ), bytes, ms, ready );
+}
+
+int main( int argc, char **argv ) {
+    const long count = scaled( argc, argv, 1000000 );
+
+    std::printf( "%ld pending futures:\n", count );
+
+    pending<ThenablePromise<int>, ThenableFuture<int>>( "ThenableFuture", count );
+    pending<compact_promise<int>, compact_future<int>>( "compact_future", count );
+
+    const long iterations = scaled( argc, argv, 200000 );
+
+    std::printf( "\n" );
+
+    measure( "ThenablePromise, set_value, get", iterations, []( long i ) {
+        ThenablePromise<long> p;
+
+        auto f = p.get_future();
+
+        p.set_value( i );
+
+        return f.get();
+    } );
+
+    measure( "compact_promise, set_value, get", iterations, []( long i ) {
+        compact_promise<long> p;
+
+        auto f = p.get_future();
+
+        p.set_value( i );
+
+        return f.get();
+    } );
+}
@@ -0,0 +1,40 @@
+#include <thenable/thenable.hpp>
+
+#include "bench.hpp"
+
+using namespace thenable;
+
+/*
+ * Builds a deferred chain of a million thens and evaluates it, which used to need one stack frame per then
+ * */
+int main( int argc, char **argv ) {
+    const long length = scaled( argc, argv, 1000000 );
+
+    std::printf( "a deferred chain of %ld thens, per then:\n", length );
+
+    measure_batch( "build, resolve and evaluate", 3, length, [&]( long ) {
+        ThenablePromise<long> p;
+
+        ThenableFuture<long> f = p.get_future();
+
+        for( long i = 0; i < length; ++i ) {
+            f = f.then( []( long x ) { return x + 1; }, std::launch::deferred );
+        }
+
+        p.set_value( 0 );
+
+        return f.get();
+    } );
+
+    measure_batch( "build and release without running", 3, length, [&]( long ) {
+        ThenablePromise<long> p;
+
+        ThenableFuture<long> f = p.get_future();
+
+        for( long i = 0; i < length; ++i ) {
+            f = f.then( []( long x ) { return x + 1; }, std::launch::deferred );
+        }
+
+        return 0;
+    } );
+}
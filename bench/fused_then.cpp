@@ -0,0 +1,85 @@
+#include <thenable/thenable.hpp>
+
+#include "bench.hpp"
+
+#include <atomic>
+#include <new>
+
+using namespace thenable;
+
+static std::atomic<long> allocations{ 0 };
+
+void *operator new( std::size_t n ) {
+    allocations.fetch_add( 1, std::memory_order_relaxed );
+
+    if( void *p = std::malloc( n ? n : 1 )) {
+        return p;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete( void *p ) noexcept {
+    std::free( p );
+}
+
+void operator delete( void *p, std::size_t ) noexcept {
+    std::free( p );
+}
+
+/*
+ * A chain of k thens on a pending promise, which is then resolved
+ * */
+template <typename LaunchPolicy>
+static long chain( long i, int k, LaunchPolicy policy ) {
+    ThenablePromise<long> p;
+
+    ThenableFuture<long> f = p.get_future();
+
+    for( int j = 0; j < k; ++j ) {
+        f = f.then( []( long x ) { return x + 1; }, policy );
+    }
+
+    p.set_value( i );
+
+    return f.get();
+}
+
+/*
+ * The heap allocations and time taken by one more then in the chain
+ * */
+template <typename LaunchPolicy>
+static void stage( const char *name, long iterations, LaunchPolicy policy ) {
+    auto count = [&]( int k ) {
+        chain( 0, k, policy );
+
+        long before = allocations.load();
+
+        for( long i = 0; i < iterations; ++i ) {
+            chain( i, k, policy );
+        }
+
+        return double( allocations.load() - before ) / iterations;
+    };
+
+    double per_stage = count( 5 ) - count( 4 );
+
+    auto start = std::chrono::steady_clock::now();
+
+    for( long i = 0; i < iterations; ++i ) {
+        chain( i, 8, policy );
+    }
+
+    double ns = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count() / ( iterations * 8 );
+
+    std::printf( "%-32s %6.2f heap allocations, %8.1f ns per then\n", name, per_stage, ns );
+}
+
+int main( int argc, char **argv ) {
+    const long iterations = scaled( argc, argv, 20000 );
+
+    stage( "then_launch::immediate", iterations, then_launch::immediate );
+    stage( "default policy", iterations, std::launch( default_policy ));
+    stage( "std::launch::deferred", iterations, std::launch::deferred );
+    stage( "then_launch::detached", iterations / 10, then_launch::detached );
+}
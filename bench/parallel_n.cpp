@@ -0,0 +1,43 @@
+#include <thenable/experimental.hpp>
+
+#include "bench.hpp"
+
+using namespace thenable;
+
+/*
+ * The cost of a parallel_n call, for a growing number of trivial functors
+ * */
+template <size_t... I>
+void run( long iterations, std::index_sequence<I...> ) {
+    char name[64];
+
+    auto f = [] { return 1; };
+
+    std::snprintf( name, sizeof( name ), "parallel_n, %zu functors", sizeof...( I ));
+
+    measure( name, iterations, [&]( long ) {
+        auto t = parallel_n( 8, ( (void) I, f )... );
+
+        int results[] = { std::get<I>( t ).get()... };
+
+        return results[0];
+    } );
+
+    std::snprintf( name, sizeof( name ), "parallel_n with participate, %zu functors", sizeof...( I ));
+
+    measure( name, iterations, [&]( long ) {
+        auto t = parallel_n( participate, 8, ( (void) I, f )... );
+
+        int results[] = { std::get<I>( t ).get()... };
+
+        return results[0];
+    } );
+}
+
+int main( int argc, char **argv ) {
+    const long iterations = scaled( argc, argv, 2000 );
+
+    run( iterations, std::make_index_sequence<2>());
+    run( iterations, std::make_index_sequence<8>());
+    run( iterations, std::make_index_sequence<64>());
+}
@@ -0,0 +1,53 @@
+#include <thenable/thenable.hpp>
+
+#include "bench.hpp"
+
+using namespace thenable;
+
+/*
+ * then on a future that is already resolved, starting from a promise and from make_ready_future.
+ * Only then_launch::immediate runs the callback inline, the default policy still launches it.
+ * */
+int main( int argc, char **argv ) {
+    const long iterations = scaled( argc, argv, 200000 );
+
+    measure( "resolved promise, then, get", iterations, []( long i ) {
+        ThenablePromise<long> p;
+
+        p.set_value( i );
+
+        return p.get_future().then( []( long x ) { return x + 1; } ).get();
+    } );
+
+    measure( "resolved promise, immediate then, get", iterations, []( long i ) {
+        ThenablePromise<long> p;
+
+        p.set_value( i );
+
+        return p.get_future().then( []( long x ) { return x + 1; }, then_launch::immediate ).get();
+    } );
+
+    measure( "resolved promise, three immediate thens, get", iterations, []( long i ) {
+        ThenablePromise<long> p;
+
+        p.set_value( i );
+
+        return p.get_future().then( []( long x ) { return x + 1; }, then_launch::immediate )
+                .then( []( long x ) { return x * 2; }, then_launch::immediate )
+                .then( []( long x ) { return x - 1; }, then_launch::immediate ).get();
+    } );
+
+    measure( "make_ready_future, then, get", iterations, []( long i ) {
+        return make_ready_future( i ).then( []( long x ) { return x + 1; } ).get();
+    } );
+
+    measure( "make_ready_future, immediate then, get", iterations, []( long i ) {
+        return make_ready_future( i ).then( []( long x ) { return x + 1; }, then_launch::immediate ).get();
+    } );
+
+    measure( "make_ready_future, three immediate thens, get", iterations, []( long i ) {
+        return make_ready_future( i ).then( []( long x ) { return x + 1; }, then_launch::immediate )
+                                     .then( []( long x ) { return x * 2; }, then_launch::immediate )
+                                     .then( []( long x ) { return x - 1; }, then_launch::immediate ).get();
+    } );
+}
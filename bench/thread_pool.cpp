@@ -0,0 +1,102 @@
+#include <thenable/experimental.hpp>
+
+#include "bench.hpp"
+
+using namespace thenable;
+using experimental::ThreadPool;
+
+/*
+ * Compares running many small tasks on the work-stealing pool against
+ * a thread per task, and continuations on the pool against the launch policies.
+ * */
+int main( int argc, char **argv ) {
+    const long tasks  = scaled( argc, argv, 100000 );
+    const long rounds = scaled( argc, argv, 10 );
+
+    const size_t threads = std::max<size_t>( std::thread::hardware_concurrency(), 2 );
+
+    ThreadPool pool( threads );
+
+    std::printf( "%ld tasks per round on %zu threads, per task:\n", tasks, threads );
+
+    measure_batch( "ThreadPool, submitted from outside", rounds, tasks, [&]( long ) {
+        std::atomic<long> done{ 0 };
+
+        for( long i = 0; i < tasks; ++i ) {
+            pool.submit( [&done] { done.fetch_add( 1, std::memory_order_relaxed ); } );
+        }
+
+        while( done.load() != tasks ) {
+            std::this_thread::yield();
+        }
+
+        return 0;
+    } );
+
+    measure_batch( "ThreadPool, submitted from a worker", rounds, tasks, [&]( long ) {
+        std::atomic<long> done{ 0 };
+
+        pool.submit( [&] {
+            for( long i = 0; i < tasks; ++i ) {
+                pool.submit( [&done] { done.fetch_add( 1, std::memory_order_relaxed ); } );
+            }
+        } );
+
+        while( done.load() != tasks ) {
+            std::this_thread::yield();
+        }
+
+        return 0;
+    } );
+
+    //Ten times fewer, or this would take all day
+    measure_batch( "std::async, a thread per task", rounds, tasks / 10, [&]( long ) {
+        std::vector<std::future<void>> fs;
+
+        fs.reserve( tasks / 10 );
+
+        for( long i = 0; i < tasks / 10; ++i ) {
+            fs.push_back( std::async( std::launch::async, [] {} ));
+        }
+
+        for( auto &f : fs ) {
+            f.get();
+        }
+
+        return 0;
+    } );
+
+    const long chains = scaled( argc, argv, 20000 );
+
+    std::printf( "\na pending promise and a then, per chain:\n" );
+
+    measure( "then on the pool", chains, [&]( long i ) {
+        ThenablePromise<long> p;
+
+        auto f = p.get_future().then( []( long x ) { return x + 1; }, pool );
+
+        p.set_value( i );
+
+        return f.get();
+    } );
+
+    measure( "then_launch::detached", chains, [&]( long i ) {
+        ThenablePromise<long> p;
+
+        auto f = p.get_future().then( []( long x ) { return x + 1; }, then_launch::detached );
+
+        p.set_value( i );
+
+        return f.get();
+    } );
+
+    measure( "std::launch::async", chains / 10, [&]( long i ) {
+        ThenablePromise<long> p;
+
+        auto f = p.get_future().then( []( long x ) { return x + 1; }, std::launch::async );
+
+        p.set_value( i );
+
+        return f.get();
+    } );
+}
@@ -0,0 +1,89 @@
+#include <thenable/experimental.hpp>
+
+#include "bench.hpp"
+
+#include <functional>
+
+using namespace thenable;
+
+template <typename Task>
+inline void call( Task &t ) {
+    t();
+}
+
+inline void call( detail::continuation_ptr &t ) {
+    t->run();
+}
+
+/*
+ * Queues 64 tasks capturing two shared_ptrs and a reference, then runs and destroys them in order,
+ * which is what the internal queues do with every callback
+ * */
+template <typename Queue, typename Make>
+static void queue( const char *name, long iterations, Make make ) {
+    auto a = std::make_shared<int>( 0 ), b = std::make_shared<int>( 0 );
+
+    Queue q;
+
+    measure_batch( name, iterations, 64, [&]( long ) {
+        long sum = 0;
+
+        for( int i = 0; i < 64; ++i ) {
+            q.push_back( make( sum, a, b ));
+        }
+
+        for( auto &task : q ) {
+            auto t = std::move( task );
+
+            call( t );
+        }
+
+        q.clear();
+
+        return sum;
+    } );
+}
+
+int main( int argc, char **argv ) {
+    const long iterations = scaled( argc, argv, 20000 );
+
+    typedef std::shared_ptr<int> ptr;
+
+    std::printf( "queueing and running a task, per task:\n" );
+
+    queue<std::vector<detail::unique_task>>( "unique_task", iterations, []( long &s, ptr a, ptr b ) {
+        return detail::unique_task( [&s, a, b] { ++s; } );
+    } );
+
+    queue<std::vector<std::function<void()>>>( "std::function", iterations, []( long &s, ptr a, ptr b ) {
+        return std::function<void()>( [&s, a, b] { ++s; } );
+    } );
+
+    queue<std::vector<std::packaged_task<void()>>>( "std::packaged_task", iterations, []( long &s, ptr a, ptr b ) {
+        return std::packaged_task<void()>( [&s, a, b] { ++s; } );
+    } );
+
+    queue<std::vector<detail::continuation_ptr>>( "pooled continuation", iterations, []( long &s, ptr a, ptr b ) {
+        return detail::make_continuation( [&s, a, b] { ++s; } );
+    } );
+
+    const long tasks = scaled( argc, argv, 1000000 );
+
+    std::printf( "\nsubmitting to the thread pool from outside, per task:\n" );
+
+    measure_batch( "ThreadPool::submit", 1, tasks, [&]( long ) {
+        std::atomic<long> n{ 0 };
+
+        auto a = std::make_shared<int>( 0 );
+
+        {
+            experimental::ThreadPool pool( 2 );
+
+            for( long i = 0; i < tasks; ++i ) {
+                pool.submit( [&n, a] { n.fetch_add( 1, std::memory_order_relaxed ); } );
+            }
+        }
+
+        return n.load();
+    } );
+}
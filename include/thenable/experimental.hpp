@@ -11,11 +11,1520 @@
 #include <algorithm>
 #include <utility>
 #include <initializer_list>
+#include <vector>
+#include <deque>
+#include <random>
+#include <cstdint>
+
+#if defined( __unix__ ) && defined( __has_include )
+#if __has_include( <ucontext.h> ) && __has_include( <sys/mman.h> ) && __has_include( <unistd.h> )
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+//FiberPool is only defined where ucontext and mmap are available
+#define THENABLE_HAS_FIBERS
+#endif
+#endif
 
 namespace thenable {
     namespace experimental {
         namespace detail {
             using namespace ::thenable::detail;
+
+            /*
+             * chase_lev_deque class
+             *
+             * The work-stealing deque from "Dynamic Circular Work-Stealing Deque" by Chase and Lev, using the
+             * C11 memory orderings from "Correct and Efficient Work-Stealing for Weak Memory Models" by Lê et al.
+             *
+             * Only the owning thread may push and take from the bottom, while any thread can steal from the top.
+             * Old buffers are kept around until the deque is destroyed, since a thief may still be reading from one.
+             * */
+            template <typename T>
+            class chase_lev_deque {
+                    static_assert( std::is_trivially_copyable<T>::value, "chase_lev_deque can only hold trivially copyable values" );
+
+                    struct buffer {
+                        const std::int64_t                capacity;
+                        std::unique_ptr<std::atomic<T>[]> items;
+
+                        inline explicit buffer( std::int64_t c ) : capacity( c ), items( new std::atomic<T>[c] ) {}
+
+                        inline T get( std::int64_t i ) const THENABLE_NOEXCEPT {
+                            return items[i & ( capacity - 1 )].load( std::memory_order_relaxed );
+                        }
+
+                        inline void put( std::int64_t i, T x ) THENABLE_NOEXCEPT {
+                            items[i & ( capacity - 1 )].store( x, std::memory_order_relaxed );
+                        }
+                    };
+
+                    //Padded rather than aligned so C++14 operator new doesn't have to honor extended alignment
+                    std::atomic<std::int64_t> top;
+                    char                      top_padding[64 - sizeof( std::atomic<std::int64_t> )];
+                    std::atomic<std::int64_t> bottom;
+                    char                      bottom_padding[64 - sizeof( std::atomic<std::int64_t> )];
+                    std::atomic<buffer *>     array;
+
+                    std::vector<std::unique_ptr<buffer>> buffers;
+
+                    inline buffer *grow( buffer *a, std::int64_t b, std::int64_t t ) {
+                        buffers.emplace_back( new buffer( a->capacity * 2 ));
+
+                        buffer *grown = buffers.back().get();
+
+                        for( std::int64_t i = t; i < b; ++i ) {
+                            grown->put( i, a->get( i ));
+                        }
+
+                        array.store( grown, std::memory_order_release );
+
+                        return grown;
+                    }
+
+                public:
+                    inline explicit chase_lev_deque( std::int64_t capacity = 256 ) : top( 0 ), bottom( 0 ) {
+                        buffers.emplace_back( new buffer( capacity ));
+
+                        array.store( buffers.back().get(), std::memory_order_relaxed );
+                    }
+
+                    chase_lev_deque( const chase_lev_deque & ) = delete;
+
+                    chase_lev_deque &operator=( const chase_lev_deque & ) = delete;
+
+                    inline void push( T x ) {
+                        std::int64_t b = bottom.load( std::memory_order_relaxed );
+                        std::int64_t t = top.load( std::memory_order_acquire );
+                        buffer       *a = array.load( std::memory_order_relaxed );
+
+                        if( b - t > a->capacity - 1 ) {
+                            a = grow( a, b, t );
+                        }
+
+                        a->put( b, x );
+
+                        std::atomic_thread_fence( std::memory_order_release );
+
+                        bottom.store( b + 1, std::memory_order_relaxed );
+                    }
+
+                    inline bool take( T &x ) THENABLE_NOEXCEPT {
+                        std::int64_t b = bottom.load( std::memory_order_relaxed ) - 1;
+                        buffer       *a = array.load( std::memory_order_relaxed );
+
+                        bottom.store( b, std::memory_order_relaxed );
+
+                        std::atomic_thread_fence( std::memory_order_seq_cst );
+
+                        std::int64_t t = top.load( std::memory_order_relaxed );
+
+                        if( t > b ) {
+                            bottom.store( b + 1, std::memory_order_relaxed );
+
+                            return false;
+                        }
+
+                        x = a->get( b );
+
+                        if( t == b ) {
+                            //Last item, so race any thieves for it
+                            bool won = top.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed );
+
+                            bottom.store( b + 1, std::memory_order_relaxed );
+
+                            return won;
+                        }
+
+                        return true;
+                    }
+
+                    inline bool steal( T &x ) THENABLE_NOEXCEPT {
+                        std::int64_t t = top.load( std::memory_order_acquire );
+
+                        std::atomic_thread_fence( std::memory_order_seq_cst );
+
+                        std::int64_t b = bottom.load( std::memory_order_acquire );
+
+                        if( t < b ) {
+                            buffer *a = array.load( std::memory_order_acquire );
+
+                            x = a->get( t );
+
+                            return top.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed );
+                        }
+
+                        return false;
+                    }
+
+                    inline bool empty() const THENABLE_NOEXCEPT {
+                        return bottom.load( std::memory_order_relaxed ) <= top.load( std::memory_order_relaxed );
+                    }
+            };
+        }
+
+        /*
+         * ThreadPool class
+         *
+         * A fixed-size thread pool that satisfies the Executor concept, so it can be given to then, await_all, parallel_n and so forth.
+         *
+         * Each worker has its own Chase-Lev deque. Tasks submitted from inside a worker go onto that worker's deque, while tasks from
+         * anywhere else go onto a shared injection queue, which holds small tasks inline. Idle workers steal from the top of a randomly chosen worker's deque, and
+         * only go to sleep once there is nothing left anywhere.
+         *
+         * Destroying the pool runs every task that was already submitted before joining the workers.
+         * */
+        class ThreadPool {
+                typedef ::thenable::detail::continuation task_type;
+                typedef ::thenable::detail::unique_task  queued_task;
+
+                struct worker {
+                    detail::chase_lev_deque<task_type *> tasks;
+                };
+
+                std::vector<std::unique_ptr<worker>> workers;
+                std::vector<std::thread>             threads;
+
+                std::mutex              inject_mtx;
+                std::deque<queued_task> injected;
+                std::atomic_size_t      injected_count;
+
+                std::mutex              sleep_mtx;
+                std::condition_variable sleep_cv;
+                std::atomic_size_t      sleeping;
+                std::atomic_bool        stopping;
+
+                struct worker_context {
+                    ThreadPool *pool;
+                    size_t     index;
+                };
+
+                static inline worker_context &current() THENABLE_NOEXCEPT {
+                    static thread_local worker_context context{ nullptr, 0 };
+
+                    return context;
+                }
+
+                static inline std::uint32_t next_random() THENABLE_NOEXCEPT {
+                    static thread_local std::uint32_t state = std::random_device()() | 1u;
+
+                    //xorshift32
+                    state ^= state << 13;
+                    state ^= state >> 17;
+                    state ^= state << 5;
+
+                    return state;
+                }
+
+                inline bool pop_injected( queued_task &task ) {
+                    if( injected_count.load( std::memory_order_relaxed ) == 0 ) {
+                        return false;
+                    }
+
+                    std::lock_guard<std::mutex> lock( inject_mtx );
+
+                    if( injected.empty()) {
+                        return false;
+                    }
+
+                    task = std::move( injected.front());
+
+                    injected.pop_front();
+
+                    injected_count.fetch_sub( 1, std::memory_order_relaxed );
+
+                    return true;
+                }
+
+                inline bool find_task( size_t index, queued_task &task ) {
+                    task_type *t = nullptr;
+
+                    if( workers[index]->tasks.take( t )) {
+                        task = ::thenable::detail::continuation_ptr( t );
+
+                        return true;
+                    }
+
+                    if( pop_injected( task )) {
+                        return true;
+                    }
+
+                    const size_t count = workers.size();
+
+                    for( size_t i = 0, victim = next_random() % count; i < count; ++i, victim = ( victim + 1 ) % count ) {
+                        if( victim != index && workers[victim]->tasks.steal( t )) {
+                            task = ::thenable::detail::continuation_ptr( t );
+
+                            return true;
+                        }
+                    }
+
+                    return false;
+                }
+
+                inline bool has_work() {
+                    if( injected_count.load( std::memory_order_relaxed ) != 0 ) {
+                        return true;
+                    }
+
+                    for( auto &w : workers ) {
+                        if( !w->tasks.empty()) {
+                            return true;
+                        }
+                    }
+
+                    return false;
+                }
+
+                /*
+                 * Pairs with the fence in worker_loop so either the submitter sees the sleeping worker, or the worker sees the new task
+                 * */
+                inline void wake_one() {
+                    std::atomic_thread_fence( std::memory_order_seq_cst );
+
+                    if( sleeping.load( std::memory_order_relaxed ) != 0 ) {
+                        std::lock_guard<std::mutex> lock( sleep_mtx );
+
+                        sleep_cv.notify_one();
+                    }
+                }
+
+                inline void worker_loop( size_t index ) THENABLE_NOEXCEPT {
+                    current() = worker_context{ this, index };
+
+                    queued_task task;
+
+                    while( true ) {
+                        if( find_task( index, task )) {
+                            task();
+                            task.reset();
+
+                            continue;
+                        }
+
+                        std::unique_lock<std::mutex> lock( sleep_mtx );
+
+                        sleeping.fetch_add( 1, std::memory_order_relaxed );
+
+                        std::atomic_thread_fence( std::memory_order_seq_cst );
+
+                        if( !has_work()) {
+                            if( stopping.load()) {
+                                sleeping.fetch_sub( 1, std::memory_order_relaxed );
+
+                                break;
+                            }
+
+                            sleep_cv.wait( lock );
+                        }
+
+                        sleeping.fetch_sub( 1, std::memory_order_relaxed );
+                    }
+
+                    current() = worker_context{ nullptr, 0 };
+                }
+
+            public:
+                inline explicit ThreadPool( size_t count = std::thread::hardware_concurrency())
+                    : injected_count( 0 ), sleeping( 0 ), stopping( false ) {
+
+                    count = std::max<size_t>( count, 1 );
+
+                    for( size_t i = 0; i < count; ++i ) {
+                        workers.emplace_back( new worker());
+                    }
+
+                    for( size_t i = 0; i < count; ++i ) {
+                        threads.emplace_back( [this, i] {
+                            worker_loop( i );
+                        } );
+                    }
+                }
+
+                ThreadPool( const ThreadPool & ) = delete;
+
+                ThreadPool &operator=( const ThreadPool & ) = delete;
+
+                inline ~ThreadPool() {
+                    {
+                        std::lock_guard<std::mutex> lock( sleep_mtx );
+
+                        stopping.store( true );
+
+                        sleep_cv.notify_all();
+                    }
+
+                    for( auto &t : threads ) {
+                        t.join();
+                    }
+                }
+
+                inline size_t size() const THENABLE_NOEXCEPT {
+                    return workers.size();
+                }
+
+                /*
+                 * Returns true if the calling thread is one of this pool's workers
+                 * */
+                inline bool is_worker() const THENABLE_NOEXCEPT {
+                    return current().pool == this;
+                }
+
+                template <typename Task>
+                inline void submit( Task &&task ) {
+                    worker_context &context = current();
+
+                    if( context.pool == this ) {
+                        //The deque can only hold pointers, so these still need a continuation
+                        auto t = ::thenable::detail::make_continuation( std::forward<Task>( task ));
+
+                        workers[context.index]->tasks.push( t.get());
+
+                        t.release();
+
+                    } else {
+                        queued_task t( std::forward<Task>( task ));
+
+                        std::lock_guard<std::mutex> lock( inject_mtx );
+
+                        injected.push_back( std::move( t ));
+
+                        injected_count.fetch_add( 1, std::memory_order_relaxed );
+                    }
+
+                    wake_one();
+                }
+        };
+
+#ifdef THENABLE_HAS_FIBERS
+
+        //////////
+
+        /*
+         * The usable size of each fiber's stack, not counting its guard page, and how many finished fibers a FiberPool keeps around
+         * with their stacks for reuse
+         * */
+#ifdef THENABLE_FIBER_STACK_SIZE
+        constexpr size_t fiber_stack_size = THENABLE_FIBER_STACK_SIZE;
+#else
+        constexpr size_t fiber_stack_size = 256 * 1024;
+#endif
+
+#ifdef THENABLE_FIBER_CACHED_STACKS
+        constexpr size_t fiber_cached_stacks = THENABLE_FIBER_CACHED_STACKS;
+#else
+        constexpr size_t fiber_cached_stacks = 64;
+#endif
+
+        /*
+         * FiberPool class
+         *
+         * A fixed number of threads that run every submitted task as a fiber, and satisfies the Executor concept like ThreadPool.
+         *
+         * Each worker installs a wait_hook, so when a task calls get() or wait() on a ThenableFuture or ThenableSharedFuture that isn't
+         * ready, only its fiber is suspended and the worker goes on to run other fibers. It's resumed by a continuation once the future
+         * is resolved, so thousands of blocked tasks only need as many threads as the pool has. wait_for and wait_until still block.
+         *
+         * A fiber always runs on the worker that started it, so thread_locals stay valid across waits. Stacks are mapped with an
+         * inaccessible guard page below them, so overflowing one faults instead of corrupting memory, and finished fibers are
+         * kept with their stacks for reuse. Each stack counts twice against the system's limit on memory mappings, and a task
+         * that can't get a fiber is run directly on the worker, blocking it like any other thread.
+         *
+         * Destroying the pool waits for every submitted task to finish, including any that are suspended.
+         * */
+        class FiberPool {
+                typedef ::thenable::detail::unique_task       queued_task;
+                typedef ::thenable::detail::shared_state_base state_type;
+
+                struct worker;
+
+                struct fiber {
+                    ucontext_t        context;
+                    void              *stack;
+                    size_t            stack_size;
+                    queued_task       task;
+                    worker            *owner    = nullptr;
+                    fiber             *next     = nullptr;
+                    std::atomic_bool  wake{ false };
+                    bool              finished  = false;
+
+                    //Swapped with the worker's own while the fiber runs
+                    ::thenable::detail::thread_state state;
+                };
+
+                struct worker final : ::thenable::detail::wait_hook {
+                    FiberPool               *pool;
+                    ucontext_t              context;
+                    fiber                   *running = nullptr;
+                    std::condition_variable cv;
+                    bool                    sleeping = false;
+                    size_t                  live     = 0;
+
+                    //Fibers ready to be resumed, guarded by the pool's mutex
+                    fiber                   *ready_head = nullptr;
+                    fiber                   *ready_tail = nullptr;
+
+                    inline explicit worker( FiberPool *p ) THENABLE_NOEXCEPT : pool( p ) {}
+
+                    inline void push_ready( fiber *f ) THENABLE_NOEXCEPT {
+                        f->next = nullptr;
+
+                        if( ready_tail ) {
+                            ready_tail->next = f;
+
+                        } else {
+                            ready_head = f;
+                        }
+
+                        ready_tail = f;
+                    }
+
+                    inline fiber *pop_ready() THENABLE_NOEXCEPT {
+                        fiber *f = ready_head;
+
+                        if( f ) {
+                            ready_head = f->next;
+
+                            if( !ready_head ) {
+                                ready_tail = nullptr;
+                            }
+                        }
+
+                        return f;
+                    }
+
+                    /*
+                     * The continuation and the worker race to set wake once the fiber has switched out, and whichever is second
+                     * makes it ready again. If the state was resolved before the fiber got that far, it just doesn't switch out.
+                     * */
+                    void suspend( state_type &s ) override {
+                        fiber     *f = running;
+                        FiberPool *p = pool;
+
+                        f->wake.store( false, std::memory_order_relaxed );
+
+                        auto d = s.add_continuation( ::thenable::detail::make_continuation( [p, f]() THENABLE_NOEXCEPT {
+                            if( f->wake.exchange( true, std::memory_order_acq_rel )) {
+                                p->resume( f );
+                            }
+                        } ));
+
+                        if( d ) {
+                            state_type::run_deferred( std::move( d ));
+                        }
+
+                        if( !f->wake.load( std::memory_order_acquire )) {
+                            swapcontext( &f->context, &context );
+                        }
+                    }
+                };
+
+                std::vector<std::unique_ptr<worker>> workers;
+                std::vector<std::thread>             threads;
+
+                std::mutex              mtx;
+                std::deque<queued_task> tasks;
+                std::vector<fiber *>    idle;
+                bool                    stopping = false;
+
+                const size_t page_size;
+
+                static inline void entry() THENABLE_NOEXCEPT {
+                    fiber *f = static_cast<worker *>( ::thenable::detail::wait_hook::current())->running;
+
+                    f->task();
+                    f->task.reset();
+
+                    f->finished = true;
+
+                    //Returning switches back to the owning worker through uc_link
+                }
+
+                inline fiber *make_fiber() {
+                    const size_t size = ( fiber_stack_size + page_size - 1 ) / page_size * page_size + page_size;
+
+                    void *stack = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0 );
+
+                    if( stack == MAP_FAILED ) {
+                        throw std::bad_alloc();
+                    }
+
+                    //Stacks grow down, so the guard page is the lowest one
+                    if( mprotect( stack, page_size, PROT_NONE ) != 0 ) {
+                        munmap( stack, size );
+
+                        throw std::bad_alloc();
+                    }
+
+                    fiber *f;
+
+                    try {
+                        f = new fiber();
+
+                    } catch( ... ) {
+                        munmap( stack, size );
+
+                        throw;
+                    }
+
+                    f->stack      = stack;
+                    f->stack_size = size;
+
+                    return f;
+                }
+
+                static inline void destroy_fiber( fiber *f ) THENABLE_NOEXCEPT {
+                    munmap( f->stack, f->stack_size );
+
+                    delete f;
+                }
+
+                inline void resume( fiber *f ) THENABLE_NOEXCEPT {
+                    std::lock_guard<std::mutex> lock( mtx );
+
+                    f->owner->push_ready( f );
+
+                    f->owner->cv.notify_one();
+                }
+
+                /*
+                 * Takes a cached fiber, or makes a new one without holding the lock. Returns null if it couldn't be made.
+                 * */
+                inline fiber *acquire_fiber( std::unique_lock<std::mutex> &lock ) THENABLE_NOEXCEPT {
+                    if( !idle.empty()) {
+                        fiber *f = idle.back();
+
+                        idle.pop_back();
+
+                        return f;
+                    }
+
+                    lock.unlock();
+
+                    fiber *f = nullptr;
+
+                    try {
+                        f = make_fiber();
+
+                    } catch( ... ) {}
+
+                    lock.lock();
+
+                    return f;
+                }
+
+                inline void release_fiber( fiber *f ) THENABLE_NOEXCEPT {
+                    f->finished = false;
+
+                    if( idle.size() < fiber_cached_stacks ) {
+                        try {
+                            idle.push_back( f );
+
+                            return;
+
+                        } catch( ... ) {}
+                    }
+
+                    destroy_fiber( f );
+                }
+
+                /*
+                 * The context switches are kept out of worker_loop, so none of its locals are live across them
+                 * */
+                inline void prepare( worker &w, fiber *f ) THENABLE_NOEXCEPT {
+                    getcontext( &f->context );
+
+                    f->owner = &w;
+
+                    f->context.uc_stack.ss_sp   = static_cast<char *>( f->stack ) + page_size;
+                    f->context.uc_stack.ss_size = f->stack_size - page_size;
+                    f->context.uc_link          = &w.context;
+
+                    makecontext( &f->context, &FiberPool::entry, 0 );
+                }
+
+                /*
+                 * A fiber can suspend in the middle of an immediate callback or a release, so it takes its own trampolines
+                 * and memory resource with it instead of leaving them raised for the next fiber on this worker.
+                 * */
+                static inline void run( worker &w, fiber *f ) THENABLE_NOEXCEPT {
+                    w.running = f;
+
+                    f->state.swap();
+
+                    swapcontext( &w.context, &f->context );
+
+                    f->state.swap();
+
+                    w.running = nullptr;
+                }
+
+                inline void worker_loop( worker &w ) THENABLE_NOEXCEPT {
+                    ::thenable::detail::wait_hook::current() = &w;
+
+                    std::unique_lock<std::mutex> lock( mtx );
+
+                    while( true ) {
+                        fiber *f = w.pop_ready();
+
+                        if( !f && !tasks.empty()) {
+                            f = acquire_fiber( lock );
+
+                            if( tasks.empty()) {
+                                if( f ) {
+                                    release_fiber( f );
+                                }
+
+                                continue;
+                            }
+
+                            queued_task task = std::move( tasks.front());
+
+                            tasks.pop_front();
+
+                            if( !f ) {
+                                //Without a fiber to run it on, the task just blocks this worker like it would anywhere else
+                                lock.unlock();
+
+                                ::thenable::detail::wait_hook::current() = nullptr;
+
+                                task();
+                                task.reset();
+
+                                ::thenable::detail::wait_hook::current() = &w;
+
+                                lock.lock();
+
+                                continue;
+                            }
+
+                            f->task = std::move( task );
+
+                            prepare( w, f );
+
+                            ++w.live;
+                        }
+
+                        if( !f ) {
+                            if( stopping && w.live == 0 ) {
+                                break;
+                            }
+
+                            w.sleeping = true;
+
+                            w.cv.wait( lock );
+
+                            w.sleeping = false;
+
+                            continue;
+                        }
+
+                        lock.unlock();
+
+                        run( w, f );
+
+                        if( f->finished ) {
+                            --w.live;
+
+                            lock.lock();
+
+                            release_fiber( f );
+
+                        } else if( f->wake.exchange( true, std::memory_order_acq_rel )) {
+                            lock.lock();
+
+                            w.push_ready( f );
+
+                        } else {
+                            lock.lock();
+                        }
+                    }
+
+                    ::thenable::detail::wait_hook::current() = nullptr;
+                }
+
+            public:
+                inline explicit FiberPool( size_t count = std::thread::hardware_concurrency())
+                    : page_size( static_cast<size_t>( sysconf( _SC_PAGESIZE ))) {
+
+                    count = std::max<size_t>( count, 1 );
+
+                    for( size_t i = 0; i < count; ++i ) {
+                        workers.emplace_back( new worker( this ));
+                    }
+
+                    for( size_t i = 0; i < count; ++i ) {
+                        threads.emplace_back( [this, i] {
+                            worker_loop( *workers[i] );
+                        } );
+                    }
+                }
+
+                FiberPool( const FiberPool & ) = delete;
+
+                FiberPool &operator=( const FiberPool & ) = delete;
+
+                inline ~FiberPool() {
+                    {
+                        std::lock_guard<std::mutex> lock( mtx );
+
+                        stopping = true;
+
+                        for( auto &w : workers ) {
+                            w->cv.notify_one();
+                        }
+                    }
+
+                    for( auto &t : threads ) {
+                        t.join();
+                    }
+
+                    for( fiber *f : idle ) {
+                        destroy_fiber( f );
+                    }
+                }
+
+                inline size_t size() const THENABLE_NOEXCEPT {
+                    return workers.size();
+                }
+
+                /*
+                 * Returns true if the calling thread is one of this pool's workers
+                 * */
+                inline bool is_worker() const THENABLE_NOEXCEPT {
+                    for( auto &w : workers ) {
+                        if( ::thenable::detail::wait_hook::current() == w.get()) {
+                            return true;
+                        }
+                    }
+
+                    return false;
+                }
+
+                template <typename Task>
+                inline void submit( Task &&task ) {
+                    queued_task t( std::forward<Task>( task ));
+
+                    std::lock_guard<std::mutex> lock( mtx );
+
+                    tasks.push_back( std::move( t ));
+
+                    for( auto &w : workers ) {
+                        if( w->sleeping ) {
+                            w->sleeping = false;
+
+                            w->cv.notify_one();
+
+                            break;
+                        }
+                    }
+                }
+        };
+
+#endif
+
+        //////////
+
+        /*
+         * The number of slots each compact_future slab grows by at a time, and the most chunks a slab can have
+         * */
+#ifdef THENABLE_COMPACT_CHUNK_SIZE
+        constexpr std::uint32_t compact_chunk_size = THENABLE_COMPACT_CHUNK_SIZE;
+#else
+        constexpr std::uint32_t compact_chunk_size = 4096;
+#endif
+
+#ifdef THENABLE_COMPACT_MAX_CHUNKS
+        constexpr std::uint32_t compact_max_chunks = THENABLE_COMPACT_MAX_CHUNKS;
+#else
+        constexpr std::uint32_t compact_max_chunks = 16384;
+#endif
+
+        template <typename T>
+        class compact_promise;
+
+        template <typename T>
+        class compact_future;
+
+        template <typename T>
+        inline ThenableFuture<T> to_thenable( compact_future<T> && );
+
+        namespace detail {
+            /*
+             * compact_storage structure
+             *
+             * The value of a compact slot, constructed in place when its promise is resolved
+             * */
+            template <typename T>
+            struct compact_storage {
+                typename std::aligned_storage<sizeof( T ), alignof( T )>::type storage;
+
+                inline T *ptr() THENABLE_NOEXCEPT {
+                    return reinterpret_cast<T *>(&storage);
+                }
+
+                template <typename U>
+                inline void set( U &&value ) {
+                    new( &storage ) T( std::forward<U>( value ));
+                }
+
+                inline void destroy() THENABLE_NOEXCEPT {
+                    ptr()->~T();
+                }
+
+                inline T take() {
+                    return std::move( *ptr());
+                }
+
+                inline void store( shared_state<T> &s ) {
+                    s.set_value( std::move( *ptr()));
+                }
+            };
+
+            template <>
+            struct compact_storage<void> {
+                inline void set() THENABLE_NOEXCEPT {}
+
+                inline void destroy() THENABLE_NOEXCEPT {}
+
+                inline void take() THENABLE_NOEXCEPT {}
+
+                inline void store( shared_state<void> &s ) {
+                    s.set_value();
+                }
+            };
+
+            template <typename T>
+            struct compact_slot {
+                typedef shared_state_base::status status;
+
+                std::atomic<std::uint32_t> generation{ 1 };
+                std::uint32_t              next_free = 0;
+                std::atomic<status>        st{ status::pending };
+                std::atomic<unsigned char> refs{ 0 };
+                std::exception_ptr         error;
+                continuation_ptr           continuations;
+                compact_storage<T>         value;
+            };
+
+            /*
+             * compact_slab class
+             *
+             * All the states behind the compact futures of one type, in chunks of compact_chunk_size slots that are never freed,
+             * so an index always refers to the same memory. Free slots are linked through their index, and a slot's generation
+             * is bumped every time it's freed so handles to an old occupant are caught.
+             *
+             * Blocking waits and continuations are guarded by a fixed set of striped mutexes rather than one per slot.
+             * The slab is leaked for the same reason as thread_cache.
+             * */
+            template <typename T>
+            class compact_slab {
+                    typedef compact_slot<T>       slot;
+                    typedef typename slot::status status;
+
+                    static constexpr std::uint32_t no_slot = ~std::uint32_t( 0 );
+                    static constexpr size_t        stripes = 64;
+
+                    struct stripe {
+                        std::mutex              mtx;
+                        std::condition_variable cv;
+                    };
+
+                    std::mutex    mtx;
+                    std::uint32_t free_head   = no_slot;
+                    std::uint32_t chunk_count = 0;
+                    slot          *chunks[compact_max_chunks] = {};
+                    stripe        locks[stripes];
+
+                    inline stripe &stripe_of( std::uint32_t i ) THENABLE_NOEXCEPT {
+                        return locks[i % stripes];
+                    }
+
+                    template <typename Setter>
+                    inline void complete( std::uint32_t i, Setter &&setter ) {
+                        slot             &s = at( i );
+                        stripe           &l = stripe_of( i );
+                        continuation_ptr ready;
+
+                        {
+                            std::lock_guard<std::mutex> lock( l.mtx );
+
+                            if( s.st.load( std::memory_order_relaxed ) != status::pending ) {
+                                throw std::future_error( std::future_errc::promise_already_satisfied );
+                            }
+
+                            s.st.store( setter( s ), std::memory_order_release );
+
+                            ready = std::move( s.continuations );
+                        }
+
+                        l.cv.notify_all();
+
+                        run_continuations( std::move( ready ));
+                    }
+
+                public:
+                    static inline compact_slab &instance() {
+                        static compact_slab *slab = new compact_slab();
+
+                        return *slab;
+                    }
+
+                    /*
+                     * Chunks are published before any index into them is handed out, so anything holding an index can read them without locking
+                     * */
+                    inline slot &at( std::uint32_t i ) THENABLE_NOEXCEPT {
+                        return chunks[i / compact_chunk_size][i % compact_chunk_size];
+                    }
+
+                    inline slot &checked( std::uint32_t i, std::uint32_t generation ) {
+                        if( generation == 0 || at( i ).generation.load( std::memory_order_relaxed ) != generation ) {
+                            throw std::future_error( std::future_errc::no_state );
+                        }
+
+                        return at( i );
+                    }
+
+                    inline std::uint32_t allocate() {
+                        std::lock_guard<std::mutex> lock( mtx );
+
+                        if( free_head == no_slot ) {
+                            if( chunk_count == compact_max_chunks ) {
+                                throw std::bad_alloc();
+                            }
+
+                            slot *chunk = new slot[compact_chunk_size];
+
+                            const std::uint32_t first = chunk_count * compact_chunk_size;
+
+                            for( std::uint32_t j = 0; j < compact_chunk_size; ++j ) {
+                                chunk[j].next_free = j + 1 < compact_chunk_size ? first + j + 1 : no_slot;
+                            }
+
+                            chunks[chunk_count++] = chunk;
+
+                            free_head = first;
+                        }
+
+                        const std::uint32_t i = free_head;
+
+                        slot &s = at( i );
+
+                        free_head = s.next_free;
+
+                        s.refs.store( 1, std::memory_order_relaxed );
+
+                        return i;
+                    }
+
+                    inline void retain( std::uint32_t i ) THENABLE_NOEXCEPT {
+                        at( i ).refs.fetch_add( 1, std::memory_order_relaxed );
+                    }
+
+                    inline void release( std::uint32_t i ) THENABLE_NOEXCEPT {
+                        slot &s = at( i );
+
+                        if( s.refs.fetch_sub( 1, std::memory_order_acq_rel ) != 1 ) {
+                            return;
+                        }
+
+                        if( s.st.load( std::memory_order_relaxed ) == status::value ) {
+                            s.value.destroy();
+                        }
+
+                        s.error = nullptr;
+
+                        discard_continuations( std::move( s.continuations ));
+
+                        s.st.store( status::pending, std::memory_order_relaxed );
+
+                        //Zero means no state, so it's skipped when the generation wraps around
+                        std::uint32_t generation = s.generation.load( std::memory_order_relaxed ) + 1;
+
+                        s.generation.store( generation != 0 ? generation : 1, std::memory_order_relaxed );
+
+                        std::lock_guard<std::mutex> lock( mtx );
+
+                        s.next_free = free_head;
+                        free_head   = i;
+                    }
+
+                    inline bool is_ready( std::uint32_t i ) THENABLE_NOEXCEPT {
+                        return at( i ).st.load( std::memory_order_acquire ) != status::pending;
+                    }
+
+                    template <typename... Args>
+                    inline void set_value( std::uint32_t i, Args &&... args ) {
+                        complete( i, [&]( slot &s ) {
+                            s.value.set( std::forward<Args>( args )... );
+
+                            return status::value;
+                        } );
+                    }
+
+                    inline void set_exception( std::uint32_t i, std::exception_ptr e ) {
+                        complete( i, [&]( slot &s ) {
+                            s.error = e;
+
+                            return status::exception;
+                        } );
+                    }
+
+                    inline void wait( std::uint32_t i ) {
+                        if( is_ready( i )) {
+                            return;
+                        }
+
+                        stripe &l = stripe_of( i );
+
+                        std::unique_lock<std::mutex> lock( l.mtx );
+
+                        l.cv.wait( lock, [this, i] { return is_ready( i ); } );
+                    }
+
+                    template <typename Clock, typename Duration>
+                    inline std::future_status wait_until( std::uint32_t i, const std::chrono::time_point<Clock, Duration> &timeout_time ) {
+                        if( is_ready( i )) {
+                            return std::future_status::ready;
+                        }
+
+                        stripe &l = stripe_of( i );
+
+                        std::unique_lock<std::mutex> lock( l.mtx );
+
+                        return l.cv.wait_until( lock, timeout_time, [this, i] { return is_ready( i ); } )
+                               ? std::future_status::ready : std::future_status::timeout;
+                    }
+
+                    /*
+                     * Runs the continuation immediately if the slot is already resolved
+                     * */
+                    inline void add_continuation( std::uint32_t i, continuation_ptr &&c ) {
+                        {
+                            std::lock_guard<std::mutex> lock( stripe_of( i ).mtx );
+
+                            slot &s = at( i );
+
+                            if( s.st.load( std::memory_order_relaxed ) == status::pending ) {
+                                c->next         = std::move( s.continuations );
+                                s.continuations = std::move( c );
+
+                                return;
+                            }
+                        }
+
+                        c->run();
+                    }
+
+                    /*
+                     * take and store must only be called once the slot is ready
+                     * */
+                    inline T take( std::uint32_t i ) {
+                        slot &s = at( i );
+
+                        if( s.st.load( std::memory_order_relaxed ) == status::exception ) {
+                            std::rethrow_exception( s.error );
+                        }
+
+                        return s.value.take();
+                    }
+
+                    inline void store( std::uint32_t i, shared_state<T> &state ) THENABLE_NOEXCEPT {
+                        slot &s = at( i );
+
+                        try {
+                            if( s.st.load( std::memory_order_relaxed ) == status::exception ) {
+                                state.set_exception( s.error );
+
+                            } else {
+                                s.value.store( state );
+                            }
+
+                        } catch( ... ) {
+                            state.set_exception( std::current_exception());
+                        }
+                    }
+            };
+
+            /*
+             * Keeps a slot referenced until the end of a scope, even if taking its value throws
+             * */
+            template <typename T>
+            struct compact_ref {
+                std::uint32_t index;
+
+                inline ~compact_ref() {
+                    compact_slab<T>::instance().release( index );
+                }
+            };
+        }
+
+        /*
+         * compact_promise and compact_future classes
+         *
+         * An opt-in alternative to ThenablePromise and ThenableFuture for holding very many pending results at once. Instead of a pointer to
+         * a shared state of its own, a compact_future is a 32-bit slot index and a generation into a slab of states shared by every
+         * compact_future of the same type, so it fits in a register and the states themselves sit next to each other in memory.
+         *
+         * They can be waited on directly, while then and await_all convert them to ThenableFutures first. References aren't supported.
+         * */
+
+        template <typename T>
+        class compact_promise {
+                static_assert( !std::is_reference<T>::value, "compact_promise does not support references" );
+
+                typedef detail::compact_slab<T> slab_type;
+
+                std::uint32_t index      = 0;
+                std::uint32_t generation = 0;
+                bool          retrieved  = false;
+
+            public:
+                inline compact_promise() {
+                    slab_type &slab = slab_type::instance();
+
+                    index      = slab.allocate();
+                    generation = slab.at( index ).generation.load( std::memory_order_relaxed );
+                }
+
+                inline compact_promise( compact_promise &&p ) THENABLE_NOEXCEPT : index( p.index ), generation( p.generation ), retrieved( p.retrieved ) {
+                    p.generation = 0;
+                }
+
+                compact_promise( const compact_promise & ) = delete;
+
+                compact_promise &operator=( const compact_promise & ) = delete;
+
+                inline compact_promise &operator=( compact_promise &&p ) THENABLE_NOEXCEPT {
+                    compact_promise( std::move( p )).swap( *this );
+
+                    return *this;
+                }
+
+                /*
+                 * Just like ThenablePromise, if it's destroyed without being resolved its future will get a broken_promise error
+                 * */
+                inline ~compact_promise() {
+                    if( generation != 0 ) {
+                        slab_type &slab = slab_type::instance();
+
+                        if( !slab.is_ready( index )) {
+                            slab.set_exception( index, std::make_exception_ptr( std::future_error( std::future_errc::broken_promise )));
+                        }
+
+                        slab.release( index );
+                    }
+                }
+
+                inline void swap( compact_promise &other ) THENABLE_NOEXCEPT {
+                    std::swap( index, other.index );
+                    std::swap( generation, other.generation );
+                    std::swap( retrieved, other.retrieved );
+                }
+
+                inline compact_future<T> get_future() {
+                    slab_type &slab = slab_type::instance();
+
+                    slab.checked( index, generation );
+
+                    if( retrieved ) {
+                        throw std::future_error( std::future_errc::future_already_retrieved );
+                    }
+
+                    retrieved = true;
+
+                    slab.retain( index );
+
+                    return compact_future<T>( index, generation );
+                }
+
+                template <typename... Args>
+                inline void set_value( Args &&... args ) {
+                    slab_type &slab = slab_type::instance();
+
+                    slab.checked( index, generation );
+
+                    slab.set_value( index, std::forward<Args>( args )... );
+                }
+
+                inline void set_exception( std::exception_ptr e ) {
+                    slab_type &slab = slab_type::instance();
+
+                    slab.checked( index, generation );
+
+                    slab.set_exception( index, e );
+                }
+        };
+
+        template <typename T>
+        class compact_future {
+                friend class compact_promise<T>;
+
+                template <typename U>
+                friend ThenableFuture<U> to_thenable( compact_future<U> && );
+
+                typedef detail::compact_slab<T> slab_type;
+
+                std::uint32_t index      = 0;
+                std::uint32_t generation = 0;
+
+                inline compact_future( std::uint32_t i, std::uint32_t g ) THENABLE_NOEXCEPT : index( i ), generation( g ) {}
+
+                /*
+                 * Gives up this future's reference to its slot, which the caller is now responsible for releasing
+                 * */
+                inline std::uint32_t detach() {
+                    slab_type::instance().checked( index, generation );
+
+                    generation = 0;
+
+                    return index;
+                }
+
+            public:
+                compact_future() THENABLE_NOEXCEPT = default;
+
+                inline compact_future( compact_future &&f ) THENABLE_NOEXCEPT : index( f.index ), generation( f.generation ) {
+                    f.generation = 0;
+                }
+
+                compact_future( const compact_future & ) = delete;
+
+                compact_future &operator=( const compact_future & ) = delete;
+
+                inline compact_future &operator=( compact_future &&f ) THENABLE_NOEXCEPT {
+                    compact_future( std::move( f )).swap( *this );
+
+                    return *this;
+                }
+
+                inline ~compact_future() {
+                    if( generation != 0 ) {
+                        slab_type::instance().release( index );
+                    }
+                }
+
+                inline void swap( compact_future &other ) THENABLE_NOEXCEPT {
+                    std::swap( index, other.index );
+                    std::swap( generation, other.generation );
+                }
+
+                inline bool valid() const THENABLE_NOEXCEPT {
+                    return generation != 0;
+                }
+
+                inline bool is_ready() const {
+                    return slab_type::instance().checked( index, generation ).st.load( std::memory_order_acquire ) != detail::shared_state_base::status::pending;
+                }
+
+                /*
+                 * Like ThenableFuture::get, this releases the slot, so the future is no longer valid afterwards.
+                 * */
+                inline T get() {
+                    slab_type &slab = slab_type::instance();
+
+                    detail::compact_ref<T> ref{ detach() };
+
+                    slab.wait( ref.index );
+
+                    return slab.take( ref.index );
+                }
+
+                inline void wait() const {
+                    slab_type &slab = slab_type::instance();
+
+                    slab.checked( index, generation );
+
+                    slab.wait( index );
+                }
+
+                template <typename Rep, typename Period>
+                inline std::future_status wait_for( const std::chrono::duration<Rep, Period> &timeout_duration ) const {
+                    return wait_until( std::chrono::steady_clock::now() + timeout_duration );
+                }
+
+                template <typename Clock, typename Duration>
+                inline std::future_status wait_until( const std::chrono::time_point<Clock, Duration> &timeout_time ) const {
+                    slab_type &slab = slab_type::instance();
+
+                    slab.checked( index, generation );
+
+                    return slab.wait_until( index, timeout_time );
+                }
+
+                template <typename Functor, typename LaunchPolicy = std::launch>
+                inline ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( Functor &&f, LaunchPolicy &&policy = std::launch( default_policy )) {
+                    return to_thenable( std::move( *this )).then( std::forward<Functor>( f ), std::forward<LaunchPolicy>( policy ));
+                }
+        };
+
+        /*
+         * Moves a compact_future's result into a regular shared state once it's ready, so it can be used anywhere a ThenableFuture can
+         * */
+        template <typename T>
+        inline ThenableFuture<T> to_thenable( compact_future<T> &&f ) {
+            typedef detail::compact_slab<T> slab_type;
+
+            slab_type::instance().checked( f.index, f.generation );
+
+            auto s = detail::make_state<detail::shared_state<T>>();
+
+            detail::continuation_ptr c = detail::make_continuation( [s, i = f.index]() THENABLE_NOEXCEPT {
+                slab_type &slab = slab_type::instance();
+
+                slab.store( i, *s );
+                slab.release( i );
+            } );
+
+            slab_type::instance().add_continuation( f.detach(), std::move( c ));
+
+            return detail::state_access::make_future( std::move( s ));
+        }
+
+        namespace detail {
+            template <typename T>
+            inline std::vector<std::shared_ptr<shared_state<T>>> compact_states( std::vector<compact_future<T>> &&futures ) {
+                std::vector<std::shared_ptr<shared_state<T>>> states;
+
+                states.reserve( futures.size());
+
+                for( auto &f : futures ) {
+                    ThenableFuture<T> converted = to_thenable( std::move( f ));
+
+                    states.push_back( std::move( state_access::get( converted )));
+                }
+
+                return states;
+            }
+        }
+
+        template <typename T>
+        inline ThenableFuture<std::vector<T>> await_all( std::vector<compact_future<T>> &&results, std::launch policy = default_policy ) {
+            return detail::await_vector<detail::take_tag>( detail::compact_states( std::move( results )), policy );
+        }
+
+        template <typename T>
+        inline ThenableFuture<std::vector<T>> await_all( std::vector<compact_future<T>> &&results, then_launch policy ) {
+            return detail::await_vector<detail::take_tag>( detail::compact_states( std::move( results )), policy );
+        }
+
+        template <typename Executor, typename T>
+        inline typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<std::vector<T>>>::type
+        await_all( std::vector<compact_future<T>> &&results, Executor &executor ) {
+            return detail::await_vector<detail::take_tag>( detail::compact_states( std::move( results )), detail::executor_ref<Executor>( executor ));
+        }
+
+        //////////
+
+        namespace detail {
+            /*
+             * fused structure
+             *
+             * Two consecutive stages of a lazy chain combined into one callable, passing the result of the first to the second
+             * the same way then would. Each call to lazy::then nests another one, so the whole chain is a single type the compiler can inline.
+             * */
+            template <typename First, typename Second>
+            struct fused {
+                First  first;
+                Second second;
+
+                inline decltype( auto ) call( std::false_type ) noexcept( noexcept( invoke_callback( second, recursive_get( first())))) {
+                    return invoke_callback( second, recursive_get( first()));
+                }
+
+                inline decltype( auto ) call( std::true_type ) noexcept( noexcept( first()) && noexcept( invoke_callback( second ))) {
+                    first();
+
+                    return invoke_callback( second );
+                }
+
+                inline decltype( auto ) operator()() noexcept( noexcept( std::declval<fused &>().call( std::is_void<decltype( first())>()))) {
+                    return call( std::is_void<decltype( first())>());
+                }
+            };
+
+            template <typename T>
+            struct just_value {
+                T value;
+
+                inline T operator()() noexcept( std::is_nothrow_move_constructible<T>::value ) {
+                    return std::move( value );
+                }
+            };
+
+            struct just_void {
+                inline void operator()() THENABLE_NOEXCEPT {}
+            };
+        }
+
+        /*
+         * lazy class
+         *
+         * A chain of callbacks that hasn't been started yet. It holds nothing but the callbacks themselves, so building one
+         * never allocates or launches anything, and then just fuses the next callback onto the chain.
+         *
+         * The chain only runs when get is called, which runs it right there on the calling thread, or when it's started
+         * with a launch policy or executor, which gives back a ThenableFuture. A lazy chain can only be run once.
+         * */
+        template <typename Functor>
+        class lazy {
+                template <typename>
+                friend class lazy;
+
+                Functor f;
+
+            public:
+                typedef decltype( std::declval<Functor &>()()) result_type;
+
+            private:
+                inline decltype( auto ) run( std::false_type ) {
+                    return detail::recursive_get( f());
+                }
+
+                inline void run( std::true_type ) {
+                    f();
+                }
+
+            public:
+
+                inline explicit lazy( Functor &&_f ) : f( std::move( _f )) {}
+
+                template <typename Next>
+                inline lazy<detail::fused<Functor, typename std::decay<Next>::type>> then( Next &&next ) && {
+                    return lazy<detail::fused<Functor, typename std::decay<Next>::type>>(
+                        detail::fused<Functor, typename std::decay<Next>::type>{ std::move( f ), std::forward<Next>( next ) } );
+                }
+
+                /*
+                 * Runs the whole chain on this thread and returns the result, without allocating anything
+                 * */
+                inline decltype( auto ) get() && {
+                    return run( std::is_void<result_type>());
+                }
+
+                /*
+                 * Starts the chain as the callback of a ready future, so it runs inline under then_launch::immediate,
+                 * and is launched or deferred like any other callback otherwise, including under the default policy
+                 * */
+
+                template <typename LaunchPolicy = std::launch>
+                inline ThenableFuture<implicit_result_of<Functor, std::future<void>>> start( LaunchPolicy &&policy = std::launch( default_policy )) && {
+                    return make_ready_future().then( std::move( f ), std::forward<LaunchPolicy>( policy ));
+                }
+
+                inline operator ThenableFuture<implicit_result_of<Functor, std::future<void>>>() && {
+                    return std::move( *this ).start();
+                }
+        };
+
+        template <typename T>
+        inline lazy<detail::just_value<typename std::decay<T>::type>> just( T &&value ) {
+            return lazy<detail::just_value<typename std::decay<T>::type>>( detail::just_value<typename std::decay<T>::type>{ std::forward<T>( value ) } );
+        }
+
+        inline lazy<detail::just_void> just() {
+            return lazy<detail::just_void>( detail::just_void());
         }
     }
 }
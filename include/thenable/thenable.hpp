@@ -12,6 +12,34 @@
 #include <tuple>
 #include <memory>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <cstddef>
+
+#if __cplusplus >= 201703L
+#include <variant>
+#include <memory_resource>
+
+//Anything that needs C++17 library types is only defined when they're available
+#define THENABLE_HAS_CXX17
+#endif
+
+#ifdef __cpp_impl_coroutine
+#include <coroutine>
+#include <optional>
+#include <deque>
+
+//co_await support and task are only defined when the compiler implements coroutines
+#define THENABLE_HAS_COROUTINES
+#endif
 
 //This is defined so it can be quickly toggled if something needs debugging
 #define THENABLE_NOEXCEPT noexcept
@@ -61,1312 +89,6289 @@ namespace thenable {
      * though it doesn't matter since this is a type-safe enum class anyway.
      * */
 
+    /*
+     * then_launch::immediate runs the callback synchronously on whichever thread resolves the upstream future,
+     * or right away on the calling thread if it's already resolved. It's meant for cheap callbacks where spawning
+     * a thread would cost far more than the callback itself.
+     *
+     * ("inline" would have been the obvious name, but it's a keyword.)
+     * */
+
     enum class then_launch {
-            detached = 4
+            detached  = 4,
+            immediate = 8
     };
 
-    //////////
+    /*
+     * The number of then_launch::immediate callbacks allowed to nest on one thread's stack. Beyond that, they are queued
+     * and run by the outermost one once it returns, so long chains of immediate callbacks can't overflow the stack.
+     * */
+#ifdef THENABLE_IMMEDIATE_DEPTH_LIMIT
+    constexpr size_t immediate_depth_limit = THENABLE_IMMEDIATE_DEPTH_LIMIT;
+#else
+    constexpr size_t immediate_depth_limit = 64;
+#endif
 
-    template <typename>
-    class ThenableFuture;
+    /*
+     * How long a thread used for a detached task waits around for another task before exiting.
+     * */
+#ifdef THENABLE_DETACHED_KEEP_ALIVE_MS
+    constexpr std::chrono::milliseconds detached_keep_alive( THENABLE_DETACHED_KEEP_ALIVE_MS );
+#else
+    constexpr std::chrono::milliseconds detached_keep_alive( 10000 );
+#endif
 
-    template <typename>
-    class ThenableSharedFuture;
+    /*
+     * How many bytes of a task are stored inline when it's queued for a thread, the timer or a ThreadPool.
+     * Anything larger, or that may throw when moved, is put into a continuation instead.
+     * */
+#ifdef THENABLE_TASK_BUFFER_SIZE
+    constexpr size_t task_buffer_size = THENABLE_TASK_BUFFER_SIZE;
+#else
+    constexpr size_t task_buffer_size = 48;
+#endif
 
-    template <typename>
-    class ThenablePromise;
+    /*
+     * How many values an async_generator's producer may run ahead of its consumer by, unless the consumer asks for another depth.
+     * */
+#ifdef THENABLE_GENERATOR_PREFETCH_DEPTH
+    constexpr size_t generator_prefetch_depth = THENABLE_GENERATOR_PREFETCH_DEPTH;
+#else
+    constexpr size_t generator_prefetch_depth = 16;
+#endif
 
+#ifdef THENABLE_HAS_CXX17
+    /*
+     * Memory resources
+     *
+     * Everything thenable allocates on a thread, like shared states, continuations and the bookkeeping behind await_all and parallel_n,
+     * comes from that thread's memory resource. It's null by default, which means the global heap.
+     *
+     * A resource is only used for allocations made on the thread it was set on, but those blocks are often released on another thread,
+     * such as the one that resolves the last future, so it should be thread-safe unless everything stays on one thread.
+     * It must also outlive everything allocated from it.
+     * */
     namespace detail {
-        template <typename T>
-        struct get_future_type {
-        };
+        inline std::pmr::memory_resource *&current_resource() THENABLE_NOEXCEPT {
+            static thread_local std::pmr::memory_resource *resource = nullptr;
 
-        template <typename T>
-        struct get_future_type<std::future<T>> {
-            typedef T type;
-        };
+            return resource;
+        }
+    }
 
-        template <typename T>
-        struct get_future_type<std::shared_future<T>> {
-            typedef T type;
-        };
+    inline std::pmr::memory_resource *get_memory_resource() THENABLE_NOEXCEPT {
+        return detail::current_resource();
+    }
 
-        template <typename T>
-        struct get_future_type<std::promise<T>> {
-            typedef T type;
-        };
+    /*
+     * Returns the previous resource so it can be restored afterwards. Null goes back to the global heap.
+     * */
+    inline std::pmr::memory_resource *set_memory_resource( std::pmr::memory_resource *r ) THENABLE_NOEXCEPT {
+        return std::exchange( detail::current_resource(), r );
+    }
 
-        template <typename T>
-        struct get_future_type<ThenableFuture<T>> {
-            typedef T type;
-        };
+    /*
+     * memory_resource_guard class
+     *
+     * Sets the memory resource of the current thread for as long as it's alive.
+     * */
+    class memory_resource_guard {
+            std::pmr::memory_resource *previous;
 
-        template <typename T>
-        struct get_future_type<ThenableSharedFuture<T>> {
-            typedef T type;
-        };
+        public:
+            inline explicit memory_resource_guard( std::pmr::memory_resource *r ) THENABLE_NOEXCEPT : previous( set_memory_resource( r )) {}
 
-        template <typename T>
-        struct get_future_type<ThenablePromise<T>> {
-            typedef T type;
-        };
+            memory_resource_guard( const memory_resource_guard & ) = delete;
 
-        template <typename T>
-        struct recursive_get_future_type {
-            typedef T type;
-        };
+            memory_resource_guard &operator=( const memory_resource_guard & ) = delete;
 
-        template <typename T>
-        struct recursive_get_future_type<std::future<T>> {
-            typedef typename recursive_get_future_type<T>::type type;
-        };
+            inline ~memory_resource_guard() {
+                set_memory_resource( previous );
+            }
+    };
 
-        template <typename T>
-        struct recursive_get_future_type<std::shared_future<T>> {
-            typedef typename recursive_get_future_type<T>::type type;
-        };
+    /*
+     * The size of each block a scope allocates from, and how many unused blocks are kept around for the next scope
+     * */
+#ifdef THENABLE_SCOPE_BLOCK_SIZE
+    constexpr size_t scope_block_size = THENABLE_SCOPE_BLOCK_SIZE;
+#else
+    constexpr size_t scope_block_size = 4096;
+#endif
 
-        template <typename T>
-        struct recursive_get_future_type<std::promise<T>> {
-            typedef typename recursive_get_future_type<T>::type type;
-        };
+#ifdef THENABLE_SCOPE_CACHED_BLOCKS
+    constexpr size_t scope_cached_blocks = THENABLE_SCOPE_CACHED_BLOCKS;
+#else
+    constexpr size_t scope_cached_blocks = 64;
+#endif
 
-        template <typename T>
-        struct recursive_get_future_type<ThenableFuture<T>> {
-            typedef typename recursive_get_future_type<T>::type type;
-        };
+    namespace detail {
+        struct alignas( alignof( std::max_align_t )) scope_block {
+            scope_block *next;
+            size_t      size;
 
-        template <typename T>
-        struct recursive_get_future_type<ThenableSharedFuture<T>> {
-            typedef typename recursive_get_future_type<T>::type type;
+            inline char *data() THENABLE_NOEXCEPT {
+                return reinterpret_cast<char *>( this + 1 );
+            }
         };
 
-        template <typename T>
-        struct recursive_get_future_type<ThenablePromise<T>> {
-            typedef typename recursive_get_future_type<T>::type type;
-        };
-    }
+        /*
+         * scope_block_cache class
+         *
+         * Blocks of the default size are recycled between scopes here, so a steady stream of scopes doesn't touch the heap at all.
+         * It's leaked for the same reason as thread_cache.
+         * */
+        class scope_block_cache {
+                std::mutex  mtx;
+                scope_block *head = nullptr;
+                size_t      count = 0;
 
-    template <typename Functor>
-    using recursive_result_of = typename detail::recursive_get_future_type<typename std::result_of<Functor()>::type>::type;
+            public:
+                static inline scope_block_cache &instance() {
+                    static scope_block_cache *cache = new scope_block_cache();
 
-    //////////
+                    return *cache;
+                }
 
-    template <typename T>
-    constexpr ThenableFuture<T> to_thenable( std::future<T> && );
+                inline scope_block *acquire( size_t size ) {
+                    if( size == scope_block_size ) {
+                        std::lock_guard<std::mutex> lock( mtx );
 
-    template <typename T>
-    constexpr ThenableSharedFuture<T> to_thenable( const std::shared_future<T> & );
+                        if( scope_block *b = head ) {
+                            head = b->next;
 
-    template <typename T>
-    constexpr ThenableSharedFuture<T> to_thenable( std::shared_future<T> && );
+                            --count;
 
-    template <typename T>
-    constexpr ThenablePromise<T> to_thenable( std::promise<T> && );
+                            b->next = nullptr;
 
-    //////////
+                            return b;
+                        }
+                    }
 
-    template <typename... Results>
-    constexpr std::tuple<ThenableFuture<Results>...> to_thenable( std::tuple<std::future<Results>...> && );
+                    return new( ::operator new( sizeof( scope_block ) + size )) scope_block{ nullptr, size };
+                }
 
-    template <typename... Results>
-    constexpr std::tuple<ThenableSharedFuture<Results>...> to_thenable( std::tuple<std::shared_future<Results>...> && );
+                inline void release( scope_block *b ) THENABLE_NOEXCEPT {
+                    if( b->size == scope_block_size ) {
+                        std::lock_guard<std::mutex> lock( mtx );
 
-    template <typename... Results>
-    constexpr std::tuple<ThenablePromise<Results>...> to_thenable( std::tuple<std::promise<Results>...> && );
+                        if( count < scope_cached_blocks ) {
+                            b->next = head;
+                            head = b;
 
-    //////////
+                            ++count;
 
-    template <typename... Results>
-    constexpr std::tuple<ThenableFuture<Results>...> to_thenable( std::tuple<ThenableFuture<Results>...> && );
+                            return;
+                        }
+                    }
 
-    template <typename... Results>
-    constexpr std::tuple<ThenableSharedFuture<Results>...> to_thenable( std::tuple<ThenableSharedFuture<Results>...> && );
+                    ::operator delete( b );
+                }
+        };
 
-    template <typename... Results>
-    constexpr std::tuple<ThenablePromise<Results>...> to_thenable( std::tuple<ThenablePromise<Results>...> && );
+        /*
+         * scope_arena class
+         *
+         * The memory resource behind a scope. Allocations just bump a pointer through a list of blocks, and deallocations
+         * only count down. The arena lives at the start of its own first block, and holds one reference for the scope plus
+         * one for every allocation still alive, so it gives all of its blocks back at once when the last of those is released.
+         *
+         * Only the thread the scope was opened on allocates from it, but anything can release into it.
+         * */
+        class scope_arena final : public std::pmr::memory_resource {
+                scope_block        *blocks;
+                char               *cursor;
+                char               *end;
+                std::atomic_size_t refs;
+
+                inline explicit scope_arena( scope_block *first ) THENABLE_NOEXCEPT
+                    : blocks( first ), cursor( first->data() + sizeof( scope_arena )), end( first->data() + first->size ), refs( 1 ) {}
+
+                inline void grow( size_t bytes ) {
+                    scope_block *b = scope_block_cache::instance().acquire( std::max( bytes, scope_block_size ));
+
+                    b->next = blocks;
+                    blocks  = b;
+                    cursor  = b->data();
+                    end     = b->data() + b->size;
+                }
 
-    //////////
+                void *do_allocate( size_t bytes, size_t alignment ) override {
+                    void   *p    = cursor;
+                    size_t space = static_cast<size_t>( end - cursor );
 
-    template <typename T = void, typename Functor, typename LaunchPolicy = std::launch>
-    std::future<T> make_promise( Functor &&, LaunchPolicy = default_policy );
+                    if( !std::align( alignment, bytes, p, space )) {
+                        grow( bytes + alignment );
 
-    template <typename T = void, typename Functor, typename LaunchPolicy = std::launch>
-    ThenableFuture<T> make_promise2( Functor &&, LaunchPolicy = default_policy );
+                        p     = cursor;
+                        space = static_cast<size_t>( end - cursor );
 
+                        std::align( alignment, bytes, p, space );
+                    }
 
-    //////////
+                    cursor = static_cast<char *>( p ) + bytes;
 
-    template <typename... Functors>
-    std::tuple<std::future<recursive_result_of<Functors>>...> parallel( Functors &&... fns );
+                    refs.fetch_add( 1, std::memory_order_relaxed );
 
-    template <typename... Functors>
-    std::tuple<ThenableFuture<recursive_result_of<Functors>>...> parallel2( Functors &&... fns );
+                    return p;
+                }
 
-    template <typename... Functors>
-    std::tuple<std::future<recursive_result_of<Functors>>...> parallel_n( size_t concurrency, Functors &&... fns );
+                void do_deallocate( void *, size_t, size_t ) override {
+                    release();
+                }
 
-    template <typename... Functors>
-    std::tuple<ThenableFuture<recursive_result_of<Functors>>...> parallel2_n( size_t concurrency, Functors &&... fns );
+                bool do_is_equal( const std::pmr::memory_resource &other ) const THENABLE_NOEXCEPT override {
+                    return this == &other;
+                }
 
-    //////////
+            public:
+                static inline scope_arena *create() {
+                    static_assert( sizeof( scope_arena ) < scope_block_size, "scope_block_size is too small" );
 
-    template <typename Functor, typename... Args>
-    inline std::future<typename std::result_of<Functor( Args... )>::type> defer( Functor &&f, Args &&... args ) {
-        return std::async( std::launch::deferred, std::forward<Functor>( f ), std::forward<Args>( args )... );
-    };
+                    scope_block *first = scope_block_cache::instance().acquire( scope_block_size );
 
-    template <typename Functor, typename... Args>
-    inline ThenableFuture<typename std::result_of<Functor( Args... )>::type> defer2( Functor &&f, Args &&... args ) {
-        return to_thenable( defer( std::forward<Functor>( f ), std::forward<Args>( args )... ));
-    };
+                    return new( first->data()) scope_arena( first );
+                }
 
-    //////////
+                inline void release() THENABLE_NOEXCEPT {
+                    if( refs.fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) {
+                        scope_block *b = blocks;
 
-    namespace detail {
-        using namespace fn_traits;
+                        this->~scope_arena();
 
-        template <typename Functor, typename T, std::size_t... S>
-        inline decltype( auto ) invoke_helper( Functor &&func, T &&t, std::index_sequence<S...> ) {
-            return func( std::get<S>( std::forward<T>( t ))... );
-        }
+                        while( b ) {
+                            scope_block *next = b->next;
 
-        template <typename Functor, typename T>
-        inline decltype( auto ) invoke_tuple( Functor &&func, T &&t ) {
-            constexpr auto Size = std::tuple_size<typename std::decay<T>::type>::value;
+                            scope_block_cache::instance().release( b );
 
-            return invoke_helper( std::forward<Functor>( func ),
-                                  std::forward<T>( t ),
-                                  std::make_index_sequence<Size>{} );
-        }
+                            b = next;
+                        }
+                    }
+                }
+        };
+    }
 
-        /*
-         * recursive_get:
-         *
-         * This will continually call "get" on any future or promise objects returned by another future,
-         * recursively, basically resolving the entire chain at once
-         * */
+    /*
+     * scope class
+     *
+     * A request-scoped arena. While a scope is alive, everything thenable allocates on the thread that opened it comes from the scope,
+     * so a whole chain of continuations and the states behind it are just carved out of a few blocks. Those blocks are handed back in one go
+     * once the scope has been closed and everything allocated from it has been released, which is usually when the final future of the chain
+     * is destroyed. Until then, the memory of individual states isn't reused, so a scope should wrap a bounded amount of work like a single request.
+     *
+     * Closing a scope restores whatever memory resource the thread had before, so scopes can be nested.
+     * */
+    class scope {
+            detail::scope_arena       *arena;
+            std::pmr::memory_resource *previous;
 
-        /*
-         * Forward declarations
-         * */
+        public:
+            inline scope() : arena( detail::scope_arena::create()) {
+                previous = set_memory_resource( arena );
+            }
 
-        template <typename T>
-        typename recursive_get_future_type<T>::type recursive_get( std::future<T> && );
+            scope( const scope & ) = delete;
 
-        template <typename T>
-        typename recursive_get_future_type<T>::type recursive_get( std::shared_future<T> && );
+            scope &operator=( const scope & ) = delete;
 
-        template <typename T>
-        typename recursive_get_future_type<T>::type recursive_get( std::promise<T> && );
+            inline ~scope() {
+                set_memory_resource( previous );
 
-        template <typename T>
-        typename recursive_get_future_type<T>::type recursive_get( ThenableFuture<T> && );
+                arena->release();
+            }
 
-        template <typename T>
-        typename recursive_get_future_type<T>::type recursive_get( ThenableSharedFuture<T> && );
+            inline std::pmr::memory_resource *resource() const THENABLE_NOEXCEPT {
+                return arena;
+            }
+    };
+#endif
 
-        template <typename T>
-        typename recursive_get_future_type<T>::type recursive_get( ThenablePromise<T> && );
+    /*
+     * Recycling pool
+     *
+     * When no memory resource is set, the fixed-size blocks thenable allocates over and over, like shared states, continuations
+     * and the control blocks around them, are recycled through per-thread free lists sorted into size classes. Threads with too many
+     * free blocks of a class pass half of them to a global overflow list, which threads that run out refill from in batches.
+     *
+     * Anything larger than pool_max_block_size goes straight to operator new, and the pool can be turned off with THENABLE_DISABLE_POOL.
+     * */
+#ifdef THENABLE_POOL_MAX_BLOCK_SIZE
+    constexpr size_t pool_max_block_size = THENABLE_POOL_MAX_BLOCK_SIZE;
+#else
+    constexpr size_t pool_max_block_size = 1024;
+#endif
 
-        template <typename T>
-        constexpr T recursive_get( T && ) THENABLE_NOEXCEPT;
+    /*
+     * The most free blocks of each size class kept by each thread, and by the global overflow list
+     * */
+#ifdef THENABLE_POOL_THREAD_BLOCKS
+    constexpr size_t pool_thread_blocks = THENABLE_POOL_THREAD_BLOCKS;
+#else
+    constexpr size_t pool_thread_blocks = 128;
+#endif
 
-        /*
-         * std future implementations. ThenableX implementations are below their class implementation at the bottom of the file.
-         * */
+#ifdef THENABLE_POOL_GLOBAL_BLOCKS
+    constexpr size_t pool_global_blocks = THENABLE_POOL_GLOBAL_BLOCKS;
+#else
+    constexpr size_t pool_global_blocks = 4096;
+#endif
 
-        template <typename T>
-        inline typename recursive_get_future_type<T>::type recursive_get( std::future<T> &&t ) {
-            return recursive_get( t.get());
-        };
+    /*
+     * pool_stats structure
+     *
+     * Totals for every thread since the program started. Allocations only counts requests small enough for the pool.
+     * */
+    struct pool_stats {
+        size_t allocations;
+        size_t thread_hits;
+        size_t global_hits;
+        size_t misses;
+
+        inline double hit_rate() const THENABLE_NOEXCEPT {
+            return allocations != 0 ? double( thread_hits + global_hits ) / double( allocations ) : 0.0;
+        }
+    };
 
-        template <typename T>
-        inline typename recursive_get_future_type<T>::type recursive_get( std::shared_future<T> &&t ) {
-            return recursive_get( t.get());
-        };
+    namespace detail {
+#ifdef THENABLE_DISABLE_POOL
+        constexpr bool pool_enabled = false;
+#else
+        constexpr bool pool_enabled = true;
+#endif
 
-        template <>
-        inline typename recursive_get_future_type<void>::type recursive_get<void>( std::future<void> &&t ) {
-            t.get();
+        constexpr size_t pool_granularity = 64;
+        constexpr size_t pool_classes     = ( pool_max_block_size + pool_granularity - 1 ) / pool_granularity;
+
+        struct pool_block {
+            pool_block *next;
         };
 
-        template <>
-        inline typename recursive_get_future_type<void>::type recursive_get<void>( std::shared_future<void> &&t ) {
-            t.get();
-        };
+        struct pool_list {
+            pool_block *head  = nullptr;
+            size_t     count = 0;
 
-        template <typename T>
-        inline typename recursive_get_future_type<T>::type recursive_get( std::promise<T> &&t ) {
-            return recursive_get( t.get_future());
+            inline void push( pool_block *b ) THENABLE_NOEXCEPT {
+                b->next = head;
+                head    = b;
+
+                ++count;
+            }
+
+            inline pool_block *pop() THENABLE_NOEXCEPT {
+                pool_block *b = head;
+
+                if( b ) {
+                    head = b->next;
+
+                    --count;
+                }
+
+                return b;
+            }
         };
 
         /*
-         * This just forwards anything that is NOT a promise or future and doesn't do anything to it.
+         * Only ever written by the thread that owns them, but read by get_pool_stats from anywhere
          * */
-        template <typename T>
-        constexpr T recursive_get( T &&t ) THENABLE_NOEXCEPT {
-            return std::forward<T>( t );
+        struct pool_counters {
+            std::atomic_size_t allocations{ 0 };
+            std::atomic_size_t thread_hits{ 0 };
+            std::atomic_size_t global_hits{ 0 };
+            std::atomic_size_t misses{ 0 };
+
+            static inline void bump( std::atomic_size_t &c ) THENABLE_NOEXCEPT {
+                c.store( c.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+            }
         };
 
-        //////////
+        class pool_cache;
 
         /*
-         * then_invoke_helper structure
+         * pool_global class
          *
-         * This just takes care of the invocation of the callback, forwarding arguments and so forth and
-         * taking care of any returned futures
+         * The overflow lists shared by every thread, along with the bookkeeping for stats. Leaked for the same reason as thread_cache.
          * */
+        class pool_global {
+                std::mutex                mtx;
+                pool_list                 lists[pool_classes];
+                std::vector<pool_cache *> caches;
+                pool_stats                retired{ 0, 0, 0, 0 };
 
-        template <typename Functor, typename R = fn_result_of<Functor>>
-        struct then_invoke_helper {
-            /*
-             * If you're seeing any of the code below, it's probably because a callback given to `then` doesn't
-             * have the same argument types as the value being passed from the previous future.
-             * */
+            public:
+                static inline pool_global &instance() {
+                    static pool_global *global = new pool_global();
 
-            template <typename... Args>
-            inline static decltype( auto ) invoke( Functor &&f, std::tuple<Args...> &&args ) {
-                return recursive_get( invoke_tuple( std::forward<Functor>( f ), std::forward<std::tuple<Args...>>( args )));
-            }
+                    return *global;
+                }
 
-            template <typename T>
-            inline static decltype( auto ) invoke( Functor &&f, T &&arg ) {
-                return recursive_get( f( std::forward<T>( arg )));
-            }
+                inline bool refill( size_t c, pool_list &into, size_t n ) {
+                    std::lock_guard<std::mutex> lock( mtx );
 
-            inline static decltype( auto ) invoke( Functor &&f ) {
-                return recursive_get( f());
-            }
-        };
+                    for( size_t i = 0; i < n; ++i ) {
+                        if( pool_block *b = lists[c].pop()) {
+                            into.push( b );
 
-        /*
-         * Specialization of then_invoke_helper for void callbacks.
-         * */
-        template <typename Functor>
-        struct then_invoke_helper<Functor, void> {
-            /*
-             * If you're seeing any of the code below, it's probably because a callback given to `then` doesn't
-             * have the same argument types as the value being passed from the previous future.
-             * */
+                        } else {
+                            break;
+                        }
+                    }
 
-            template <typename... Args>
-            inline static void invoke( Functor &&f, std::tuple<Args...> &&args ) {
-                invoke_tuple( std::forward<Functor>( f ), std::forward<std::tuple<Args...>>( args ));
-            }
+                    return into.head != nullptr;
+                }
 
-            template <typename T>
-            inline static void invoke( Functor &&f, T &&arg ) {
-                f( std::forward<T>( arg ));
-            }
+                inline void overflow( size_t c, pool_list &from, size_t n ) THENABLE_NOEXCEPT {
+                    std::lock_guard<std::mutex> lock( mtx );
 
-            inline static void invoke( Functor &&f ) {
-                f();
-            }
-        };
+                    for( size_t i = 0; i < n; ++i ) {
+                        pool_block *b = from.pop();
 
-        //////////
+                        if( !b ) {
+                            break;
 
-        /*
-         * then_helper structure
-         *
-         * This takes care of resolving the first given future, and optionally passing the
-         * resulting value to the callback function.
-         * */
+                        } else if( lists[c].count < pool_global_blocks ) {
+                            lists[c].push( b );
 
-        template <typename T, typename Functor>
-        struct then_helper {
-            inline static decltype( auto ) dispatch( std::future<T> &&s, Functor &&f ) {
-                return then_invoke_helper<Functor>::invoke( std::forward<Functor>( f ), recursive_get( std::forward<std::future<T>>( s )));
-            }
+                        } else {
+                            ::operator delete( b );
+                        }
+                    }
+                }
 
-            inline static decltype( auto ) dispatch( std::shared_future<T> &&s, Functor &&f ) {
-                return then_invoke_helper<Functor>::invoke( std::forward<Functor>( f ), recursive_get( std::forward<std::shared_future<T>>( s )));
-            }
-        };
+                inline void attach( pool_cache *cache ) {
+                    std::lock_guard<std::mutex> lock( mtx );
 
-        template <typename Functor>
-        struct then_helper<void, Functor> {
-            inline static decltype( auto ) dispatch( std::future<void> &&s, Functor &&f ) {
-                s.get();
+                    caches.push_back( cache );
+                }
 
-                return then_invoke_helper<Functor>::invoke( std::forward<Functor>( f ));
-            }
+                inline void detach( pool_cache *cache, const pool_counters &counters ) THENABLE_NOEXCEPT {
+                    std::lock_guard<std::mutex> lock( mtx );
 
-            inline static decltype( auto ) dispatch( std::shared_future<void> &&s, Functor &&f ) {
-                s.get();
+                    caches.erase( std::find( caches.begin(), caches.end(), cache ));
 
-                return then_invoke_helper<Functor>::invoke( std::forward<Functor>( f ));
-            }
-        };
+                    retired.allocations += counters.allocations.load( std::memory_order_relaxed );
+                    retired.thread_hits += counters.thread_hits.load( std::memory_order_relaxed );
+                    retired.global_hits += counters.global_hits.load( std::memory_order_relaxed );
+                    retired.misses += counters.misses.load( std::memory_order_relaxed );
+                }
 
-        //////////
+                inline pool_stats stats();
+        };
 
         /*
-         * detached_then_helper structure
-         *
-         * These provide a function for catching exceptions and forwarding the result of the callbacks to the promise.
+         * pool_cache class
          *
-         * It also accounts for void callbacks which don't return anything.
+         * The free lists of one thread. Blocks can be freed on a different thread than they were allocated on, in which case they just join
+         * that thread's lists instead. When the thread exits, its free blocks go to the overflow lists.
          * */
+        class pool_cache {
+                pool_list     lists[pool_classes];
+                pool_counters counters;
 
-        template <typename T>
-        struct detached_then_helper {
-            template <typename Functor, typename K>
-            static inline void dispatch( std::promise<T> &p, std::future<K> &&s, Functor &&f ) THENABLE_NOEXCEPT {
-                try {
-                    p.set_value( then_helper<K, Functor>::dispatch( std::forward<std::future<K>>( s ), std::forward<Functor>( f )));
+                static inline bool &destroyed() THENABLE_NOEXCEPT {
+                    static thread_local bool flag = false;
 
-                } catch( ... ) {
-                    p.set_exception( std::current_exception());
+                    return flag;
                 }
-            }
 
-            template <typename Functor, typename K>
-            static inline void dispatch( std::promise<T> &p, std::shared_future<K> &&s, Functor &&f ) THENABLE_NOEXCEPT {
-                try {
-                    p.set_value( then_helper<K, Functor>::dispatch( std::forward<std::shared_future<K>>( s ), std::forward<Functor>( f )));
+                inline pool_cache() {
+                    pool_global::instance().attach( this );
+                }
 
-                } catch( ... ) {
-                    p.set_exception( std::current_exception());
+            public:
+                pool_cache( const pool_cache & ) = delete;
+
+                pool_cache &operator=( const pool_cache & ) = delete;
+
+                inline ~pool_cache() {
+                    for( size_t c = 0; c < pool_classes; ++c ) {
+                        pool_global::instance().overflow( c, lists[c], lists[c].count );
+                    }
+
+                    pool_global::instance().detach( this, counters );
+
+                    destroyed() = true;
                 }
-            }
-        };
 
-        /*
-         * Specialization for void Functors
-         * */
-        template <>
-        struct detached_then_helper<void> {
-            template <typename Functor, typename K>
-            static inline void dispatch( std::promise<void> &p, std::future<K> &&s, Functor &&f ) THENABLE_NOEXCEPT {
-                try {
-                    then_helper<K, Functor>::dispatch( std::forward<std::future<K>>( s ), std::forward<Functor>( f ));
+                /*
+                 * Returns null once the thread's cache has been destroyed, since other thread-local objects can still free blocks after that
+                 * */
+                static inline pool_cache *current() {
+                    if( destroyed()) {
+                        return nullptr;
+                    }
 
-                    p.set_value();
+                    static thread_local pool_cache cache;
 
-                } catch( ... ) {
-                    p.set_exception( std::current_exception());
+                    return &cache;
                 }
-            }
 
-            template <typename Functor, typename K>
-            static inline void dispatch( std::promise<void> &p, std::shared_future<K> &&s, Functor &&f ) THENABLE_NOEXCEPT {
-                try {
-                    then_helper<K, Functor>::dispatch( std::forward<std::shared_future<K>>( s ), std::forward<Functor>( f ));
+                inline const pool_counters &stats() const THENABLE_NOEXCEPT {
+                    return counters;
+                }
 
-                    p.set_value();
+                inline void *allocate( size_t c ) {
+                    pool_counters::bump( counters.allocations );
 
-                } catch( ... ) {
-                    p.set_exception( std::current_exception());
+                    if( pool_block *b = lists[c].pop()) {
+                        pool_counters::bump( counters.thread_hits );
+
+                        return b;
+                    }
+
+                    if( pool_global::instance().refill( c, lists[c], pool_thread_blocks / 2 )) {
+                        pool_counters::bump( counters.global_hits );
+
+                        return lists[c].pop();
+                    }
+
+                    pool_counters::bump( counters.misses );
+
+                    return ::operator new(( c + 1 ) * pool_granularity );
+                }
+
+                inline void deallocate( void *p, size_t c ) THENABLE_NOEXCEPT {
+                    if( lists[c].count >= pool_thread_blocks ) {
+                        pool_global::instance().overflow( c, lists[c], pool_thread_blocks / 2 );
+                    }
+
+                    lists[c].push( static_cast<pool_block *>( p ));
                 }
-            }
         };
 
-        template <typename T>
-        struct make_promise_helper {
-            template <typename Functor>
-            inline static void dispatch( Functor &&f, const std::shared_ptr<std::promise<T>> &p ) THENABLE_NOEXCEPT {
-                try {
-                    f( [p]( const T &resolved_value ) THENABLE_NOEXCEPT {
-                        p->set_value( resolved_value );
+        inline pool_stats pool_global::stats() {
+            std::lock_guard<std::mutex> lock( mtx );
 
-                    }, [p]( auto rejected_value ) THENABLE_NOEXCEPT {
-                        p->set_exception( std::make_exception_ptr( rejected_value ));
-                    } );
+            pool_stats total = retired;
 
-                } catch( ... ) {
-                    p->set_exception( std::current_exception());
-                }
+            for( pool_cache *cache : caches ) {
+                const pool_counters &counters = cache->stats();
+
+                total.allocations += counters.allocations.load( std::memory_order_relaxed );
+                total.thread_hits += counters.thread_hits.load( std::memory_order_relaxed );
+                total.global_hits += counters.global_hits.load( std::memory_order_relaxed );
+                total.misses += counters.misses.load( std::memory_order_relaxed );
             }
-        };
 
-        template <>
-        struct make_promise_helper<void> {
-            template <typename Functor>
-            inline static void dispatch( Functor &&f, const std::shared_ptr<std::promise<void>> &p ) THENABLE_NOEXCEPT {
-                try {
-                    f( [p]() THENABLE_NOEXCEPT {
-                        p->set_value();
+            return total;
+        }
 
-                    }, [p]( auto rejected_value ) THENABLE_NOEXCEPT {
-                        p->set_exception( std::make_exception_ptr( rejected_value ));
-                    } );
+        constexpr bool is_poolable( size_t size, size_t alignment ) THENABLE_NOEXCEPT {
+            return pool_enabled && size != 0 && size <= pool_classes * pool_granularity && alignment <= alignof( std::max_align_t );
+        }
 
-                } catch( ... ) {
-                    p->set_exception( std::current_exception());
+        inline void *pool_allocate( size_t size, size_t alignment ) {
+            if( is_poolable( size, alignment )) {
+                const size_t c = ( size - 1 ) / pool_granularity;
+
+                if( pool_cache *cache = pool_cache::current()) {
+                    return cache->allocate( c );
                 }
+
+                return ::operator new(( c + 1 ) * pool_granularity );
             }
-        };
-    }
 
-    //This is fun...
-    template <typename Functor, typename FutureType>
-    using implicit_result_of = decltype( detail::then_helper<typename detail::get_future_type<typename std::remove_reference<FutureType>::type>::type, Functor>::dispatch(
-        std::forward<FutureType>( std::declval<FutureType>()), std::forward<Functor>( std::declval<Functor>())));
+#ifdef __cpp_aligned_new
+            if( alignment > alignof( std::max_align_t )) {
+                return ::operator new( size, std::align_val_t( alignment ));
+            }
+#endif
 
-    //////////
+            return ::operator new( size );
+        }
 
-    template <typename T, typename Functor>
-    std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &, Functor &&, std::launch = default_policy );
+        inline void pool_deallocate( void *p, size_t size, size_t alignment ) THENABLE_NOEXCEPT {
+            if( is_poolable( size, alignment )) {
+                if( pool_cache *cache = pool_cache::current()) {
+                    cache->deallocate( p, ( size - 1 ) / pool_granularity );
 
-    template <typename T, typename Functor>
-    std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T> &&, Functor &&, std::launch = default_policy );
+                    return;
+                }
+            }
 
-    template <typename T, typename Functor>
-    std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T>, Functor &&, std::launch = default_policy );
+#ifdef __cpp_aligned_new
+            if( alignment > alignof( std::max_align_t )) {
+                ::operator delete( p, std::align_val_t( alignment ));
 
-    template <typename T, typename Functor>
-    std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &&, Functor &&, std::launch = default_policy );
+                return;
+            }
+#endif
 
-    template <typename T, typename Functor>
-    std::future<implicit_result_of<Functor, std::future<T>>> then( std::promise<T> &, Functor &&, std::launch = default_policy );
+            ::operator delete( p );
+        }
 
-    //////////
+        /*
+         * pool_allocator structure
+         *
+         * A standard allocator over the pool, for the control blocks made by std::allocate_shared and the states of standard promises
+         * */
+        template <typename T>
+        struct pool_allocator {
+            typedef T value_type;
 
-    template <typename T, typename Functor>
-    std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &, Functor &&, then_launch );
+            pool_allocator() THENABLE_NOEXCEPT = default;
 
-    template <typename T, typename Functor>
-    std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T> &&, Functor &&, then_launch );
+            template <typename U>
+            inline pool_allocator( const pool_allocator<U> & ) THENABLE_NOEXCEPT {}
 
-    template <typename T, typename Functor>
-    std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T>, Functor &&, then_launch );
+            inline T *allocate( size_t n ) {
+                return static_cast<T *>( pool_allocate( n * sizeof( T ), alignof( T )));
+            }
 
-    template <typename T, typename Functor>
-    std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &&, Functor &&, then_launch );
+            inline void deallocate( T *p, size_t n ) THENABLE_NOEXCEPT {
+                pool_deallocate( p, n * sizeof( T ), alignof( T ));
+            }
 
-    template <typename T, typename Functor>
-    std::future<implicit_result_of<Functor, std::future<T>>> then( std::promise<T> &, Functor &&, then_launch );
+            template <typename U>
+            inline bool operator==( const pool_allocator<U> & ) const THENABLE_NOEXCEPT {
+                return true;
+            }
+
+            template <typename U>
+            inline bool operator!=( const pool_allocator<U> & ) const THENABLE_NOEXCEPT {
+                return false;
+            }
+        };
+    }
 
+    inline pool_stats get_pool_stats() {
+        return detail::pool_global::instance().stats();
+    }
 
     /*
-     * then function
+     * Executor concept
      *
-     * This is the overload of then that resolves futures and promises and invokes a callback with the
-     * resulting value. It uses the standard std::async for asynchronous invocation.
+     * Anywhere a launch policy can be given, an executor can be passed by reference instead, so callbacks can be run on
+     * an existing thread pool or event loop rather than on threads created by thenable.
+     *
+     * An executor is any object with a `submit` member function that accepts a nullary callable and arranges for it to be
+     * invoked exactly once, on whatever thread it likes. For example:
+     *
+     *     struct my_executor {
+     *         template <typename Task>
+     *         void submit( Task &&task );
+     *     };
+     *
+     * Tasks are always passed as rvalues, never throw, and are only copyable if the callbacks given to thenable are.
+     * Executors are held by reference, so they must outlive any callbacks that might still be submitted to them.
      * */
 
-    /*
-     * Overload for simple futures
-     * */
-    template <typename T, typename Functor>
-    std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &&s, Functor &&f, std::launch policy ) {
-        return std::async( policy, [policy]( std::future<T> &&s2, Functor &&f2 ) {
-            return detail::then_helper<T, Functor>::dispatch( std::forward<std::future<T>>( s2 ), std::forward<Functor>( f2 ));
-        }, std::forward<std::future<T>>( s ), std::forward<Functor>( f ));
-    };
+    namespace detail {
+        template <typename...>
+        struct make_void {
+            typedef void type;
+        };
 
-    /*
-     * Overload for futures by references. It will take ownership and forward the future,
-     * calling the above overload.
-     * */
-    template <typename T, typename Functor>
-    inline std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &s, Functor &&f, std::launch policy ) {
-        return then( std::forward<std::future<T>>( s ), std::forward<Functor>( f ), policy );
-    };
+        template <typename... Ts>
+        using void_t = typename make_void<Ts...>::type;
 
-    /*
-     * Overload for shared_futures, passed by value because they can be copied.
-     * It's similar to the first overload, but can capture the shared_future in the lambda.
-     * */
-    template <typename T, typename Functor>
-    inline std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T> &&s, Functor &&f, std::launch policy ) {
-        return std::async( policy, [policy]( std::shared_future<T> &&s2, Functor &&f2 ) {
-            return detail::then_helper<T, Functor>::dispatch( std::forward<std::shared_future<T>>( s2 ), std::forward<Functor>( f2 ));
-        }, std::forward<std::shared_future<T>>( s ), std::forward<Functor>( f ));
+        struct executor_probe {
+            void operator()() const THENABLE_NOEXCEPT {}
+        };
+
+        template <typename Executor, typename = void>
+        struct is_executor : std::false_type {
+        };
+
+        template <typename Executor>
+        struct is_executor<Executor, void_t<decltype( std::declval<Executor &>().submit( std::declval<executor_probe>()))>> : std::true_type {
+        };
+
+        /*
+         * Non-owning handle to an executor, so it can be stored alongside callbacks like the other launch policies
+         * */
+        template <typename Executor>
+        struct executor_ref {
+            Executor *executor;
+
+            inline executor_ref( Executor &e ) THENABLE_NOEXCEPT : executor( &e ) {}
+        };
+    }
+
+    //////////
+
+    template <typename>
+    class ThenableFuture;
+
+    template <typename>
+    class ThenableSharedFuture;
+
+    template <typename>
+    class ThenablePromise;
+
+    namespace detail {
+        template <typename T>
+        struct get_future_type {
+        };
+
+        template <typename T>
+        struct get_future_type<std::future<T>> {
+            typedef T type;
+        };
+
+        template <typename T>
+        struct get_future_type<std::shared_future<T>> {
+            typedef T type;
+        };
+
+        template <typename T>
+        struct get_future_type<std::promise<T>> {
+            typedef T type;
+        };
+
+        template <typename T>
+        struct get_future_type<ThenableFuture<T>> {
+            typedef T type;
+        };
+
+        template <typename T>
+        struct get_future_type<ThenableSharedFuture<T>> {
+            typedef T type;
+        };
+
+        template <typename T>
+        struct get_future_type<ThenablePromise<T>> {
+            typedef T type;
+        };
+
+        template <typename T>
+        struct recursive_get_future_type {
+            typedef T type;
+        };
+
+        template <typename T>
+        struct recursive_get_future_type<std::future<T>> {
+            typedef typename recursive_get_future_type<T>::type type;
+        };
+
+        template <typename T>
+        struct recursive_get_future_type<std::shared_future<T>> {
+            typedef typename recursive_get_future_type<T>::type type;
+        };
+
+        template <typename T>
+        struct recursive_get_future_type<std::promise<T>> {
+            typedef typename recursive_get_future_type<T>::type type;
+        };
+
+        template <typename T>
+        struct recursive_get_future_type<ThenableFuture<T>> {
+            typedef typename recursive_get_future_type<T>::type type;
+        };
+
+        template <typename T>
+        struct recursive_get_future_type<ThenableSharedFuture<T>> {
+            typedef typename recursive_get_future_type<T>::type type;
+        };
+
+        template <typename T>
+        struct recursive_get_future_type<ThenablePromise<T>> {
+            typedef typename recursive_get_future_type<T>::type type;
+        };
+    }
+
+    template <typename Functor>
+    using recursive_result_of = typename detail::recursive_get_future_type<typename std::result_of<Functor()>::type>::type;
+
+    //////////
+
+    template <typename T>
+    constexpr ThenableFuture<T> to_thenable( std::future<T> && );
+
+    template <typename T>
+    constexpr ThenableSharedFuture<T> to_thenable( const std::shared_future<T> & );
+
+    template <typename T>
+    constexpr ThenableSharedFuture<T> to_thenable( std::shared_future<T> && );
+
+    template <typename T>
+    ThenablePromise<T> to_thenable( std::promise<T> && );
+
+    //////////
+
+    template <typename... Results>
+    constexpr std::tuple<ThenableFuture<Results>...> to_thenable( std::tuple<std::future<Results>...> && );
+
+    template <typename... Results>
+    constexpr std::tuple<ThenableSharedFuture<Results>...> to_thenable( std::tuple<std::shared_future<Results>...> && );
+
+    template <typename... Results>
+    std::tuple<ThenablePromise<Results>...> to_thenable( std::tuple<std::promise<Results>...> && );
+
+    //////////
+
+    template <typename... Results>
+    constexpr std::tuple<ThenableFuture<Results>...> to_thenable( std::tuple<ThenableFuture<Results>...> && );
+
+    template <typename... Results>
+    constexpr std::tuple<ThenableSharedFuture<Results>...> to_thenable( std::tuple<ThenableSharedFuture<Results>...> && );
+
+    template <typename... Results>
+    constexpr std::tuple<ThenablePromise<Results>...> to_thenable( std::tuple<ThenablePromise<Results>...> && );
+
+    //////////
+
+    template <typename T = void, typename Functor, typename LaunchPolicy = std::launch>
+    std::future<T> make_promise( Functor &&, LaunchPolicy = default_policy );
+
+    template <typename T = void, typename Functor, typename LaunchPolicy = std::launch>
+    ThenableFuture<T> make_promise2( Functor &&, LaunchPolicy && = std::launch( default_policy ));
+
+
+    //////////
+
+    template <typename... Functors>
+    std::tuple<std::future<recursive_result_of<Functors>>...> parallel( Functors &&... fns );
+
+    template <typename... Functors>
+    std::tuple<ThenableFuture<recursive_result_of<Functors>>...> parallel2( Functors &&... fns );
+
+    template <typename... Functors>
+    std::tuple<std::future<recursive_result_of<Functors>>...> parallel_n( size_t concurrency, Functors &&... fns );
+
+    template <typename... Functors>
+    std::tuple<ThenableFuture<recursive_result_of<Functors>>...> parallel2_n( size_t concurrency, Functors &&... fns );
+
+    //////////
+
+    template <typename Functor, typename... Args>
+    inline std::future<typename std::result_of<Functor( Args... )>::type> defer( Functor &&f, Args &&... args ) {
+        return std::async( std::launch::deferred, std::forward<Functor>( f ), std::forward<Args>( args )... );
     };
 
-    template <typename T, typename Functor>
-    inline std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T> s, Functor &&f, std::launch policy ) {
-        return then( std::move( s ), std::forward<Functor>( f ), policy );
-    };
+    template <typename Functor, typename... Args>
+    inline ThenableFuture<typename std::result_of<Functor( Args... )>::type> defer2( Functor &&f, Args &&... args ) {
+        return to_thenable( defer( std::forward<Functor>( f ), std::forward<Args>( args )... ));
+    };
+
+    //////////
+
+    namespace detail {
+        using namespace fn_traits;
+
+        template <typename Functor, typename T, std::size_t... S>
+        inline decltype( auto ) invoke_helper( Functor &&func, T &&t, std::index_sequence<S...> )
+        noexcept( noexcept( func( std::get<S>( std::forward<T>( t ))... ))) {
+            return func( std::get<S>( std::forward<T>( t ))... );
+        }
+
+        template <typename Functor, typename T>
+        inline decltype( auto ) invoke_tuple( Functor &&func, T &&t )
+        noexcept( noexcept( invoke_helper( std::forward<Functor>( func ), std::forward<T>( t ),
+                                           std::make_index_sequence<std::tuple_size<typename std::decay<T>::type>::value>{} ))) {
+            constexpr auto Size = std::tuple_size<typename std::decay<T>::type>::value;
+
+            return invoke_helper( std::forward<Functor>( func ),
+                                  std::forward<T>( t ),
+                                  std::make_index_sequence<Size>{} );
+        }
+
+        /*
+         * invoke_callback:
+         *
+         * Invokes a callback with a resolved value, unpacking tuples into multiple arguments.
+         * Anything returned by the callback is passed through as-is, and so is whether it's noexcept.
+         * */
+
+        template <typename Functor, typename... Args>
+        inline decltype( auto ) invoke_callback( Functor &&f, std::tuple<Args...> &&args )
+        noexcept( noexcept( invoke_tuple( std::forward<Functor>( f ), std::forward<std::tuple<Args...>>( args )))) {
+            return invoke_tuple( std::forward<Functor>( f ), std::forward<std::tuple<Args...>>( args ));
+        }
+
+        template <typename Functor, typename T>
+        inline decltype( auto ) invoke_callback( Functor &&f, T &&arg ) noexcept( noexcept( f( std::forward<T>( arg )))) {
+            return f( std::forward<T>( arg ));
+        }
+
+        template <typename Functor>
+        inline decltype( auto ) invoke_callback( Functor &&f ) noexcept( noexcept( f())) {
+            return f();
+        }
+
+        /*
+         * recursive_get:
+         *
+         * This will continually call "get" on any future or promise objects returned by another future,
+         * recursively, basically resolving the entire chain at once
+         * */
+
+        /*
+         * Forward declarations
+         * */
+
+        template <typename T>
+        typename recursive_get_future_type<T>::type recursive_get( std::future<T> && );
+
+        template <typename T>
+        typename recursive_get_future_type<T>::type recursive_get( std::shared_future<T> && );
+
+        template <typename T>
+        typename recursive_get_future_type<T>::type recursive_get( std::promise<T> && );
+
+        template <typename T>
+        typename recursive_get_future_type<T>::type recursive_get( ThenableFuture<T> && );
+
+        template <typename T>
+        typename recursive_get_future_type<T>::type recursive_get( ThenableSharedFuture<T> && );
+
+        template <typename T>
+        typename recursive_get_future_type<T>::type recursive_get( ThenablePromise<T> && );
+
+        template <typename T>
+        constexpr T recursive_get( T && ) THENABLE_NOEXCEPT;
+
+        /*
+         * std future implementations. ThenableX implementations are below their class implementation at the bottom of the file.
+         * */
+
+        template <typename T>
+        inline typename recursive_get_future_type<T>::type recursive_get( std::future<T> &&t ) {
+            return recursive_get( t.get());
+        };
+
+        template <typename T>
+        inline typename recursive_get_future_type<T>::type recursive_get( std::shared_future<T> &&t ) {
+            return recursive_get( t.get());
+        };
+
+        template <>
+        inline typename recursive_get_future_type<void>::type recursive_get<void>( std::future<void> &&t ) {
+            t.get();
+        };
+
+        template <>
+        inline typename recursive_get_future_type<void>::type recursive_get<void>( std::shared_future<void> &&t ) {
+            t.get();
+        };
+
+        template <typename T>
+        inline typename recursive_get_future_type<T>::type recursive_get( std::promise<T> &&t ) {
+            return recursive_get( t.get_future());
+        };
+
+        /*
+         * This just forwards anything that is NOT a promise or future and doesn't do anything to it.
+         * */
+        template <typename T>
+        constexpr T recursive_get( T &&t ) THENABLE_NOEXCEPT {
+            return std::forward<T>( t );
+        };
+
+        //////////
+
+        /*
+         * then_invoke_helper structure
+         *
+         * This just takes care of the invocation of the callback, forwarding arguments and so forth and
+         * taking care of any returned futures
+         * */
+
+        template <typename Functor, typename R = fn_result_of<Functor>>
+        struct then_invoke_helper {
+            /*
+             * If you're seeing any of the code below, it's probably because a callback given to `then` doesn't
+             * have the same argument types as the value being passed from the previous future.
+             * */
+
+            template <typename... Args>
+            inline static decltype( auto ) invoke( Functor &&f, std::tuple<Args...> &&args ) {
+                return recursive_get( invoke_callback( std::forward<Functor>( f ), std::forward<std::tuple<Args...>>( args )));
+            }
+
+            template <typename T>
+            inline static decltype( auto ) invoke( Functor &&f, T &&arg ) {
+                return recursive_get( invoke_callback( std::forward<Functor>( f ), std::forward<T>( arg )));
+            }
+
+            inline static decltype( auto ) invoke( Functor &&f ) {
+                return recursive_get( invoke_callback( std::forward<Functor>( f )));
+            }
+        };
+
+        /*
+         * Specialization of then_invoke_helper for void callbacks.
+         * */
+        template <typename Functor>
+        struct then_invoke_helper<Functor, void> {
+            /*
+             * If you're seeing any of the code below, it's probably because a callback given to `then` doesn't
+             * have the same argument types as the value being passed from the previous future.
+             * */
+
+            template <typename... Args>
+            inline static void invoke( Functor &&f, std::tuple<Args...> &&args ) {
+                invoke_callback( std::forward<Functor>( f ), std::forward<std::tuple<Args...>>( args ));
+            }
+
+            template <typename T>
+            inline static void invoke( Functor &&f, T &&arg ) {
+                invoke_callback( std::forward<Functor>( f ), std::forward<T>( arg ));
+            }
+
+            inline static void invoke( Functor &&f ) {
+                invoke_callback( std::forward<Functor>( f ));
+            }
+        };
+
+        //////////
+
+        /*
+         * then_helper structure
+         *
+         * This takes care of resolving the first given future, and optionally passing the
+         * resulting value to the callback function.
+         * */
+
+        template <typename T, typename Functor>
+        struct then_helper {
+            inline static decltype( auto ) dispatch( std::future<T> &&s, Functor &&f ) {
+                return then_invoke_helper<Functor>::invoke( std::forward<Functor>( f ), recursive_get( std::forward<std::future<T>>( s )));
+            }
+
+            inline static decltype( auto ) dispatch( std::shared_future<T> &&s, Functor &&f ) {
+                return then_invoke_helper<Functor>::invoke( std::forward<Functor>( f ), recursive_get( std::forward<std::shared_future<T>>( s )));
+            }
+        };
+
+        template <typename Functor>
+        struct then_helper<void, Functor> {
+            inline static decltype( auto ) dispatch( std::future<void> &&s, Functor &&f ) {
+                s.get();
+
+                return then_invoke_helper<Functor>::invoke( std::forward<Functor>( f ));
+            }
+
+            inline static decltype( auto ) dispatch( std::shared_future<void> &&s, Functor &&f ) {
+                s.get();
+
+                return then_invoke_helper<Functor>::invoke( std::forward<Functor>( f ));
+            }
+        };
+
+        //////////
+
+        /*
+         * detached_then_helper structure
+         *
+         * These provide a function for catching exceptions and forwarding the result of the callbacks to the promise.
+         *
+         * It also accounts for void callbacks which don't return anything.
+         * */
+
+        template <typename T>
+        struct detached_then_helper {
+            template <typename Functor, typename K>
+            static inline void dispatch( std::promise<T> &p, std::future<K> &&s, Functor &&f ) THENABLE_NOEXCEPT {
+                try {
+                    p.set_value( then_helper<K, Functor>::dispatch( std::forward<std::future<K>>( s ), std::forward<Functor>( f )));
+
+                } catch( ... ) {
+                    p.set_exception( std::current_exception());
+                }
+            }
+
+            template <typename Functor, typename K>
+            static inline void dispatch( std::promise<T> &p, std::shared_future<K> &&s, Functor &&f ) THENABLE_NOEXCEPT {
+                try {
+                    p.set_value( then_helper<K, Functor>::dispatch( std::forward<std::shared_future<K>>( s ), std::forward<Functor>( f )));
+
+                } catch( ... ) {
+                    p.set_exception( std::current_exception());
+                }
+            }
+        };
+
+        /*
+         * Specialization for void Functors
+         * */
+        template <>
+        struct detached_then_helper<void> {
+            template <typename Functor, typename K>
+            static inline void dispatch( std::promise<void> &p, std::future<K> &&s, Functor &&f ) THENABLE_NOEXCEPT {
+                try {
+                    then_helper<K, Functor>::dispatch( std::forward<std::future<K>>( s ), std::forward<Functor>( f ));
+
+                    p.set_value();
+
+                } catch( ... ) {
+                    p.set_exception( std::current_exception());
+                }
+            }
+
+            template <typename Functor, typename K>
+            static inline void dispatch( std::promise<void> &p, std::shared_future<K> &&s, Functor &&f ) THENABLE_NOEXCEPT {
+                try {
+                    then_helper<K, Functor>::dispatch( std::forward<std::shared_future<K>>( s ), std::forward<Functor>( f ));
+
+                    p.set_value();
+
+                } catch( ... ) {
+                    p.set_exception( std::current_exception());
+                }
+            }
+        };
+
+        template <typename T>
+        struct make_promise_helper {
+            template <typename Functor>
+            inline static void dispatch( Functor &&f, const std::shared_ptr<std::promise<T>> &p ) THENABLE_NOEXCEPT {
+                try {
+                    f( [p]( const T &resolved_value ) THENABLE_NOEXCEPT {
+                        p->set_value( resolved_value );
+
+                    }, [p]( auto rejected_value ) THENABLE_NOEXCEPT {
+                        p->set_exception( std::make_exception_ptr( rejected_value ));
+                    } );
+
+                } catch( ... ) {
+                    p->set_exception( std::current_exception());
+                }
+            }
+        };
+
+        template <>
+        struct make_promise_helper<void> {
+            template <typename Functor>
+            inline static void dispatch( Functor &&f, const std::shared_ptr<std::promise<void>> &p ) THENABLE_NOEXCEPT {
+                try {
+                    f( [p]() THENABLE_NOEXCEPT {
+                        p->set_value();
+
+                    }, [p]( auto rejected_value ) THENABLE_NOEXCEPT {
+                        p->set_exception( std::make_exception_ptr( rejected_value ));
+                    } );
+
+                } catch( ... ) {
+                    p->set_exception( std::current_exception());
+                }
+            }
+        };
+    }
+
+    //////////
+
+    namespace detail {
+        /*
+         * continuation structure
+         *
+         * A type-erased callback stored inside a shared state, which is run exactly once when that state is resolved.
+         * They form a singly linked list, so any number of them can be attached to a single state, and a pending
+         * continuation costs only a single small allocation instead of a whole thread sitting in .get()
+         *
+         * Continuations are released through destroy rather than delete, so one can also live inside a larger object
+         * that is kept alive some other way, such as the shared state it's going to resolve.
+         *
+         * A deferred task that first has to wait on another state can say so through dependency, so waiting on a long chain of
+         * deferred states runs them one after another instead of recursing through every one of them.
+         * */
+        class shared_state_base;
+
+        struct continuation;
+
+        struct continuation_deleter {
+            inline void operator()( continuation *c ) const THENABLE_NOEXCEPT;
+        };
+
+        typedef std::unique_ptr<continuation, continuation_deleter> continuation_ptr;
+
+        struct continuation {
+            continuation_ptr next;
+
+            virtual void run() THENABLE_NOEXCEPT = 0;
+
+            virtual void destroy() THENABLE_NOEXCEPT {
+                delete this;
+            }
+
+            virtual shared_state_base *dependency() const THENABLE_NOEXCEPT {
+                return nullptr;
+            }
+
+            protected:
+                virtual ~continuation() = default;
+        };
+
+        inline void continuation_deleter::operator()( continuation *c ) const THENABLE_NOEXCEPT {
+            c->destroy();
+        }
+
+        template <typename Functor>
+        struct continuation_impl final : continuation {
+            Functor f;
+
+#ifdef THENABLE_HAS_CXX17
+            std::pmr::memory_resource *resource = nullptr;
+#endif
+
+            template <typename F>
+            inline continuation_impl( F &&_f ) : f( std::forward<F>( _f )) {}
+
+            void run() THENABLE_NOEXCEPT override {
+                f();
+            }
+
+            void destroy() THENABLE_NOEXCEPT override {
+#ifdef THENABLE_HAS_CXX17
+                std::pmr::memory_resource *r = resource;
+#endif
+
+                this->~continuation_impl();
+
+#ifdef THENABLE_HAS_CXX17
+                if( r ) {
+                    r->deallocate( this, sizeof( continuation_impl ), alignof( continuation_impl ));
+
+                    return;
+                }
+#endif
+
+                pool_deallocate( this, sizeof( continuation_impl ), alignof( continuation_impl ));
+            }
+        };
+
+        /*
+         * Continuations come from the current memory resource if there is one, or from the recycling pool otherwise
+         * */
+        template <typename Functor>
+        inline continuation_ptr make_continuation( Functor &&f ) {
+            typedef continuation_impl<typename std::decay<Functor>::type> impl_type;
+
+#ifdef THENABLE_HAS_CXX17
+            std::pmr::memory_resource *r = current_resource();
+
+            void *p = r ? r->allocate( sizeof( impl_type ), alignof( impl_type )) : pool_allocate( sizeof( impl_type ), alignof( impl_type ));
+#else
+            void *p = pool_allocate( sizeof( impl_type ), alignof( impl_type ));
+#endif
+
+            impl_type *c;
+
+            try {
+                c = new( p ) impl_type( std::forward<Functor>( f ));
+
+            } catch( ... ) {
+#ifdef THENABLE_HAS_CXX17
+                if( r ) {
+                    r->deallocate( p, sizeof( impl_type ), alignof( impl_type ));
+
+                    throw;
+                }
+#endif
+
+                pool_deallocate( p, sizeof( impl_type ), alignof( impl_type ));
+
+                throw;
+            }
+
+#ifdef THENABLE_HAS_CXX17
+            c->resource = r;
+#endif
+
+            return continuation_ptr( c );
+        }
+
+        /*
+         * Allocates the shared states and other reference counted objects behind the Thenable types, from the current
+         * memory resource if there is one, or the recycling pool otherwise. The allocator is kept in the control block,
+         * so they're always freed to the right place.
+         * */
+        template <typename T, typename... Args>
+        inline std::shared_ptr<T> make_state( Args &&... args ) {
+#ifdef THENABLE_HAS_CXX17
+            if( std::pmr::memory_resource *r = current_resource()) {
+                return std::allocate_shared<T>( std::pmr::polymorphic_allocator<T>( r ), std::forward<Args>( args )... );
+            }
+#endif
+
+            return std::allocate_shared<T>( pool_allocator<T>(), std::forward<Args>( args )... );
+        }
+
+        /*
+         * Same as above, for the standard promises used by the overloads that return standard futures
+         * */
+        template <typename T>
+        inline std::promise<T> make_std_promise() {
+#ifdef THENABLE_HAS_CXX17
+            if( std::pmr::memory_resource *r = current_resource()) {
+                return std::promise<T>( std::allocator_arg, std::pmr::polymorphic_allocator<char>( r ));
+            }
+#endif
+
+            return std::promise<T>( std::allocator_arg, pool_allocator<char>());
+        }
+
+        /*
+         * Continuations are pushed onto the front of the list, so this reverses them first to run them in the order they were attached.
+         *
+         * Everything is done iteratively so a state with thousands of continuations doesn't recurse through thousands of unique_ptr destructors.
+         * */
+        inline void run_continuations( continuation_ptr head ) THENABLE_NOEXCEPT {
+            continuation_ptr reversed;
+
+            while( head ) {
+                auto next = std::move( head->next );
+
+                head->next = std::move( reversed );
+                reversed   = std::move( head );
+                head       = std::move( next );
+            }
+
+            while( reversed ) {
+                auto next = std::move( reversed->next );
+
+                reversed->run();
+                reversed = std::move( next );
+            }
+        }
+
+        inline void discard_continuations( continuation_ptr head ) THENABLE_NOEXCEPT {
+            while( head ) {
+                head = std::move( head->next );
+            }
+        }
+
+        /*
+         * unique_task class
+         *
+         * A move-only task that keeps small callables inline, for the queues that hold work by value. Most tasks thenable
+         * queues only capture a few shared_ptrs, so they fit and queueing them doesn't allocate.
+         *
+         * A continuation that already exists can be adopted as well, in which case only its pointer is stored.
+         * */
+        class unique_task {
+                struct vtable {
+                    void (*invoke)( void * ) THENABLE_NOEXCEPT;
+                    void (*relocate)( void *, void * ) THENABLE_NOEXCEPT;
+                    void (*destroy)( void * ) THENABLE_NOEXCEPT;
+                };
+
+                template <typename Functor>
+                struct ops {
+                    static inline void invoke( void *p ) THENABLE_NOEXCEPT {
+                        ( *static_cast<Functor *>( p ))();
+                    }
+
+                    static inline void relocate( void *to, void *from ) THENABLE_NOEXCEPT {
+                        new( to ) Functor( std::move( *static_cast<Functor *>( from )));
+
+                        static_cast<Functor *>( from )->~Functor();
+                    }
+
+                    static inline void destroy( void *p ) THENABLE_NOEXCEPT {
+                        static_cast<Functor *>( p )->~Functor();
+                    }
+
+                    static inline const vtable *table() THENABLE_NOEXCEPT {
+                        static const vtable t = { &invoke, &relocate, &destroy };
+
+                        return &t;
+                    }
+                };
+
+                struct adopted {
+                    continuation_ptr c;
+
+                    inline adopted( continuation_ptr &&_c ) THENABLE_NOEXCEPT : c( std::move( _c )) {}
+
+                    inline void operator()() THENABLE_NOEXCEPT {
+                        c->run();
+                    }
+                };
+
+                template <typename Functor>
+                using fits_inline = std::integral_constant<bool, sizeof( Functor ) <= task_buffer_size &&
+                                                                 alignof( Functor ) <= alignof( std::max_align_t ) &&
+                                                                 std::is_nothrow_move_constructible<Functor>::value>;
+
+                alignas( std::max_align_t ) unsigned char buffer[task_buffer_size < sizeof( adopted ) ? sizeof( adopted ) : task_buffer_size];
+
+                const vtable *vt;
+
+                template <typename Functor, typename... Args>
+                inline void emplace( Args &&... args ) {
+                    new( buffer ) Functor( std::forward<Args>( args )... );
+
+                    vt = ops<Functor>::table();
+                }
+
+                template <typename Functor>
+                inline void construct( Functor &&f, std::true_type ) {
+                    emplace<typename std::decay<Functor>::type>( std::forward<Functor>( f ));
+                }
+
+                template <typename Functor>
+                inline void construct( Functor &&f, std::false_type ) {
+                    emplace<adopted>( make_continuation( std::forward<Functor>( f )));
+                }
+
+            public:
+                inline unique_task() THENABLE_NOEXCEPT : vt( nullptr ) {}
+
+                inline unique_task( continuation_ptr &&c ) THENABLE_NOEXCEPT : vt( nullptr ) {
+                    if( c ) {
+                        emplace<adopted>( std::move( c ));
+                    }
+                }
+
+                template <typename Functor, typename = typename std::enable_if<!std::is_same<typename std::decay<Functor>::type, unique_task>::value &&
+                                                                              !std::is_same<typename std::decay<Functor>::type, continuation_ptr>::value>::type>
+                inline unique_task( Functor &&f ) : vt( nullptr ) {
+                    construct( std::forward<Functor>( f ), fits_inline<typename std::decay<Functor>::type>());
+                }
+
+                inline unique_task( unique_task &&other ) THENABLE_NOEXCEPT : vt( other.vt ) {
+                    if( vt ) {
+                        vt->relocate( buffer, other.buffer );
+
+                        other.vt = nullptr;
+                    }
+                }
+
+                inline unique_task &operator=( unique_task &&other ) THENABLE_NOEXCEPT {
+                    if( this != &other ) {
+                        reset();
+
+                        if( other.vt ) {
+                            other.vt->relocate( buffer, other.buffer );
+
+                            vt       = other.vt;
+                            other.vt = nullptr;
+                        }
+                    }
+
+                    return *this;
+                }
+
+                unique_task( const unique_task & ) = delete;
+
+                unique_task &operator=( const unique_task & ) = delete;
+
+                inline ~unique_task() {
+                    reset();
+                }
+
+                inline void reset() THENABLE_NOEXCEPT {
+                    if( vt ) {
+                        vt->destroy( buffer );
+
+                        vt = nullptr;
+                    }
+                }
+
+                inline explicit operator bool() const THENABLE_NOEXCEPT {
+                    return vt != nullptr;
+                }
+
+                inline void operator()() THENABLE_NOEXCEPT {
+                    vt->invoke( buffer );
+                }
+        };
+
+        /*
+         * thread_cache class
+         *
+         * Backs everything that promises to run a task on its own thread. Instead of exiting, a thread that finishes its
+         * task parks for detached_keep_alive waiting for another one, and new threads are only created when none are parked.
+         * Tasks never queue behind each other, so this keeps the same guarantee as spawning a thread for every task.
+         *
+         * The cache is intentionally leaked, since parked threads may still be using it during static destruction.
+         * */
+        class thread_cache {
+                struct parked_thread {
+                    std::condition_variable cv;
+                    unique_task             task;
+                };
+
+                std::mutex                  mtx;
+                std::vector<parked_thread *> idle;
+
+                inline void worker( unique_task task ) THENABLE_NOEXCEPT {
+                    parked_thread self;
+
+                    while( task ) {
+                        task();
+                        task.reset();
+
+                        std::unique_lock<std::mutex> lock( mtx );
+
+                        //Parked threads are reused most recent first, so the ones that time out are the ones that have been idle longest
+                        idle.push_back( &self );
+
+                        if( self.cv.wait_for( lock, detached_keep_alive, [&self] { return static_cast<bool>( self.task ); } )) {
+                            task = std::move( self.task );
+
+                        } else {
+                            idle.erase( std::find( idle.begin(), idle.end(), &self ));
+                        }
+                    }
+                }
+
+            public:
+                static inline thread_cache &instance() {
+                    static thread_cache *cache = new thread_cache();
+
+                    return *cache;
+                }
+
+                inline void submit( unique_task &&task ) {
+                    {
+                        std::lock_guard<std::mutex> lock( mtx );
+
+                        if( !idle.empty()) {
+                            parked_thread *t = idle.back();
+
+                            idle.pop_back();
+
+                            t->task = std::move( task );
+                            t->cv.notify_one();
+
+                            return;
+                        }
+                    }
+
+                    std::thread( [this]( unique_task &&task2 ) THENABLE_NOEXCEPT {
+                        worker( std::move( task2 ));
+                    }, std::move( task )).detach();
+                }
+        };
+
+        /*
+         * timer_queue class
+         *
+         * A single background thread that runs tasks once their deadlines pass, so timeouts don't each need a thread sleeping on them.
+         * It's started the first time it's needed, and leaked for the same reason as thread_cache.
+         *
+         * Tasks are run on the timer thread itself, so they should only do as much as it takes to hand work off elsewhere.
+         * */
+        class timer_queue {
+                typedef std::chrono::steady_clock clock;
+
+                struct entry {
+                    clock::time_point when;
+                    unique_task       task;
+                };
+
+                struct later {
+                    inline bool operator()( const entry &a, const entry &b ) const THENABLE_NOEXCEPT {
+                        return a.when > b.when;
+                    }
+                };
+
+                std::mutex              mtx;
+                std::condition_variable cv;
+                std::vector<entry>      heap;
+
+                inline void run() THENABLE_NOEXCEPT {
+                    std::unique_lock<std::mutex> lock( mtx );
+
+                    while( true ) {
+                        if( heap.empty()) {
+                            cv.wait( lock );
+
+                        } else if( heap.front().when <= clock::now()) {
+                            std::pop_heap( heap.begin(), heap.end(), later());
+
+                            unique_task task = std::move( heap.back().task );
+
+                            heap.pop_back();
+
+                            lock.unlock();
+
+                            task();
+                            task.reset();
+
+                            lock.lock();
+
+                        } else {
+                            cv.wait_until( lock, heap.front().when );
+                        }
+                    }
+                }
+
+                inline timer_queue() {
+                    std::thread( [this]() THENABLE_NOEXCEPT {
+                        run();
+                    } ).detach();
+                }
+
+            public:
+                static inline timer_queue &instance() {
+                    static timer_queue *queue = new timer_queue();
+
+                    return *queue;
+                }
+
+                inline void schedule( clock::time_point when, unique_task &&task ) {
+                    std::lock_guard<std::mutex> lock( mtx );
+
+                    //Only wake the timer thread if this is now the earliest deadline
+                    bool earliest = heap.empty() || when < heap.front().when;
+
+                    heap.push_back( entry{ when, std::move( task ) } );
+
+                    std::push_heap( heap.begin(), heap.end(), later());
+
+                    if( earliest ) {
+                        cv.notify_one();
+                    }
+                }
+        };
+
+        /*
+         * Runs a task on a thread of its own, reusing a parked one if there is one
+         * */
+        template <typename Task>
+        inline void spawn_detached( Task &&task ) {
+            thread_cache::instance().submit( unique_task( std::forward<Task>( task )));
+        }
+
+        /*
+         * wait_hook structure
+         *
+         * An executor that runs its tasks as fibers can install one of these on its threads, so that waiting on a pending state
+         * from one of those tasks suspends only the fiber instead of blocking the whole thread. suspend must not return before
+         * the state is resolved.
+         * */
+        struct wait_hook {
+            virtual void suspend( shared_state_base &s ) = 0;
+
+            static inline wait_hook *&current() THENABLE_NOEXCEPT {
+                static thread_local wait_hook *hook = nullptr;
+
+                return hook;
+            }
+
+            protected:
+                ~wait_hook() = default;
+        };
+
+        /*
+         * shared_state_base class
+         *
+         * This is the thenable equivalent of the shared state behind std::promise and std::future, except that instead of
+         * only being able to block on it, callbacks can be attached that are run by whichever thread resolves it.
+         *
+         * A state can also hold a deferred task, which is run by the first thread that waits on it. That's used for deferred launch policies
+         * and for adapting plain std::futures, which can only be resolved by blocking on them.
+         *
+         * The status is only changed while holding the mutex, but it's published with a release store after the result is written,
+         * so checking whether a state is ready and reading its result afterwards never has to lock.
+         * */
+        class shared_state_base {
+            public:
+                enum class status : unsigned char {
+                        pending,
+                        value,
+                        exception
+                };
+
+            protected:
+                mutable std::mutex              mtx;
+                mutable std::condition_variable cv;
+                std::atomic<status>             st{ status::pending };
+                std::exception_ptr              error;
+                continuation_ptr                continuations;
+                continuation_ptr                deferred;
+
+                template <typename Setter>
+                inline void complete( Setter &&setter ) {
+                    continuation_ptr ready;
+
+                    {
+                        std::lock_guard<std::mutex> lock( mtx );
+
+                        if( st.load( std::memory_order_relaxed ) != status::pending ) {
+                            throw std::future_error( std::future_errc::promise_already_satisfied );
+                        }
+
+                        st.store( setter(), std::memory_order_release );
+
+                        ready = std::move( continuations );
+                    }
+
+                    cv.notify_all();
+
+                    run_continuations( std::move( ready ));
+                }
+
+                inline void rethrow_if_exception() const {
+                    if( st.load( std::memory_order_acquire ) == status::exception ) {
+                        std::rethrow_exception( error );
+                    }
+                }
+
+            public:
+                shared_state_base() = default;
+
+                shared_state_base( const shared_state_base & ) = delete;
+
+                shared_state_base &operator=( const shared_state_base & ) = delete;
+
+                inline ~shared_state_base() {
+                    discard_continuations( std::move( continuations ));
+                }
+
+                inline bool is_ready() const THENABLE_NOEXCEPT {
+                    return st.load( std::memory_order_acquire ) != status::pending;
+                }
+
+                /*
+                 * The exception the state was resolved with, or null if it's pending or holds a value
+                 * */
+                inline std::exception_ptr exception() const THENABLE_NOEXCEPT {
+                    return st.load( std::memory_order_acquire ) == status::exception ? error : nullptr;
+                }
+
+                inline bool is_deferred() const {
+                    std::lock_guard<std::mutex> lock( mtx );
+
+                    return deferred != nullptr;
+                }
+
+                /*
+                 * The deferred task is given a raw pointer to this state rather than owning it, so it must only be set right after creation
+                 * */
+                inline void set_deferred( continuation_ptr &&d ) {
+                    std::lock_guard<std::mutex> lock( mtx );
+
+                    deferred = std::move( d );
+                }
+
+                /*
+                 * Runs a deferred task after any deferred tasks it depends on, using the continuations themselves as an explicit stack
+                 * */
+                static inline void run_deferred( continuation_ptr d ) THENABLE_NOEXCEPT {
+                    continuation_ptr stack;
+
+                    while( shared_state_base *dependency = d->dependency()) {
+                        continuation_ptr first = dependency->take_deferred();
+
+                        if( !first ) {
+                            break;
+                        }
+
+                        d->next = std::move( stack );
+                        stack   = std::move( d );
+                        d       = std::move( first );
+                    }
+
+                    while( d ) {
+                        d->run();
+
+                        d = std::move( stack );
+
+                        if( d ) {
+                            stack = std::move( d->next );
+                        }
+                    }
+                }
+
+                inline continuation_ptr take_deferred() {
+                    std::lock_guard<std::mutex> lock( mtx );
+
+                    return std::move( deferred );
+                }
+
+                inline void wait() {
+                    if( is_ready()) {
+                        return;
+                    }
+
+                    std::unique_lock<std::mutex> lock( mtx );
+
+                    if( deferred ) {
+                        auto d = std::move( deferred );
+
+                        lock.unlock();
+
+                        run_deferred( std::move( d ));
+
+                        lock.lock();
+                    }
+
+                    if( !is_ready()) {
+                        if( wait_hook *hook = wait_hook::current()) {
+                            lock.unlock();
+
+                            hook->suspend( *this );
+
+                            return;
+                        }
+                    }
+
+                    cv.wait( lock, [this] { return is_ready(); } );
+                }
+
+                template <typename Rep, typename Period>
+                inline std::future_status wait_for( const std::chrono::duration<Rep, Period> &timeout_duration ) const {
+                    if( is_ready()) {
+                        return std::future_status::ready;
+                    }
+
+                    std::unique_lock<std::mutex> lock( mtx );
+
+                    if( deferred ) {
+                        return std::future_status::deferred;
+                    }
+
+                    return cv.wait_for( lock, timeout_duration, [this] { return is_ready(); } )
+                           ? std::future_status::ready : std::future_status::timeout;
+                }
+
+                template <typename Clock, typename Duration>
+                inline std::future_status wait_until( const std::chrono::time_point<Clock, Duration> &timeout_time ) const {
+                    if( is_ready()) {
+                        return std::future_status::ready;
+                    }
+
+                    std::unique_lock<std::mutex> lock( mtx );
+
+                    if( deferred ) {
+                        return std::future_status::deferred;
+                    }
+
+                    return cv.wait_until( lock, timeout_time, [this] { return is_ready(); } )
+                           ? std::future_status::ready : std::future_status::timeout;
+                }
+
+                /*
+                 * Attaches a continuation, or runs it immediately if the state is already resolved.
+                 *
+                 * If the state still has a deferred task, nothing would ever run it for the continuation, so it's
+                 * handed back to the caller to be launched somewhere.
+                 * */
+                inline continuation_ptr add_continuation( continuation_ptr &&c ) {
+                    if( is_ready()) {
+                        c->run();
+
+                        return nullptr;
+                    }
+
+                    std::unique_lock<std::mutex> lock( mtx );
+
+                    if( st.load( std::memory_order_relaxed ) != status::pending ) {
+                        lock.unlock();
+
+                        c->run();
+
+                        return nullptr;
+                    }
+
+                    c->next       = std::move( continuations );
+                    continuations = std::move( c );
+
+                    return std::move( deferred );
+                }
+
+                inline void set_exception( std::exception_ptr e ) {
+                    complete( [&] {
+                        error = e;
+
+                        return status::exception;
+                    } );
+                }
+        };
+
+        template <typename T>
+        class shared_state : public shared_state_base {
+                typename std::aligned_storage<sizeof( T ), alignof( T )>::type storage;
+
+                inline T *ptr() THENABLE_NOEXCEPT {
+                    return reinterpret_cast<T *>(&storage);
+                }
+
+            public:
+                inline ~shared_state() {
+                    if( st.load( std::memory_order_relaxed ) == status::value ) {
+                        ptr()->~T();
+                    }
+                }
+
+                template <typename U>
+                inline void set_value( U &&value ) {
+                    complete( [&] {
+                        new( &storage ) T( std::forward<U>( value ));
+
+                        return status::value;
+                    } );
+                }
+
+                /*
+                 * take and peek must only be called once the state is ready.
+                 *
+                 * take moves the value out for unique futures, peek gives shared futures a reference to it.
+                 * */
+
+                inline T take() {
+                    rethrow_if_exception();
+
+                    return std::move( *ptr());
+                }
+
+                inline const T &peek() {
+                    rethrow_if_exception();
+
+                    return *ptr();
+                }
+        };
+
+        template <typename T>
+        class shared_state<T &> : public shared_state_base {
+                T *value_ptr = nullptr;
+
+            public:
+                inline void set_value( T &value ) {
+                    complete( [&] {
+                        value_ptr = &value;
+
+                        return status::value;
+                    } );
+                }
+
+                inline T &take() {
+                    rethrow_if_exception();
+
+                    return *value_ptr;
+                }
+
+                inline T &peek() {
+                    return take();
+                }
+        };
+
+        template <>
+        class shared_state<void> : public shared_state_base {
+            public:
+                inline void set_value() {
+                    complete( [] {
+                        return status::value;
+                    } );
+                }
+
+                inline void take() {
+                    rethrow_if_exception();
+                }
+
+                inline void peek() {
+                    rethrow_if_exception();
+                }
+        };
+
+        /*
+         * Attaches a continuation to a state, and if that state was still deferred, launches its deferred task on a thread of its own.
+         * The launched thread keeps the state alive until the task is done.
+         * */
+        template <typename T>
+        inline void attach_continuation( const std::shared_ptr<shared_state<T>> &s, continuation_ptr &&c ) {
+            auto d = s->add_continuation( std::move( c ));
+
+            if( d ) {
+                try {
+                    thread_cache::instance().submit( unique_task( [s, d2 = std::move( d )]() mutable THENABLE_NOEXCEPT {
+                        //The deferred task may live inside the state, so it has to go first
+                        shared_state_base::run_deferred( std::move( d2 ));
+                    } ));
+
+                } catch( ... ) {
+                    s->set_exception( std::current_exception());
+                }
+            }
+        }
+
+        /*
+         * ready_value class
+         *
+         * The result of a ThenableFuture that was already resolved when it was created, held inline by the future itself.
+         * It's only moved into a shared state if something needs one, such as sharing the future or waiting on it alongside others.
+         * */
+        struct ready_value_base {
+            std::exception_ptr error;
+            bool               has_result;
+
+            inline ready_value_base() THENABLE_NOEXCEPT : has_result( false ) {}
+
+            inline ready_value_base( ready_value_base &&other ) THENABLE_NOEXCEPT : error( std::move( other.error )), has_result( other.has_result ) {
+                other.has_result = false;
+            }
+
+            inline ready_value_base &operator=( ready_value_base &&other ) THENABLE_NOEXCEPT {
+                error = std::move( other.error );
+                has_result = other.has_result;
+
+                other.has_result = false;
+
+                return *this;
+            }
+
+            inline bool engaged() const THENABLE_NOEXCEPT {
+                return has_result;
+            }
+
+            inline void set_exception( std::exception_ptr e ) THENABLE_NOEXCEPT {
+                error = e;
+                has_result = true;
+            }
+        };
+
+        template <typename T>
+        class ready_value : public ready_value_base {
+                typename std::aligned_storage<sizeof( T ), alignof( T )>::type storage;
+
+                inline T *value() THENABLE_NOEXCEPT {
+                    return reinterpret_cast<T *>( &storage );
+                }
+
+                inline bool has_value() const THENABLE_NOEXCEPT {
+                    return has_result && !error;
+                }
+
+            public:
+                ready_value() THENABLE_NOEXCEPT = default;
+
+                inline ready_value( ready_value &&other ) THENABLE_NOEXCEPT {
+                    *this = std::move( other );
+                }
+
+                inline ready_value &operator=( ready_value &&other ) THENABLE_NOEXCEPT {
+                    if( this != &other ) {
+                        reset();
+
+                        if( other.has_value()) {
+                            new( &storage ) T( std::move( *other.value()));
+
+                            other.value()->~T();
+                        }
+
+                        ready_value_base::operator=( std::move( other ));
+                    }
+
+                    return *this;
+                }
+
+                inline ~ready_value() {
+                    reset();
+                }
+
+                inline void reset() THENABLE_NOEXCEPT {
+                    if( has_value()) {
+                        value()->~T();
+                    }
+
+                    error = nullptr;
+                    has_result = false;
+                }
+
+                template <typename U>
+                inline void set_value( U &&v ) {
+                    new( &storage ) T( std::forward<U>( v ));
+
+                    has_result = true;
+                }
+
+                inline T take() {
+                    if( error ) {
+                        std::rethrow_exception( error );
+                    }
+
+                    return std::move( *value());
+                }
+
+                /*
+                 * Moves the result into a fresh shared state, leaving this empty
+                 * */
+                inline void store( shared_state<T> &s ) {
+                    if( error ) {
+                        s.set_exception( error );
+
+                    } else {
+                        s.set_value( std::move( *value()));
+                    }
+
+                    reset();
+                }
+        };
+
+        template <typename T>
+        class ready_value<T &> : public ready_value_base {
+                T *value;
+
+            public:
+                inline ready_value() THENABLE_NOEXCEPT : value( nullptr ) {}
+
+                ready_value( ready_value && ) THENABLE_NOEXCEPT = default;
+
+                ready_value &operator=( ready_value && ) THENABLE_NOEXCEPT = default;
+
+                inline void set_value( T &v ) THENABLE_NOEXCEPT {
+                    value = &v;
+                    has_result = true;
+                }
+
+                inline T &take() {
+                    if( error ) {
+                        std::rethrow_exception( error );
+                    }
+
+                    return *value;
+                }
+
+                inline void store( shared_state<T &> &s ) {
+                    if( error ) {
+                        s.set_exception( error );
+
+                    } else {
+                        s.set_value( *value );
+                    }
+
+                    *this = ready_value();
+                }
+        };
+
+        template <>
+        class ready_value<void> : public ready_value_base {
+            public:
+                ready_value() THENABLE_NOEXCEPT = default;
+
+                ready_value( ready_value && ) THENABLE_NOEXCEPT = default;
+
+                ready_value &operator=( ready_value && ) THENABLE_NOEXCEPT = default;
+
+                inline void set_value() THENABLE_NOEXCEPT {
+                    has_result = true;
+                }
+
+                inline void take() {
+                    if( error ) {
+                        std::rethrow_exception( error );
+                    }
+                }
+
+                inline void store( shared_state<void> &s ) {
+                    if( error ) {
+                        s.set_exception( error );
+
+                    } else {
+                        s.set_value();
+                    }
+
+                    *this = ready_value();
+                }
+        };
+
+        template <typename T>
+        inline void check_state( const std::shared_ptr<shared_state<T>> &s ) {
+            if( !s ) {
+                throw std::future_error( std::future_errc::no_state );
+            }
+        }
+
+        /*
+         * state_access structure
+         *
+         * Gives the rest of the library access to the shared states behind the Thenable types without making them public.
+         * */
+        struct state_access {
+            /*
+             * A future that was ready from the start only gets a shared state once something asks for it
+             * */
+            template <typename T>
+            static inline std::shared_ptr<shared_state<T>> &get( ThenableFuture<T> &f ) {
+                if( f.ready.engaged()) {
+                    auto s = make_state<shared_state<T>>();
+
+                    f.ready.store( *s );
+
+                    f.state = std::move( s );
+                }
+
+                return f.state;
+            }
+
+            template <typename T>
+            static inline ready_value<T> &get_ready( ThenableFuture<T> &f ) THENABLE_NOEXCEPT {
+                return f.ready;
+            }
+
+            template <typename T>
+            static inline std::shared_ptr<shared_state<T>> &get( ThenableSharedFuture<T> &f ) THENABLE_NOEXCEPT {
+                return f.state;
+            }
+
+            template <typename T>
+            static inline const std::shared_ptr<shared_state<T>> &get( const ThenableSharedFuture<T> &f ) THENABLE_NOEXCEPT {
+                return f.state;
+            }
+
+            template <typename T>
+            static inline std::shared_ptr<shared_state<T>> &get( ThenablePromise<T> &p ) THENABLE_NOEXCEPT {
+                return p.state;
+            }
+
+            template <typename T>
+            static inline ThenableFuture<T> make_future( std::shared_ptr<shared_state<T>> &&s ) THENABLE_NOEXCEPT {
+                return ThenableFuture<T>( std::move( s ));
+            }
+
+            template <typename T>
+            static inline ThenableFuture<T> make_future( ready_value<T> &&v ) THENABLE_NOEXCEPT {
+                return ThenableFuture<T>( std::move( v ));
+            }
+        };
+
+        /*
+         * future_adapter structure
+         *
+         * Moves the result of a std::future or std::shared_future into a shared state, including exceptions.
+         * */
+        template <typename T>
+        struct future_adapter {
+            template <typename Future>
+            static inline void store( shared_state<T> &s, Future &f ) THENABLE_NOEXCEPT {
+                try {
+                    s.set_value( f.get());
+
+                } catch( ... ) {
+                    s.set_exception( std::current_exception());
+                }
+            }
+        };
+
+        template <>
+        struct future_adapter<void> {
+            template <typename Future>
+            static inline void store( shared_state<void> &s, Future &f ) THENABLE_NOEXCEPT {
+                try {
+                    f.get();
+
+                    s.set_value();
+
+                } catch( ... ) {
+                    s.set_exception( std::current_exception());
+                }
+            }
+        };
+
+        /*
+         * Wraps a std::future or std::shared_future in a shared state. If it's already resolved the value is taken right away,
+         * otherwise blocking on it is left as the deferred task of the state.
+         *
+         * The deferred task only holds a weak reference, since whoever runs it will be holding a strong one.
+         * */
+        template <typename T, typename Future>
+        inline std::shared_ptr<shared_state<T>> adapt_future( Future &&f ) {
+            typedef typename std::decay<Future>::type future_type;
+
+            if( !f.valid()) {
+                return nullptr;
+            }
+
+            auto s = make_state<shared_state<T>>();
+
+            if( f.wait_for( std::chrono::seconds( 0 )) == std::future_status::ready ) {
+                future_adapter<T>::store( *s, f );
+
+            } else {
+                std::weak_ptr<shared_state<T>> weak = s;
+
+                s->set_deferred( make_continuation( [weak, f2 = future_type( std::forward<Future>( f ))]() mutable THENABLE_NOEXCEPT {
+                    if( auto s2 = weak.lock()) {
+                        future_adapter<T>::store( *s2, f2 );
+                    }
+                } ));
+            }
+
+            return s;
+        }
+
+        /*
+         * promise_adapter structure
+         *
+         * The other way around, moving the result of a shared state into a std::promise, including exceptions.
+         * */
+        template <typename T>
+        struct promise_adapter {
+            template <typename Getter>
+            static inline void store( std::promise<T> &p, Getter &&get ) THENABLE_NOEXCEPT {
+                try {
+                    p.set_value( get());
+
+                } catch( ... ) {
+                    p.set_exception( std::current_exception());
+                }
+            }
+        };
+
+        template <>
+        struct promise_adapter<void> {
+            template <typename Getter>
+            static inline void store( std::promise<void> &p, Getter &&get ) THENABLE_NOEXCEPT {
+                try {
+                    get();
+
+                    p.set_value();
+
+                } catch( ... ) {
+                    p.set_exception( std::current_exception());
+                }
+            }
+        };
+
+        /*
+         * Hands the result of a shared state over to a std::future through a continuation, so nothing blocks on the state.
+         * A deferred state stays deferred until the std::future is waited on.
+         * */
+        template <typename T, typename Getter>
+        inline std::future<T> adapt_state( const std::shared_ptr<shared_state<T>> &s, Getter get ) {
+            if( s->is_deferred()) {
+                return std::async( std::launch::deferred, [s, get]() -> T {
+                    s->wait();
+
+                    return get( *s );
+                } );
+            }
+
+            auto p = make_state<std::promise<T>>();
+
+            attach_continuation( s, make_continuation( [s, p, get]() THENABLE_NOEXCEPT {
+                promise_adapter<T>::store( *p, [&]() -> T {
+                    return get( *s );
+                } );
+            } ));
+
+            return p->get_future();
+        }
+    }
+
+    namespace detail {
+        /*
+         * Maps the Thenable types to the standard future they behave like, so the result of a callback can be deduced the same way for both
+         * */
+        template <typename T>
+        struct std_future_type {
+            typedef T type;
+        };
+
+        template <typename T>
+        struct std_future_type<ThenableFuture<T>> {
+            typedef std::future<T> type;
+        };
+
+        template <typename T>
+        struct std_future_type<ThenableSharedFuture<T>> {
+            typedef std::shared_future<T> type;
+        };
+
+        template <typename T>
+        struct std_future_type<ThenablePromise<T>> {
+            typedef std::future<T> type;
+        };
+    }
+
+    //This is fun...
+    template <typename Functor, typename FutureType>
+    using implicit_result_of = decltype( detail::then_helper<typename detail::get_future_type<typename std::remove_reference<FutureType>::type>::type, Functor>::dispatch(
+        std::declval<typename detail::std_future_type<typename std::remove_reference<FutureType>::type>::type>(), std::forward<Functor>( std::declval<Functor>())));
+
+    //////////
+
+    template <typename T, typename Functor>
+    std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &, Functor &&, std::launch = default_policy );
+
+    template <typename T, typename Functor>
+    std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T> &&, Functor &&, std::launch = default_policy );
+
+    template <typename T, typename Functor>
+    std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T>, Functor &&, std::launch = default_policy );
+
+    template <typename T, typename Functor>
+    std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &&, Functor &&, std::launch = default_policy );
+
+    template <typename T, typename Functor>
+    std::future<implicit_result_of<Functor, std::future<T>>> then( std::promise<T> &, Functor &&, std::launch = default_policy );
+
+    //////////
+
+    template <typename T, typename Functor>
+    std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &, Functor &&, then_launch );
+
+    template <typename T, typename Functor>
+    std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T> &&, Functor &&, then_launch );
+
+    template <typename T, typename Functor>
+    std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T>, Functor &&, then_launch );
+
+    template <typename T, typename Functor>
+    std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &&, Functor &&, then_launch );
+
+    template <typename T, typename Functor>
+    std::future<implicit_result_of<Functor, std::future<T>>> then( std::promise<T> &, Functor &&, then_launch );
+
+    //////////
+
+    template <typename T, typename Functor>
+    ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( ThenableFuture<T> &, Functor &&, std::launch = default_policy );
+
+    template <typename T, typename Functor>
+    ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( ThenableFuture<T> &&, Functor &&, std::launch = default_policy );
+
+    template <typename T, typename Functor>
+    ThenableFuture<implicit_result_of<Functor, std::shared_future<T>>> then( ThenableSharedFuture<T>, Functor &&, std::launch = default_policy );
+
+    template <typename T, typename Functor>
+    ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( ThenablePromise<T> &, Functor &&, std::launch = default_policy );
+
+    //////////
+
+    template <typename T, typename Functor>
+    ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( ThenableFuture<T> &, Functor &&, then_launch );
+
+    template <typename T, typename Functor>
+    ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( ThenableFuture<T> &&, Functor &&, then_launch );
+
+    template <typename T, typename Functor>
+    ThenableFuture<implicit_result_of<Functor, std::shared_future<T>>> then( ThenableSharedFuture<T>, Functor &&, then_launch );
+
+    template <typename T, typename Functor>
+    ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( ThenablePromise<T> &, Functor &&, then_launch );
+
+    //////////
+
+    template <typename T, typename Functor, typename Executor>
+    typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::future<T>>>>::type
+    then( ThenableFuture<T> &, Functor &&, Executor & );
+
+    template <typename T, typename Functor, typename Executor>
+    typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::future<T>>>>::type
+    then( ThenableFuture<T> &&, Functor &&, Executor & );
+
+    template <typename T, typename Functor, typename Executor>
+    typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::shared_future<T>>>>::type
+    then( ThenableSharedFuture<T>, Functor &&, Executor & );
+
+    template <typename T, typename Functor, typename Executor>
+    typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::future<T>>>>::type
+    then( ThenablePromise<T> &, Functor &&, Executor & );
+
+    template <typename T, typename Functor, typename Executor>
+    typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::future<T>>>>::type
+    then( std::future<T> &, Functor &&, Executor & );
+
+    template <typename T, typename Functor, typename Executor>
+    typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::future<T>>>>::type
+    then( std::future<T> &&, Functor &&, Executor & );
+
+    template <typename T, typename Functor, typename Executor>
+    typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::shared_future<T>>>>::type
+    then( std::shared_future<T>, Functor &&, Executor & );
+
+    template <typename T, typename Functor, typename Executor>
+    typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::future<T>>>>::type
+    then( std::promise<T> &, Functor &&, Executor & );
+
+
+    /*
+     * then function
+     *
+     * This is the overload of then that resolves futures and promises and invokes a callback with the
+     * resulting value. It uses the standard std::async for asynchronous invocation.
+     * */
+
+    /*
+     * Overload for simple futures
+     * */
+    template <typename T, typename Functor>
+    std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &&s, Functor &&f, std::launch policy ) {
+        return std::async( policy, [policy]( std::future<T> &&s2, Functor &&f2 ) {
+            return detail::then_helper<T, Functor>::dispatch( std::forward<std::future<T>>( s2 ), std::forward<Functor>( f2 ));
+        }, std::forward<std::future<T>>( s ), std::forward<Functor>( f ));
+    };
+
+    /*
+     * Overload for futures by references. It will take ownership and forward the future,
+     * calling the above overload.
+     * */
+    template <typename T, typename Functor>
+    inline std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &s, Functor &&f, std::launch policy ) {
+        return then( std::forward<std::future<T>>( s ), std::forward<Functor>( f ), policy );
+    };
+
+    /*
+     * Overload for shared_futures, passed by value because they can be copied.
+     * It's similar to the first overload, but can capture the shared_future in the lambda.
+     * */
+    template <typename T, typename Functor>
+    inline std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T> &&s, Functor &&f, std::launch policy ) {
+        return std::async( policy, [policy]( std::shared_future<T> &&s2, Functor &&f2 ) {
+            return detail::then_helper<T, Functor>::dispatch( std::forward<std::shared_future<T>>( s2 ), std::forward<Functor>( f2 ));
+        }, std::forward<std::shared_future<T>>( s ), std::forward<Functor>( f ));
+    };
+
+    template <typename T, typename Functor>
+    inline std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T> s, Functor &&f, std::launch policy ) {
+        return then( std::move( s ), std::forward<Functor>( f ), policy );
+    };
+
+    /*
+     * Overload for promise references. The promise is NOT moved, but rather the future is acquired
+     * from it and the promise is left intact, so it can be used elsewhere.
+     * */
+    template <typename T, typename Functor>
+    inline std::future<implicit_result_of<Functor, std::future<T>>> then( std::promise<T> &s, Functor &&f, std::launch policy ) {
+        return then( s.get_future(), std::forward<Functor>( f ), policy );
+    };
+
+    //////////
+
+    /*
+     * then function with detached launch flag.
+     *
+     * These are the same as the normal then functions, but launch the future resolution in a new thread
+     * to immediately wait on them and execute the callbacks. That way the future destructors don't block the main thread.
+     * */
+
+    /*
+     * Overload for simple futures
+     * */
+    template <typename T, typename Functor>
+    std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &&s, Functor &&f, then_launch policy ) {
+        //I don't really like having to do this, but I don't feel like rewriting almost all the recursive template logic above
+        typedef implicit_result_of<Functor, std::future<T>> P;
+
+        std::promise<P> p      = detail::make_std_promise<P>();
+        std::future<P>  result = p.get_future();
+
+        /*
+         * Standard futures can't notify anyone when they resolve, so immediate callbacks only run here if the value is already available.
+         *
+         * Otherwise the promise is moved into the task, so it's kept alive in the other thread without a separate allocation.
+         * */
+        if( policy == then_launch::immediate && s.wait_for( std::chrono::seconds( 0 )) == std::future_status::ready ) {
+            detail::detached_then_helper<P>::dispatch( p, std::forward<std::future<T>>( s ), std::forward<Functor>( f ));
+
+        } else {
+            detail::spawn_detached( [p2 = std::move( p ), s2 = std::move( s ), f2 = std::forward<Functor>( f )]() mutable {
+                detail::detached_then_helper<P>::dispatch( p2, std::move( s2 ), std::forward<Functor>( f2 ));
+            } );
+        }
+
+        return result;
+    };
+
+    /*
+     * Overload for futures by references. It will take ownership and move the future,
+     * calling the above overload.
+     * */
+    template <typename T, typename Functor>
+    inline std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &s, Functor &&f, then_launch policy ) {
+        return then( std::move( s ), std::forward<Functor>( f ), policy );
+    };
+
+    /*
+     * Overload for shared_futures, passed by value because they can be copied.
+     * It's similar to the first overload, but can capture the shared_future in the lambda.
+     * */
+    template <typename T, typename Functor>
+    inline std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T> &&s, Functor &&f, then_launch policy ) {
+        //I don't really like having to do this, but I don't feel like rewriting almost all the recursive template logic above
+        typedef implicit_result_of<Functor, std::shared_future<T>> P;
+
+        std::promise<P> p      = detail::make_std_promise<P>();
+        std::future<P>  result = p.get_future();
+
+        //Same as above, immediate callbacks only run here if the value is already available
+        if( policy == then_launch::immediate && s.wait_for( std::chrono::seconds( 0 )) == std::future_status::ready ) {
+            detail::detached_then_helper<P>::dispatch( p, std::forward<std::shared_future<T>>( s ), std::forward<Functor>( f ));
+
+        } else {
+            detail::spawn_detached( [p2 = std::move( p ), s2 = std::move( s ), f2 = std::forward<Functor>( f )]() mutable {
+                detail::detached_then_helper<P>::dispatch( p2, std::move( s2 ), std::forward<Functor>( f2 ));
+            } );
+        }
+
+        return result;
+    };
+
+    template <typename T, typename Functor>
+    inline std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T> s, Functor &&f, then_launch policy ) {
+        return then( std::move( s ), std::forward<Functor>( f ), policy );
+    };
+
+    /*
+     * Overload for promise references. The promise is NOT moved, but rather the future is acquired
+     * from it and the promise is left intact, so it can be used elsewhere.
+     * */
+    template <typename T, typename Functor>
+    inline std::future<implicit_result_of<Functor, std::future<T>>> then( std::promise<T> &s, Functor &&f, then_launch policy ) {
+        return then( s.get_future(), std::forward<Functor>( f ), policy );
+    };
+
+    //////////
+
+    namespace detail {
+        /*
+         * Tags for whether a callback is allowed to move the value out of a shared state, or only gets a reference to it
+         * because other shared futures may be reading it as well.
+         * */
+        struct take_tag {
+        };
+
+        struct peek_tag {
+        };
+
+        template <typename T>
+        using is_future_type = std::integral_constant<bool, !std::is_same<typename recursive_get_future_type<T>::type, T>::value>;
+
+        /*
+         * Forward declarations
+         * */
+
+        template <typename R, typename X>
+        void resolve_state( const std::shared_ptr<shared_state<R>> &, X && );
+
+        template <typename R, typename U>
+        void resolve_state( const std::shared_ptr<shared_state<R>> &, std::future<U> && );
+
+        template <typename R, typename U>
+        void resolve_state( const std::shared_ptr<shared_state<R>> &, std::shared_future<U> && );
+
+        template <typename R, typename U>
+        void resolve_state( const std::shared_ptr<shared_state<R>> &, const std::shared_future<U> & );
+
+        template <typename R, typename U>
+        void resolve_state( const std::shared_ptr<shared_state<R>> &, std::promise<U> && );
+
+        template <typename R, typename U>
+        void resolve_state( const std::shared_ptr<shared_state<R>> &, ThenableFuture<U> && );
+
+        template <typename R, typename U>
+        void resolve_state( const std::shared_ptr<shared_state<R>> &, ThenableSharedFuture<U> && );
+
+        template <typename R, typename U>
+        void resolve_state( const std::shared_ptr<shared_state<R>> &, const ThenableSharedFuture<U> & );
+
+        template <typename R, typename U>
+        void resolve_state( const std::shared_ptr<shared_state<R>> &, ThenablePromise<U> && );
+
+        /*
+         * fulfill_helper structure
+         *
+         * Runs a task and resolves a shared state with whatever it returns, accounting for void tasks.
+         * */
+
+        template <typename X>
+        struct fulfill_helper {
+            template <typename R, typename Task>
+            static inline void apply( const std::shared_ptr<shared_state<R>> &s, Task &&task ) {
+                resolve_state( s, task());
+            }
+
+            template <typename R, typename Task>
+            static inline void apply( ready_value<R> &v, Task &&task ) {
+                v.set_value( task());
+            }
+        };
+
+        template <>
+        struct fulfill_helper<void> {
+            template <typename Task>
+            static inline void apply( const std::shared_ptr<shared_state<void>> &s, Task &&task ) {
+                task();
+
+                s->set_value();
+            }
+
+            template <typename Task>
+            static inline void apply( ready_value<void> &v, Task &&task ) {
+                task();
+
+                v.set_value();
+            }
+        };
+
+        /*
+         * nothrow_fulfill structure
+         *
+         * True when a task is noexcept and its result can be stored without throwing either, in which case fulfilling a ready_value
+         * doesn't need to catch anything. Tasks that return futures still have to wait on them, so they never count.
+         *
+         * Shared states are always fulfilled inside a try block, because setting one can still throw, such as when it's already satisfied.
+         * */
+
+        template <typename R, typename X>
+        struct nothrow_result : std::integral_constant<bool, !is_future_type<typename std::decay<X>::type>::value &&
+                                                             std::is_nothrow_constructible<R, X>::value> {};
+
+        template <>
+        struct nothrow_result<void, void> : std::true_type {};
+
+        template <typename R, typename Task>
+        struct nothrow_fulfill : std::integral_constant<bool, noexcept( std::declval<Task &>()()) &&
+                                                              nothrow_result<R, decltype( std::declval<Task &>()())>::value> {};
+
+        template <typename R, typename Task>
+        inline void fulfill( ready_value<R> &v, Task &&task, std::false_type ) THENABLE_NOEXCEPT {
+            try {
+                fulfill_helper<decltype( task())>::apply( v, std::forward<Task>( task ));
+
+            } catch( ... ) {
+                v.set_exception( std::current_exception());
+            }
+        }
+
+        template <typename R, typename Task>
+        inline void fulfill( ready_value<R> &v, Task &&task, std::true_type ) THENABLE_NOEXCEPT {
+            fulfill_helper<decltype( task())>::apply( v, std::forward<Task>( task ));
+        }
+
+        template <typename R, typename Task>
+        inline void fulfill( const std::shared_ptr<shared_state<R>> &s, Task &&task ) THENABLE_NOEXCEPT {
+            try {
+                fulfill_helper<decltype( task())>::apply( s, std::forward<Task>( task ));
+
+            } catch( ... ) {
+                s->set_exception( std::current_exception());
+            }
+        }
+
+        template <typename R, typename Task>
+        inline void fulfill( ready_value<R> &v, Task &&task ) THENABLE_NOEXCEPT {
+            fulfill( v, std::forward<Task>( task ), nothrow_fulfill<R, Task>());
+        }
+
+        /*
+         * Resolves one shared state with the result of another once it's ready, without blocking any thread on it.
+         * */
+
+        template <typename R, typename T>
+        inline void forward_state( const std::shared_ptr<shared_state<R>> &s, std::shared_ptr<shared_state<T>> &&from, take_tag ) {
+            check_state( from );
+
+            attach_continuation( from, make_continuation( [s, from]() THENABLE_NOEXCEPT {
+                fulfill( s, [&from]() -> decltype( auto ) {
+                    return from->take();
+                } );
+            } ));
+        }
+
+        template <typename R, typename T>
+        inline void forward_state( const std::shared_ptr<shared_state<R>> &s, std::shared_ptr<shared_state<T>> &&from, peek_tag ) {
+            check_state( from );
+
+            attach_continuation( from, make_continuation( [s, from]() THENABLE_NOEXCEPT {
+                fulfill( s, [&from]() -> decltype( auto ) {
+                    return from->peek();
+                } );
+            } ));
+        }
+
+        /*
+         * resolve_state:
+         *
+         * Resolves a shared state with a value, recursively waiting on any futures or promises that value may be.
+         * Thenable types are chained onto without blocking, but standard futures can only be waited on.
+         * */
+
+        template <typename R, typename X>
+        inline void resolve_state( const std::shared_ptr<shared_state<R>> &s, X &&x ) {
+            s->set_value( std::forward<X>( x ));
+        }
+
+        template <typename R, typename U>
+        inline void resolve_state( const std::shared_ptr<shared_state<R>> &s, std::future<U> &&f ) {
+            fulfill_helper<R>::apply( s, [&f]() -> decltype( auto ) {
+                return recursive_get( std::forward<std::future<U>>( f ));
+            } );
+        }
+
+        template <typename R, typename U>
+        inline void resolve_state( const std::shared_ptr<shared_state<R>> &s, std::shared_future<U> &&f ) {
+            fulfill_helper<R>::apply( s, [&f]() -> decltype( auto ) {
+                return recursive_get( std::forward<std::shared_future<U>>( f ));
+            } );
+        }
+
+        template <typename R, typename U>
+        inline void resolve_state( const std::shared_ptr<shared_state<R>> &s, const std::shared_future<U> &f ) {
+            resolve_state( s, std::shared_future<U>( f ));
+        }
+
+        template <typename R, typename U>
+        inline void resolve_state( const std::shared_ptr<shared_state<R>> &s, std::promise<U> &&p ) {
+            resolve_state( s, p.get_future());
+        }
+
+        template <typename R, typename U>
+        inline void resolve_state( const std::shared_ptr<shared_state<R>> &s, ThenableFuture<U> &&f ) {
+            ready_value<U> &v = state_access::get_ready( f );
+
+            if( v.engaged()) {
+                fulfill_helper<U>::apply( s, [&v]() -> decltype( auto ) {
+                    return v.take();
+                } );
+
+            } else {
+                forward_state( s, std::move( state_access::get( f )), take_tag());
+            }
+        }
+
+        template <typename R, typename U>
+        inline void resolve_state( const std::shared_ptr<shared_state<R>> &s, ThenableSharedFuture<U> &&f ) {
+            forward_state( s, std::move( state_access::get( f )), peek_tag());
+        }
+
+        template <typename R, typename U>
+        inline void resolve_state( const std::shared_ptr<shared_state<R>> &s, const ThenableSharedFuture<U> &f ) {
+            forward_state( s, std::shared_ptr<shared_state<U>>( state_access::get( f )), peek_tag());
+        }
+
+        template <typename R, typename U>
+        inline void resolve_state( const std::shared_ptr<shared_state<R>> &s, ThenablePromise<U> &&p ) {
+            resolve_state( s, p.get_future());
+        }
+
+        /*
+         * If a shared state holds futures, this chains it onto a new state that will hold the final non-future value.
+         * */
+
+        template <typename T, typename Tag>
+        inline std::shared_ptr<shared_state<T>> flatten_state( std::shared_ptr<shared_state<T>> &&s, Tag, std::false_type ) {
+            return std::move( s );
+        }
+
+        template <typename T, typename Tag>
+        inline std::shared_ptr<shared_state<typename recursive_get_future_type<T>::type>> flatten_state( std::shared_ptr<shared_state<T>> &&s, Tag tag, std::true_type ) {
+            auto flat = make_state<shared_state<typename recursive_get_future_type<T>::type>>();
+
+            forward_state( flat, std::move( s ), tag );
+
+            return flat;
+        }
+
+        //////////
+
+        /*
+         * state_then_helper structure
+         *
+         * The equivalent of then_helper for shared states. The state is already resolved when this is called, so it just
+         * passes the value to the callback. Ready values held inline by a future go through here as well.
+         * */
+
+        template <typename T, typename Functor>
+        struct state_then_helper {
+            template <typename State>
+            inline static decltype( auto ) dispatch( State &s, Functor &f, take_tag ) {
+                return invoke_callback( f, s.take());
+            }
+
+            template <typename State>
+            inline static decltype( auto ) dispatch( State &s, Functor &f, peek_tag ) {
+                return invoke_callback( f, s.peek());
+            }
+        };
+
+        template <typename Functor>
+        struct state_then_helper<void, Functor> {
+            template <typename State, typename Tag>
+            inline static decltype( auto ) dispatch( State &s, Functor &f, Tag ) {
+                s.take();
+
+                return invoke_callback( f );
+            }
+        };
+
+        /*
+         * nothrow_callback structure
+         *
+         * Whether giving a resolved value to a callback, the same way state_then_helper does, can throw
+         * */
+
+        template <typename K, typename Functor, typename Tag>
+        struct nothrow_callback : std::integral_constant<bool, noexcept( invoke_callback( std::declval<Functor &>(), std::declval<K>())) &&
+                                                               std::is_nothrow_move_constructible<K>::value> {};
+
+        template <typename K, typename Functor>
+        struct nothrow_callback<K, Functor, peek_tag> : std::integral_constant<bool, noexcept( invoke_callback( std::declval<Functor &>(),
+                                                                                                                std::declval<const K &>()))> {};
+
+        template <typename Functor, typename Tag>
+        struct nothrow_callback<void, Functor, Tag> : std::integral_constant<bool, noexcept( invoke_callback( std::declval<Functor &>()))> {};
+
+        /*
+         * Exceptions from upstream are passed along directly instead of being rethrown by take and caught again,
+         * which also leaves nothing that can throw in the task of a noexcept callback.
+         * */
+        template <typename K, typename R, typename Functor, typename Tag>
+        inline void run_then( shared_state<K> &up, const std::shared_ptr<shared_state<R>> &down, Functor &f, Tag ) THENABLE_NOEXCEPT {
+            if( std::exception_ptr e = up.exception()) {
+                down->set_exception( e );
+
+                return;
+            }
+
+            fulfill( down, [&]() noexcept( nothrow_callback<K, Functor, Tag>::value ) -> decltype( auto ) {
+                return state_then_helper<K, Functor>::dispatch( up, f, Tag());
+            } );
+        }
+
+        /*
+         * Launch policies for continuations of shared states.
+         *
+         * A deferred policy stores the continuation as the deferred task of the resulting state, to be run by whoever waits on it.
+         * Executors are given the continuation once the value is ready, and anything else runs it on a new thread.
+         * */
+
+        constexpr bool is_lazy( std::launch policy ) THENABLE_NOEXCEPT {
+            return policy == std::launch::deferred;
+        }
+
+        constexpr bool is_lazy( then_launch ) THENABLE_NOEXCEPT {
+            return false;
+        }
+
+        template <typename Task>
+        inline void launch( std::launch, Task &&task ) {
+            spawn_detached( std::forward<Task>( task ));
+        }
+
+        template <typename Executor>
+        constexpr bool is_lazy( executor_ref<Executor> ) THENABLE_NOEXCEPT {
+            return false;
+        }
+
+        /*
+         * Whether every task launched with the policy gets its own thread, in which case that thread may as well block on a deferred state.
+         * */
+        constexpr bool is_dedicated( std::launch ) THENABLE_NOEXCEPT {
+            return true;
+        }
+
+        constexpr bool is_dedicated( then_launch policy ) THENABLE_NOEXCEPT {
+            return policy == then_launch::detached;
+        }
+
+        template <typename Executor>
+        constexpr bool is_dedicated( executor_ref<Executor> ) THENABLE_NOEXCEPT {
+            return false;
+        }
+
+        /*
+         * immediate_context structure
+         *
+         * Per-thread bookkeeping for then_launch::immediate, tracking how deeply nested the current callback is
+         * and holding any callbacks that were queued because the limit was reached.
+         * */
+        struct immediate_context {
+            size_t           depth;
+            continuation_ptr head;
+            continuation     *tail;
+
+            static inline immediate_context &current() THENABLE_NOEXCEPT {
+                static thread_local immediate_context context{ 0, nullptr, nullptr };
+
+                return context;
+            }
+
+            inline void push( continuation_ptr &&c ) THENABLE_NOEXCEPT {
+                continuation *raw = c.get();
+
+                if( tail ) {
+                    tail->next = std::move( c );
+
+                } else {
+                    head = std::move( c );
+                }
+
+                tail = raw;
+            }
+
+            inline continuation_ptr pop() THENABLE_NOEXCEPT {
+                continuation_ptr c = std::move( head );
+
+                if( c ) {
+                    head = std::move( c->next );
+
+                    if( !head ) {
+                        tail = nullptr;
+                    }
+                }
+
+                return c;
+            }
+        };
+
+        template <typename Task>
+        inline void run_immediate( Task &&task ) {
+            immediate_context &context = immediate_context::current();
+
+            if( context.depth >= immediate_depth_limit ) {
+                context.push( make_continuation( std::forward<Task>( task )));
+
+            } else {
+                ++context.depth;
+
+                task();
+
+                //Only the outermost callback drains the queue, so it never grows the stack past the limit
+                if( context.depth == 1 ) {
+                    while( auto c = context.pop()) {
+                        c->run();
+                    }
+                }
+
+                --context.depth;
+            }
+        }
+
+        template <typename Task>
+        inline void launch( then_launch policy, Task &&task ) {
+            if( policy == then_launch::immediate ) {
+                run_immediate( std::forward<Task>( task ));
+
+            } else {
+                spawn_detached( std::forward<Task>( task ));
+            }
+        }
+
+        template <typename Executor, typename Task>
+        inline void launch( executor_ref<Executor> policy, Task &&task ) {
+            policy.executor->submit( std::forward<Task>( task ));
+        }
+
+        /*
+         * release_queue class
+         *
+         * Each then_node keeps its upstream state alive, so dropping the last reference to the end of a long chain that never ran
+         * would destroy every node from inside the destructor of the next. Like immediate callbacks, releases only nest so deep
+         * on one thread before the rest are queued, and the outermost release works through them one at a time.
+         * */
+        class release_queue {
+                std::vector<std::shared_ptr<shared_state_base>> pending;
+                size_t                                          depth = 0;
+
+                static inline bool &destroyed() THENABLE_NOEXCEPT {
+                    static thread_local bool flag = false;
+
+                    return flag;
+                }
+
+                friend struct thread_state;
+
+            public:
+                inline ~release_queue() {
+                    destroyed() = true;
+                }
+
+                //Null once the thread's queue has been destroyed at thread exit
+                static inline release_queue *current() THENABLE_NOEXCEPT {
+                    if( destroyed()) {
+                        return nullptr;
+                    }
+
+                    static thread_local release_queue queue;
+
+                    return &queue;
+                }
+
+                static inline void release( std::shared_ptr<shared_state_base> &&s ) THENABLE_NOEXCEPT {
+                    release_queue *current_queue = current();
+
+                    if( !current_queue ) {
+                        s.reset();
+
+                        return;
+                    }
+
+                    release_queue &queue = *current_queue;
+
+                    if( queue.depth >= immediate_depth_limit ) {
+                        try {
+                            queue.pending.push_back( std::move( s ));
+
+                            return;
+
+                        } catch( ... ) {}
+                    }
+
+                    ++queue.depth;
+
+                    s.reset();
+
+                    //Only the outermost release drains the queue, so it never grows the stack past the limit
+                    if( queue.depth == 1 ) {
+                        while( !queue.pending.empty()) {
+                            auto next = std::move( queue.pending.back());
+
+                            queue.pending.pop_back();
+
+                            next.reset();
+                        }
+                    }
+
+                    --queue.depth;
+                }
+        };
+
+        /*
+         * thread_state structure
+         *
+         * The trampolines above, and the current memory resource, are kept per thread while callbacks run on it. Anything that
+         * switches between stacks on one thread has to give each stack its own copy, or a stack suspended in the middle of a callback
+         * would leave the others running as if they were nested inside it. swap() exchanges this copy with the thread's current one.
+         * */
+        struct thread_state {
+            immediate_context                               immediate{ 0, nullptr, nullptr };
+            size_t                                          release_depth = 0;
+            std::vector<std::shared_ptr<shared_state_base>> release_pending;
+#ifdef THENABLE_HAS_CXX17
+            std::pmr::memory_resource                       *resource = nullptr;
+#endif
+
+            inline void swap() THENABLE_NOEXCEPT {
+                immediate_context &context = immediate_context::current();
+
+                std::swap( immediate.depth, context.depth );
+                std::swap( immediate.head, context.head );
+                std::swap( immediate.tail, context.tail );
+
+                if( release_queue *queue = release_queue::current()) {
+                    std::swap( release_depth, queue->depth );
+
+                    release_pending.swap( queue->pending );
+                }
+
+#ifdef THENABLE_HAS_CXX17
+                std::swap( resource, current_resource());
+#endif
+            }
+        };
+
+        /*
+         * then_node class
+         *
+         * The shared state returned by then_state, which also holds the callback and the continuations used to run it,
+         * so each call to then only costs a single allocation.
+         *
+         * While a hook is queued somewhere it holds a reference to the node, which it drops when it's destroyed. The deferred hook
+         * is owned by the node itself instead, so it holds nothing and is let go of before the rest of the node is destroyed.
+         * The callback and upstream state are released as soon as the callback has run.
+         * */
+        template <typename R, typename K, typename Functor, typename LaunchPolicy, typename Tag>
+        class then_node final : public shared_state<R>, public std::enable_shared_from_this<then_node<R, K, Functor, LaunchPolicy, Tag>> {
+                struct ready_hook final : continuation {
+                    std::shared_ptr<then_node> node;
+
+                    void run() THENABLE_NOEXCEPT override {
+                        try {
+                            node->start( node );
+
+                        } catch( ... ) {
+                            node->set_exception( std::current_exception());
+                        }
+                    }
+
+                    void destroy() THENABLE_NOEXCEPT override {
+                        release_queue::release( std::move( node ));
+                    }
+                };
+
+                struct launch_hook final : continuation {
+                    std::shared_ptr<then_node> node;
+
+                    void run() THENABLE_NOEXCEPT override {
+                        node->execute( node );
+                    }
+
+                    void destroy() THENABLE_NOEXCEPT override {
+                        release_queue::release( std::move( node ));
+                    }
+                };
+
+                struct deferred_hook final : continuation {
+                    then_node *node;
+
+                    void run() THENABLE_NOEXCEPT override {
+                        node->execute( node->shared_from_this());
+                    }
+
+                    void destroy() THENABLE_NOEXCEPT override {}
+
+                    shared_state_base *dependency() const THENABLE_NOEXCEPT override {
+                        return node->up.get();
+                    }
+                };
+
+                std::shared_ptr<shared_state<K>>                                    up;
+                typename std::aligned_storage<sizeof( Functor ), alignof( Functor )>::type storage;
+                bool                                                                has_functor;
+                LaunchPolicy                                                        policy;
+
+                ready_hook    attached;
+                launch_hook   launched;
+                deferred_hook deferred_task;
+
+                inline Functor &functor() THENABLE_NOEXCEPT {
+                    return *reinterpret_cast<Functor *>( &storage );
+                }
+
+            public:
+                template <typename F>
+                inline then_node( std::shared_ptr<shared_state<K>> &&u, F &&f, LaunchPolicy p ) : up( std::move( u )), has_functor( false ), policy( p ) {
+                    new( &storage ) Functor( std::forward<F>( f ));
+
+                    has_functor = true;
+                }
+
+                inline ~then_node() {
+                    this->deferred.release();
+
+                    if( has_functor ) {
+                        functor().~Functor();
+                    }
+
+                    release_queue::release( std::move( up ));
+                }
+
+                inline bool upstream_deferred() const {
+                    return up->is_deferred();
+                }
+
+                inline void execute( const std::shared_ptr<then_node> &self ) THENABLE_NOEXCEPT {
+                    up->wait();
+
+                    run_then( *up, std::shared_ptr<shared_state<R>>( self ), functor(), Tag());
+
+                    up.reset();
+
+                    functor().~Functor();
+
+                    has_functor = false;
+                }
+
+                inline void start( const std::shared_ptr<then_node> &self ) {
+                    if( is_dedicated( policy )) {
+                        launched.node = self;
+
+                        thread_cache::instance().submit( continuation_ptr( &launched ));
+
+                    } else {
+                        launch( policy, [self]() THENABLE_NOEXCEPT {
+                            self->execute( self );
+                        } );
+                    }
+                }
+
+                inline void attach( const std::shared_ptr<then_node> &self ) {
+                    attached.node = self;
+
+                    attach_continuation( up, continuation_ptr( &attached ));
+                }
+
+                inline void defer() {
+                    deferred_task.node = this;
+
+                    this->set_deferred( continuation_ptr( &deferred_task ));
+                }
+        };
+
+        /*
+         * then_state function
+         *
+         * This is the implementation of then for the Thenable types. Instead of waiting on the future on another thread,
+         * the callback is attached to the shared state and launched by whichever thread resolves it.
+         * */
+        template <typename R, typename T, typename Tag, typename Functor, typename LaunchPolicy>
+        ThenableFuture<R> then_state( std::shared_ptr<shared_state<T>> &&s, Functor &&f, LaunchPolicy policy, Tag tag ) {
+            typedef typename recursive_get_future_type<T>::type                            K;
+            typedef then_node<R, K, typename std::decay<Functor>::type, LaunchPolicy, Tag> node_type;
+
+            check_state( s );
+
+            auto node = make_state<node_type>( flatten_state( std::move( s ), tag, is_future_type<T>()), std::forward<Functor>( f ), policy );
+
+            if( is_lazy( policy )) {
+                node->defer();
+
+            } else if( is_dedicated( policy ) && node->upstream_deferred()) {
+                /*
+                 * If the upstream state is deferred, then the launched task is what resolves it, just like the std::async version.
+                 *
+                 * Executors are left to attach_continuation instead, so their threads never block on it.
+                 * */
+                node->start( node );
+
+            } else {
+                node->attach( node );
+            }
+
+            return state_access::make_future( std::shared_ptr<shared_state<R>>( std::move( node )));
+        }
+
+        /*
+         * launch_state function
+         *
+         * Runs a nullary functor with the given launch policy and resolves a new shared state with whatever it returns.
+         * */
+        template <typename R, typename Functor, typename LaunchPolicy>
+        ThenableFuture<R> launch_state( LaunchPolicy policy, Functor &&f ) {
+            typedef typename std::decay<Functor>::type functor_type;
+
+            auto s = make_state<shared_state<R>>();
+
+            if( is_lazy( policy )) {
+                std::weak_ptr<shared_state<R>> weak = s;
+
+                s->set_deferred( make_continuation( [weak, f2 = functor_type( std::forward<Functor>( f ))]() mutable THENABLE_NOEXCEPT {
+                    if( auto s2 = weak.lock()) {
+                        fulfill( s2, [&f2]() noexcept( noexcept( f2())) -> decltype( auto ) {
+                            return f2();
+                        } );
+                    }
+                } ));
+
+            } else {
+                launch( policy, [s, f2 = functor_type( std::forward<Functor>( f ))]() mutable THENABLE_NOEXCEPT {
+                    fulfill( s, [&f2]() noexcept( noexcept( f2())) -> decltype( auto ) {
+                        return f2();
+                    } );
+                } );
+            }
+
+            return state_access::make_future( std::move( s ));
+        }
+
+        /*
+         * then_ready function
+         *
+         * then for a ThenableFuture that was ready from the start, so there is no shared state to attach the callback to.
+         *
+         * Only then_launch::immediate runs the callback right here, and a plain result is held inline by the new future as well.
+         * A deferred callback keeps the value until it's waited on.
+         *
+         * Everything else, including the default policy, still launches the callback where it would for a pending future, so it never
+         * ends up running on the calling thread unless that was asked for. That goes through then_state, since executors may need
+         * to copy the task.
+         * */
+
+        constexpr bool runs_ready_inline( std::launch ) THENABLE_NOEXCEPT {
+            return false;
+        }
+
+        constexpr bool runs_ready_inline( then_launch policy ) THENABLE_NOEXCEPT {
+            return policy == then_launch::immediate;
+        }
+
+        template <typename Executor>
+        constexpr bool runs_ready_inline( executor_ref<Executor> ) THENABLE_NOEXCEPT {
+            return false;
+        }
+
+        template <typename R, typename Task>
+        inline ThenableFuture<R> ready_result( Task &task, std::false_type ) {
+            ready_value<R> r;
+
+            fulfill( r, task );
+
+            return state_access::make_future( std::move( r ));
+        }
+
+        /*
+         * Callbacks that return futures still need a shared state to wait on them
+         * */
+        template <typename R, typename Task>
+        inline ThenableFuture<R> ready_result( Task &task, std::true_type ) {
+            auto s = make_state<shared_state<R>>();
+
+            fulfill( s, task );
+
+            return state_access::make_future( std::move( s ));
+        }
+
+        template <typename T, typename R, typename Functor>
+        inline void run_ready( ready_value<T> &up, const std::shared_ptr<shared_state<R>> &down, Functor &f ) THENABLE_NOEXCEPT {
+            if( up.error ) {
+                down->set_exception( up.error );
+
+                return;
+            }
+
+            fulfill( down, [&]() noexcept( nothrow_callback<T, Functor, take_tag>::value ) -> decltype( auto ) {
+                return state_then_helper<T, Functor>::dispatch( up, f, take_tag());
+            } );
+        }
+
+        template <typename R, typename T, typename Functor, typename LaunchPolicy>
+        ThenableFuture<R> then_ready( ready_value<T> up, Functor &&f, LaunchPolicy policy ) {
+            typedef typename std::decay<Functor>::type functor_type;
+
+            if( runs_ready_inline( policy )) {
+                typedef typename std::remove_reference<Functor>::type callback_type;
+
+                if( up.error ) {
+                    ready_value<R> r;
+
+                    r.set_exception( up.error );
+
+                    return state_access::make_future( std::move( r ));
+                }
+
+                auto task = [&]() noexcept( nothrow_callback<T, callback_type, take_tag>::value ) -> decltype( auto ) {
+                    return state_then_helper<T, callback_type>::dispatch( up, f, take_tag());
+                };
+
+                return ready_result<R>( task, is_future_type<typename std::decay<decltype( task())>::type>());
+            }
+
+            auto down = make_state<shared_state<R>>();
+
+            std::weak_ptr<shared_state<R>> weak = down;
+
+            down->set_deferred( make_continuation( [weak, up2 = std::move( up ), f2 = functor_type( std::forward<Functor>( f ))]() mutable THENABLE_NOEXCEPT {
+                if( auto down2 = weak.lock()) {
+                    run_ready( up2, down2, f2 );
+                }
+            } ));
+
+            return state_access::make_future( std::move( down ));
+        }
+
+        /*
+         * Futures of futures always go through a shared state, since their values have to be flattened first
+         * */
+        template <typename R, typename T, typename Functor, typename LaunchPolicy>
+        inline ThenableFuture<R> then_future( ThenableFuture<T> &&s, Functor &&f, LaunchPolicy policy, std::false_type ) {
+            ready_value<T> &v = state_access::get_ready( s );
+
+            if( v.engaged() && ( runs_ready_inline( policy ) || is_lazy( policy ))) {
+                return then_ready<R>( std::move( v ), std::forward<Functor>( f ), policy );
+            }
+
+            return then_state<R>( std::move( state_access::get( s )), std::forward<Functor>( f ), policy, take_tag());
+        }
+
+        template <typename R, typename T, typename Functor, typename LaunchPolicy>
+        inline ThenableFuture<R> then_future( ThenableFuture<T> &&s, Functor &&f, LaunchPolicy policy, std::true_type ) {
+            return then_state<R>( std::move( state_access::get( s )), std::forward<Functor>( f ), policy, take_tag());
+        }
+
+        template <typename R, typename T, typename Functor, typename LaunchPolicy>
+        inline ThenableFuture<R> then_future( ThenableFuture<T> &&s, Functor &&f, LaunchPolicy policy ) {
+            return then_future<R>( std::move( s ), std::forward<Functor>( f ), policy, is_future_type<T>());
+        }
+    }
+
+    /*
+     * then function for Thenable types
+     *
+     * These attach the callback to the shared state of the future, so no thread is left waiting on it while it's pending.
+     * */
+
+    template <typename T, typename Functor>
+    inline ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( ThenableFuture<T> &&s, Functor &&f, std::launch policy ) {
+        return detail::then_future<implicit_result_of<Functor, std::future<T>>>( std::move( s ), std::forward<Functor>( f ), policy );
+    };
+
+    template <typename T, typename Functor>
+    inline ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( ThenableFuture<T> &s, Functor &&f, std::launch policy ) {
+        return then( std::move( s ), std::forward<Functor>( f ), policy );
+    };
+
+    template <typename T, typename Functor>
+    inline ThenableFuture<implicit_result_of<Functor, std::shared_future<T>>> then( ThenableSharedFuture<T> s, Functor &&f, std::launch policy ) {
+        return detail::then_state<implicit_result_of<Functor, std::shared_future<T>>>( std::move( detail::state_access::get( s )), std::forward<Functor>( f ), policy,
+                                                                                       detail::peek_tag());
+    };
+
+    template <typename T, typename Functor>
+    inline ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( ThenablePromise<T> &s, Functor &&f, std::launch policy ) {
+        return then( s.get_future(), std::forward<Functor>( f ), policy );
+    };
+
+    //////////
+
+    template <typename T, typename Functor>
+    inline ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( ThenableFuture<T> &&s, Functor &&f, then_launch policy ) {
+        return detail::then_future<implicit_result_of<Functor, std::future<T>>>( std::move( s ), std::forward<Functor>( f ), policy );
+    };
+
+    template <typename T, typename Functor>
+    inline ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( ThenableFuture<T> &s, Functor &&f, then_launch policy ) {
+        return then( std::move( s ), std::forward<Functor>( f ), policy );
+    };
+
+    template <typename T, typename Functor>
+    inline ThenableFuture<implicit_result_of<Functor, std::shared_future<T>>> then( ThenableSharedFuture<T> s, Functor &&f, then_launch policy ) {
+        return detail::then_state<implicit_result_of<Functor, std::shared_future<T>>>( std::move( detail::state_access::get( s )), std::forward<Functor>( f ), policy,
+                                                                                       detail::peek_tag());
+    };
+
+    template <typename T, typename Functor>
+    inline ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( ThenablePromise<T> &s, Functor &&f, then_launch policy ) {
+        return then( s.get_future(), std::forward<Functor>( f ), policy );
+    };
+
+    //////////
+
+    /*
+     * then function with an executor
+     *
+     * Once the future is resolved, the callback is submitted to the executor. Standard futures are converted to
+     * ThenableFutures first, since there is no std::async for executors, so these always return a ThenableFuture.
+     *
+     * A standard future still needs a thread to wait on it, but that is never one of the executor's threads.
+     * */
+
+    template <typename T, typename Functor, typename Executor>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::future<T>>>>::type
+    then( ThenableFuture<T> &&s, Functor &&f, Executor &executor ) {
+        return detail::then_future<implicit_result_of<Functor, std::future<T>>>( std::move( s ), std::forward<Functor>( f ),
+                                                                                 detail::executor_ref<Executor>( executor ));
+    };
+
+    template <typename T, typename Functor, typename Executor>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::future<T>>>>::type
+    then( ThenableFuture<T> &s, Functor &&f, Executor &executor ) {
+        return then( std::move( s ), std::forward<Functor>( f ), executor );
+    };
+
+    template <typename T, typename Functor, typename Executor>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::shared_future<T>>>>::type
+    then( ThenableSharedFuture<T> s, Functor &&f, Executor &executor ) {
+        return detail::then_state<implicit_result_of<Functor, std::shared_future<T>>>( std::move( detail::state_access::get( s )), std::forward<Functor>( f ),
+                                                                                       detail::executor_ref<Executor>( executor ), detail::peek_tag());
+    };
+
+    template <typename T, typename Functor, typename Executor>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::future<T>>>>::type
+    then( ThenablePromise<T> &s, Functor &&f, Executor &executor ) {
+        return then( s.get_future(), std::forward<Functor>( f ), executor );
+    };
+
+    template <typename T, typename Functor, typename Executor>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::future<T>>>>::type
+    then( std::future<T> &&s, Functor &&f, Executor &executor ) {
+        return then( to_thenable( std::forward<std::future<T>>( s )), std::forward<Functor>( f ), executor );
+    };
+
+    template <typename T, typename Functor, typename Executor>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::future<T>>>>::type
+    then( std::future<T> &s, Functor &&f, Executor &executor ) {
+        return then( std::move( s ), std::forward<Functor>( f ), executor );
+    };
+
+    template <typename T, typename Functor, typename Executor>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::shared_future<T>>>>::type
+    then( std::shared_future<T> s, Functor &&f, Executor &executor ) {
+        return then( to_thenable( std::move( s )), std::forward<Functor>( f ), executor );
+    };
+
+    template <typename T, typename Functor, typename Executor>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<implicit_result_of<Functor, std::future<T>>>>::type
+    then( std::promise<T> &s, Functor &&f, Executor &executor ) {
+        return then( s.get_future(), std::forward<Functor>( f ), executor );
+    };
+
+    //////////
+
+    /*
+     * then2 is a variation of then that returns a ThenableFuture instead of a normal future
+     *
+     * The launch policy is forwarded so executors are passed along by reference.
+     * */
+    template <typename FutureType, typename Functor, typename LaunchPolicy>
+    inline ThenableFuture<implicit_result_of<Functor, FutureType>> then2( FutureType &&s, Functor &&f, LaunchPolicy &&policy ) {
+        return to_thenable( then( std::forward<FutureType>( s ), std::forward<Functor>( f ), std::forward<LaunchPolicy>( policy )));
+    }
+
+    template <typename FutureType, typename Functor, typename LaunchPolicy>
+    inline ThenableFuture<implicit_result_of<Functor, FutureType>> then2( FutureType &s, Functor &&f, LaunchPolicy &&policy ) {
+        return to_thenable( then( s, std::forward<Functor>( f ), std::forward<LaunchPolicy>( policy )));
+    }
+
+    //////////
+
+    /*
+     * This is a promise object functionally equivalent to std::promise, but backed by a thenable shared state,
+     * so callbacks attached to its futures are run as soon as it's resolved instead of having a thread wait on it.
+     * */
+
+    template <typename T>
+    class ThenablePromise {
+            friend struct detail::state_access;
+
+            std::shared_ptr<detail::shared_state<T>> state;
+            bool                                     retrieved = false;
+
+        public:
+            inline ThenablePromise() : state( detail::make_state<detail::shared_state<T>>()) {}
+
+            /*
+             * Like std::promise, the shared state can be allocated with a custom allocator instead
+             * */
+            template <typename Alloc>
+            inline ThenablePromise( std::allocator_arg_t, const Alloc &alloc ) : state( std::allocate_shared<detail::shared_state<T>>( alloc )) {}
+
+            inline ThenablePromise( ThenablePromise &&p ) THENABLE_NOEXCEPT : state( std::move( p.state )), retrieved( p.retrieved ) {}
+
+            /*
+             * Takes over a std::promise. If nothing has retrieved its future yet, this simply replaces it. Otherwise the result is passed on
+             * to the std::promise once this is resolved, and just like with the std::promise, get_future throws future_already_retrieved.
+             * */
+            inline ThenablePromise( std::promise<T> &&p ) : ThenablePromise() {
+                std::promise<T> adopted( std::move( p ));
+
+                try {
+                    adopted.get_future();
+
+                } catch( const std::future_error &e ) {
+                    if( e.code() == std::future_errc::no_state ) {
+                        state.reset();
+
+                        return;
+                    }
+
+                    retrieved = true;
+
+                    detail::shared_state<T> *s = state.get();
+
+                    detail::attach_continuation( state, detail::make_continuation( [s, p2 = std::move( adopted )]() mutable THENABLE_NOEXCEPT {
+                        detail::promise_adapter<T>::store( p2, [s]() -> T {
+                            return s->take();
+                        } );
+                    } ));
+                }
+            }
+
+            ThenablePromise( const ThenablePromise & ) = delete;
+
+            ThenablePromise &operator=( const ThenablePromise & ) = delete;
+
+            inline ThenablePromise &operator=( ThenablePromise &&p ) THENABLE_NOEXCEPT {
+                ThenablePromise( std::move( p )).swap( *this );
+
+                return *this;
+            }
+
+            /*
+             * Just like std::promise, if it's destroyed without being resolved any futures waiting on it will get a broken_promise error
+             * */
+            inline ~ThenablePromise() {
+                if( state && !state->is_ready()) {
+                    state->set_exception( std::make_exception_ptr( std::future_error( std::future_errc::broken_promise )));
+                }
+            }
+
+            inline void swap( ThenablePromise &other ) THENABLE_NOEXCEPT {
+                std::swap( state, other.state );
+                std::swap( retrieved, other.retrieved );
+            }
+
+            inline ThenableFuture<T> get_future() {
+                detail::check_state( state );
+
+                if( retrieved ) {
+                    throw std::future_error( std::future_errc::future_already_retrieved );
+                }
+
+                retrieved = true;
+
+                return detail::state_access::make_future( std::shared_ptr<detail::shared_state<T>>( state ));
+            }
+
+            inline ThenableFuture<T> get_thenable_future() {
+                return this->get_future();
+            }
+
+            template <typename... Args>
+            inline void set_value( Args &&... args ) {
+                detail::check_state( state );
+
+                state->set_value( std::forward<Args>( args )... );
+            }
+
+            inline void set_exception( std::exception_ptr e ) {
+                detail::check_state( state );
+
+                state->set_exception( e );
+            }
+
+            template <typename Functor, typename LaunchPolicy = std::launch>
+            inline ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( Functor &&f, LaunchPolicy &&policy = std::launch( default_policy )) {
+                return then2( this->get_future(), std::forward<Functor>( f ), std::forward<LaunchPolicy>( policy ));
+            }
+    };
+
+    /*
+     * This is a future object functionally equivalent to std::future,
+     * but with a .then function to chain together many futures.
+     *
+     * It can be constructed from a std::future, but since those can only be waited on,
+     * callbacks attached to it will need a thread to wait on it like before.
+     * */
+
+    template <typename T>
+    class ThenableFuture {
+            friend struct detail::state_access;
+
+            std::shared_ptr<detail::shared_state<T>> state;
+            detail::ready_value<T>                   ready;
+
+            inline explicit ThenableFuture( std::shared_ptr<detail::shared_state<T>> &&s ) THENABLE_NOEXCEPT : state( std::move( s )) {}
+
+            inline explicit ThenableFuture( detail::ready_value<T> &&v ) THENABLE_NOEXCEPT : ready( std::move( v )) {}
+
+        public:
+            ThenableFuture() THENABLE_NOEXCEPT = default;
+
+            inline ThenableFuture( std::future<T> &&f ) : state( detail::adapt_future<T>( std::forward<std::future<T>>( f ))) {}
+
+            inline ThenableFuture( ThenableFuture &&f ) THENABLE_NOEXCEPT : state( std::move( f.state )), ready( std::move( f.ready )) {}
+
+            ThenableFuture( const ThenableFuture & ) = delete;
+
+            ThenableFuture &operator=( const ThenableFuture & ) = delete;
+
+            inline ThenableFuture &operator=( ThenableFuture &&f ) THENABLE_NOEXCEPT {
+                state = std::move( f.state );
+                ready = std::move( f.ready );
+
+                return *this;
+            }
+
+            inline bool valid() const THENABLE_NOEXCEPT {
+                return state != nullptr || ready.engaged();
+            }
+
+            inline bool is_ready() const {
+                if( ready.engaged()) {
+                    return true;
+                }
+
+                detail::check_state( state );
+
+                return state->is_ready();
+            }
+
+            /*
+             * Like std::future::get, this releases the shared state, so the future is no longer valid afterwards.
+             * */
+            inline decltype( auto ) get() {
+                if( ready.engaged()) {
+                    detail::ready_value<T> v( std::move( ready ));
+
+                    return v.take();
+                }
+
+                auto s = std::move( state );
+
+                detail::check_state( s );
+
+                s->wait();
+
+                return s->take();
+            }
+
+            inline void wait() const {
+                if( ready.engaged()) {
+                    return;
+                }
+
+                detail::check_state( state );
+
+                state->wait();
+            }
+
+            template <typename Rep, typename Period>
+            inline std::future_status wait_for( const std::chrono::duration<Rep, Period> &timeout_duration ) const {
+                if( ready.engaged()) {
+                    return std::future_status::ready;
+                }
+
+                detail::check_state( state );
+
+                return state->wait_for( timeout_duration );
+            }
+
+            template <typename Clock, typename Duration>
+            inline std::future_status wait_until( const std::chrono::time_point<Clock, Duration> &timeout_time ) const {
+                if( ready.engaged()) {
+                    return std::future_status::ready;
+                }
+
+                detail::check_state( state );
+
+                return state->wait_until( timeout_time );
+            }
+
+            template <typename Functor, typename LaunchPolicy = std::launch>
+            inline ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( Functor &&f, LaunchPolicy &&policy = std::launch( default_policy )) {
+                return then2( std::move( *this ), std::forward<Functor>( f ), std::forward<LaunchPolicy>( policy ));
+            }
+
+            inline ThenableSharedFuture<T> share() {
+                return ThenableSharedFuture<T>( std::move( *this ));
+            }
+
+            inline ThenableSharedFuture<T> share_thenable() {
+                return this->share();
+            }
+    };
+
+    template <typename T>
+    class ThenableSharedFuture {
+            friend struct detail::state_access;
+
+            std::shared_ptr<detail::shared_state<T>> state;
+
+        public:
+            ThenableSharedFuture() THENABLE_NOEXCEPT = default;
+
+            inline ThenableSharedFuture( const ThenableSharedFuture &f ) THENABLE_NOEXCEPT : state( f.state ) {}
+
+            inline ThenableSharedFuture( ThenableSharedFuture &&f ) THENABLE_NOEXCEPT : state( std::move( f.state )) {}
+
+            inline ThenableSharedFuture( ThenableFuture<T> &&f ) : state( std::move( detail::state_access::get( f ))) {}
+
+            inline ThenableSharedFuture( std::future<T> &&f ) : state( detail::adapt_future<T>( std::forward<std::future<T>>( f ))) {}
+
+            inline ThenableSharedFuture( const std::shared_future<T> &f ) : state( detail::adapt_future<T>( f )) {}
+
+            inline ThenableSharedFuture( std::shared_future<T> &&f ) : state( detail::adapt_future<T>( std::forward<std::shared_future<T>>( f ))) {}
+
+            inline ThenableSharedFuture &operator=( const ThenableSharedFuture &f ) THENABLE_NOEXCEPT {
+                state = f.state;
+
+                return *this;
+            }
+
+            inline ThenableSharedFuture &operator=( ThenableSharedFuture &&f ) THENABLE_NOEXCEPT {
+                state = std::move( f.state );
+
+                return *this;
+            }
+
+            inline bool valid() const THENABLE_NOEXCEPT {
+                return state != nullptr;
+            }
+
+            inline bool is_ready() const {
+                detail::check_state( state );
+
+                return state->is_ready();
+            }
+
+            inline decltype( auto ) get() const {
+                detail::check_state( state );
+
+                state->wait();
+
+                return state->peek();
+            }
+
+            inline void wait() const {
+                detail::check_state( state );
+
+                state->wait();
+            }
+
+            template <typename Rep, typename Period>
+            inline std::future_status wait_for( const std::chrono::duration<Rep, Period> &timeout_duration ) const {
+                detail::check_state( state );
+
+                return state->wait_for( timeout_duration );
+            }
+
+            template <typename Clock, typename Duration>
+            inline std::future_status wait_until( const std::chrono::time_point<Clock, Duration> &timeout_time ) const {
+                detail::check_state( state );
+
+                return state->wait_until( timeout_time );
+            }
+
+            template <typename Functor, typename LaunchPolicy = std::launch>
+            inline ThenableFuture<implicit_result_of<Functor, std::shared_future<T>>> then( Functor &&f, LaunchPolicy &&policy = std::launch( default_policy )) {
+                return then2( *this, std::forward<Functor>( f ), std::forward<LaunchPolicy>( policy ));
+            }
+    };
+
+    //////////
+
+    namespace detail {
+        template <typename T>
+        inline typename recursive_get_future_type<T>::type recursive_get( ThenableFuture<T> &&t ) {
+            return recursive_get( t.get());
+        };
+
+        template <typename T>
+        inline typename recursive_get_future_type<T>::type recursive_get( ThenableSharedFuture<T> &&t ) {
+            return recursive_get( t.get());
+        };
+
+        template <>
+        inline typename recursive_get_future_type<void>::type recursive_get<void>( ThenableFuture<void> &&t ) {
+            t.get();
+        };
+
+        template <>
+        inline typename recursive_get_future_type<void>::type recursive_get<void>( ThenableSharedFuture<void> &&t ) {
+            t.get();
+        };
+
+        template <typename T>
+        inline typename recursive_get_future_type<T>::type recursive_get( ThenablePromise<T> &&t ) {
+            return recursive_get( t.get_future());
+        };
+    }
+
+    //////////
+
+    /*
+     * These just convert future, shared_future and promise to their Thenable equivalent
+     * */
+
+    template <typename T>
+    constexpr ThenableFuture<T> to_thenable( std::future<T> &&t ) {
+        return ThenableFuture<T>( std::forward<std::future<T>>( t ));
+    }
+
+    template <typename T>
+    constexpr ThenableSharedFuture<T> to_thenable( const std::shared_future<T> &t ) {
+        return ThenableSharedFuture<T>( t );
+    }
+
+    template <typename T>
+    constexpr ThenableSharedFuture<T> to_thenable( std::shared_future<T> &&t ) {
+        return ThenableSharedFuture<T>( std::forward<std::shared_future<T>>( t ));
+    }
+
+    template <typename T>
+    inline ThenablePromise<T> to_thenable( std::promise<T> &&t ) {
+        return ThenablePromise<T>( std::forward<std::promise<T>>( t ));
+    }
+
+    //////////
+
+    template <typename T>
+    constexpr ThenableFuture<T> to_thenable( ThenableFuture<T> &&t ) {
+        return std::forward<ThenableFuture<T>>( t );
+    }
+
+    template <typename T>
+    constexpr ThenableSharedFuture<T> to_thenable( const ThenableSharedFuture<T> &t ) {
+        return std::forward<ThenableSharedFuture<T>>( t );
+    }
+
+    template <typename T>
+    constexpr ThenableSharedFuture<T> to_thenable( ThenableSharedFuture<T> &&t ) {
+        return std::forward<ThenableSharedFuture<T>>( t );
+    }
+
+    template <typename T>
+    constexpr ThenablePromise<T> to_thenable( ThenablePromise<T> &&t ) {
+        return std::forward<ThenablePromise<T>>( t );
+    }
+
+    //////////
+
+    template <typename... Results>
+    constexpr std::tuple<ThenableFuture<Results>...> to_thenable( std::tuple<std::future<Results>...> &&futures ) {
+        return std::tuple<ThenableFuture<Results>...>( std::forward<std::tuple<std::future<Results>...>>( futures ));
+    }
+
+    template <typename... Results>
+    constexpr std::tuple<ThenableSharedFuture<Results>...> to_thenable( std::tuple<std::shared_future<Results>...> &&futures ) {
+        return std::tuple<ThenableSharedFuture<Results>...>( std::forward<std::tuple<std::shared_future<Results>...>>( futures ));
+    }
+
+    template <typename... Results>
+    inline std::tuple<ThenablePromise<Results>...> to_thenable( std::tuple<std::promise<Results>...> &&promises ) {
+        return std::tuple<ThenablePromise<Results>...>( std::forward<std::tuple<std::promise<Results>...>>( promises ));
+    }
+
+    //////////
+
+    template <typename... Results>
+    constexpr std::tuple<ThenableFuture<Results>...> to_thenable( std::tuple<ThenableFuture<Results>...> &&futures ) {
+        return std::forward<std::tuple<ThenableFuture<Results>...>>( futures );
+    }
+
+    template <typename... Results>
+    constexpr std::tuple<ThenableSharedFuture<Results>...> to_thenable( std::tuple<ThenableSharedFuture<Results>...> &&futures ) {
+        return std::forward<std::tuple<ThenableSharedFuture<Results>...>>( futures );
+    }
+
+    template <typename... Results>
+    constexpr std::tuple<ThenablePromise<Results>...> to_thenable( std::tuple<ThenablePromise<Results>...> &&promises ) {
+        return std::forward<std::tuple<ThenablePromise<Results>...>>( promises );
+    }
+
+    //////////
+
+    /*
+     * These convert Thenable futures back to their standard equivalent, for code that still expects a std::future or std::shared_future.
+     *
+     * The result is passed on by a continuation, so no thread is left waiting on the Thenable future.
+     * */
+
+    template <typename T>
+    inline std::future<T> to_std_future( ThenableFuture<T> &&t ) {
+        auto s = std::move( detail::state_access::get( t ));
+
+        detail::check_state( s );
+
+        return detail::adapt_state( s, []( detail::shared_state<T> &s2 ) -> T {
+            return s2.take();
+        } );
+    }
+
+    template <typename T>
+    inline std::shared_future<T> to_std_future( const ThenableSharedFuture<T> &t ) {
+        const auto &s = detail::state_access::get( t );
+
+        detail::check_state( s );
+
+        return detail::adapt_state( s, []( detail::shared_state<T> &s2 ) -> T {
+            return s2.peek();
+        } ).share();
+    }
+
+    //////////
+
+    template <typename T, typename Functor, typename LaunchPolicy>
+    std::future<T> make_promise( Functor &&f, LaunchPolicy policy ) {
+        auto p = detail::make_state<std::promise<T>>();
+
+        return then( defer( [p]( Functor &&f2 ) THENABLE_NOEXCEPT {
+            detail::make_promise_helper<T>::dispatch( std::forward<Functor>( f2 ), p );
+
+        }, std::forward<Functor>( f )), [p] {
+            return p->get_future();
+
+        }, policy );
+    }
+
+    template <typename T, typename Functor, typename LaunchPolicy>
+    ThenableFuture<T> make_promise2( Functor &&f, LaunchPolicy &&policy ) {
+        auto p = detail::make_state<std::promise<T>>();
+
+        return then2( defer( [p]( Functor &&f2 ) THENABLE_NOEXCEPT {
+            detail::make_promise_helper<T>::dispatch( std::forward<Functor>( f2 ), p );
+
+        }, std::forward<Functor>( f )), [p] {
+            return p->get_future();
+
+        }, std::forward<LaunchPolicy>( policy ));
+    }
+
+    //////////
+
+    /*
+     * make_ready_future and make_exceptional_future
+     *
+     * These create a ThenableFuture that is already resolved. The result is held inline by the future, so there is no
+     * shared state or thread involved unless something like share or await_all needs one, and callbacks attached
+     * with then_launch::immediate are run right away. Other policies launch callbacks as usual.
+     * */
+
+    template <typename T>
+    inline ThenableFuture<typename std::decay<T>::type> make_ready_future( T &&value ) {
+        detail::ready_value<typename std::decay<T>::type> v;
+
+        v.set_value( std::forward<T>( value ));
+
+        return detail::state_access::make_future( std::move( v ));
+    }
+
+    inline ThenableFuture<void> make_ready_future() {
+        detail::ready_value<void> v;
+
+        v.set_value();
+
+        return detail::state_access::make_future( std::move( v ));
+    }
+
+    template <typename T>
+    inline ThenableFuture<T> make_exceptional_future( std::exception_ptr e ) {
+        detail::ready_value<T> v;
+
+        v.set_exception( e );
+
+        return detail::state_access::make_future( std::move( v ));
+    }
+
+    template <typename T, typename E>
+    inline typename std::enable_if<!std::is_same<typename std::decay<E>::type, std::exception_ptr>::value, ThenableFuture<T>>::type
+    make_exceptional_future( E &&e ) {
+        return make_exceptional_future<T>( std::make_exception_ptr( std::forward<E>( e )));
+    }
+
+    //////////
+
+    namespace detail {
+        template <typename... Functors>
+        using promise_tuple = std::tuple<std::promise<typename recursive_get_future_type<fn_traits::fn_result_of<Functors>>::type>...>;
+
+        template <typename... Functors>
+        using result_tuple = std::tuple<std::future<typename detail::recursive_get_future_type<fn_traits::fn_result_of<Functors>>::type>...>;
+
+        template <size_t i, typename... Functors>
+        constexpr typename std::enable_if<i == sizeof...( Functors )>::type
+        initialize_parallel_futures( result_tuple<Functors...> &, promise_tuple<Functors...> & ) {
+            //No-op
+        };
+
+        template <size_t i, typename... Functors>
+        inline typename std::enable_if<i < sizeof...( Functors )>::type
+        initialize_parallel_futures( result_tuple<Functors...> &result, promise_tuple<Functors...> &promises ) {
+            std::get<i>( result ) = std::get<i>( promises ).get_future();
+
+            initialize_parallel_futures<i + 1, Functors...>( result, promises );
+        };
+
+        template <typename R>
+        struct parallel_functor_helper {
+            template <typename Functor>
+            static inline void invoke( std::promise<typename recursive_get_future_type<R>::type> &p, Functor &f ) THENABLE_NOEXCEPT {
+                try {
+                    p.set_value( recursive_get( f()));
+
+                } catch( ... ) {
+                    p.set_exception( std::current_exception());
+                }
+            }
+        };
+
+        template <>
+        struct parallel_functor_helper<void> {
+            template <typename Functor>
+            static inline void invoke( std::promise<void> &p, Functor &f ) THENABLE_NOEXCEPT {
+                try {
+                    f();
+
+                    p.set_value();
+
+                } catch( ... ) {
+                    p.set_exception( std::current_exception());
+                }
+            }
+        };
+
+        /*
+         * parallel_job structure
+         *
+         * Shared by every worker of a parallel_n call. Workers claim functors by index from a single cursor,
+         * so each functor is run exactly once without the workers having to scan over each other's flags.
+         * */
+        template <typename... Functors>
+        struct parallel_job {
+            std::atomic_size_t                                 next;
+            promise_tuple<Functors...>                         promises;
+            std::tuple<typename std::decay<Functors>::type...> fns;
+
+            inline parallel_job( Functors &&... f ) : next( 0 ), fns( std::forward<Functors>( f )... ) {}
+        };
+
+        template <size_t i, typename... Functors>
+        inline void invoke_parallel_functor( parallel_job<Functors...> &job ) THENABLE_NOEXCEPT {
+            typedef typename std::tuple_element<i, std::tuple<fn_traits::fn_result_of<Functors>...>>::type R;
+
+            parallel_functor_helper<R>::invoke( std::get<i>( job.promises ), std::get<i>( job.fns ));
+        }
+
+        template <typename... Functors, size_t... S>
+        inline void run_parallel_job( parallel_job<Functors...> &job, std::index_sequence<S...> ) THENABLE_NOEXCEPT {
+            typedef void ( *invoker )( parallel_job<Functors...> & );
+
+            constexpr invoker invokers[] = { &invoke_parallel_functor<S, Functors...>... };
+
+            for( size_t i = job.next.fetch_add( 1, std::memory_order_relaxed ); i < sizeof...( Functors );
+                 i = job.next.fetch_add( 1, std::memory_order_relaxed )) {
+                invokers[i]( job );
+            }
+        }
+    }
+
+    namespace detail {
+        /*
+         * If the caller participates, it counts as one of the workers and claims functors alongside them until none are left.
+         *
+         * A concurrency of zero, which is what hardware_concurrency returns when it can't tell, still gets one worker.
+         * */
+        template <typename LaunchPolicy, typename... Functors>
+        std::tuple<std::future<recursive_result_of<Functors>>...> parallel_launch( LaunchPolicy policy, size_t concurrency, bool participate, Functors &&... fns ) {
+            static_assert( sizeof...( Functors ) > 0, "parallel_n requires at least one functor" );
+
+            result_tuple<Functors...> result;
+
+            auto job = make_state<parallel_job<Functors...>>( std::forward<Functors>( fns )... );
+
+            initialize_parallel_futures<0, Functors...>( result, job->promises );
+
+            size_t workers = std::min( std::max<size_t>( concurrency, 1 ), sizeof...( Functors ));
+
+            for( size_t i = participate ? 1 : 0; i < workers; ++i ) {
+                launch( policy, [job]() THENABLE_NOEXCEPT {
+                    run_parallel_job( *job, std::index_sequence_for<Functors...>());
+                } );
+            }
+
+            if( participate ) {
+                run_parallel_job( *job, std::index_sequence_for<Functors...>());
+            }
+
+            return result;
+        }
+    }
+
+    /*
+     * Tag for parallel_n and friends to have the calling thread run functors as well, counting as one of the workers.
+     * The call then returns once every functor has been started, rather than right away.
+     * */
+    struct participate_t {
+    };
+
+    constexpr participate_t participate{};
+
+    /*
+     * parallel_n with an executor
+     *
+     * Same as below, but the workers are submitted to the executor instead of each getting a thread of their own
+     * */
+    template <typename Executor, typename... Functors>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, std::tuple<std::future<recursive_result_of<Functors>>...>>::type
+    parallel_n( Executor &executor, size_t concurrency, Functors &&... fns ) {
+        return detail::parallel_launch( detail::executor_ref<Executor>( executor ), concurrency, false, std::forward<Functors>( fns )... );
+    }
+
+    template <typename Executor, typename... Functors>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, std::tuple<std::future<recursive_result_of<Functors>>...>>::type
+    parallel_n( participate_t, Executor &executor, size_t concurrency, Functors &&... fns ) {
+        return detail::parallel_launch( detail::executor_ref<Executor>( executor ), concurrency, true, std::forward<Functors>( fns )... );
+    }
+
+    template <typename Executor, typename... Functors>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, std::tuple<std::future<recursive_result_of<Functors>>...>>::type
+    parallel( Executor &executor, Functors &&... fns ) {
+        return parallel_n( executor, std::thread::hardware_concurrency(), std::forward<Functors>( fns )... );
+    }
+
+    template <typename Executor, typename... Functors>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, std::tuple<std::future<recursive_result_of<Functors>>...>>::type
+    parallel( participate_t, Executor &executor, Functors &&... fns ) {
+        return parallel_n( participate, executor, std::thread::hardware_concurrency(), std::forward<Functors>( fns )... );
+    }
+
+    template <typename Executor, typename... Functors>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, std::tuple<ThenableFuture<recursive_result_of<Functors>>...>>::type
+    parallel2_n( Executor &executor, size_t concurrency, Functors &&... fns ) {
+        //Implicit conversion to ThenableFuture
+        return parallel_n( executor, concurrency, std::forward<Functors>( fns )... );
+    }
+
+    template <typename Executor, typename... Functors>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, std::tuple<ThenableFuture<recursive_result_of<Functors>>...>>::type
+    parallel2_n( participate_t, Executor &executor, size_t concurrency, Functors &&... fns ) {
+        //Implicit conversion to ThenableFuture
+        return parallel_n( participate, executor, concurrency, std::forward<Functors>( fns )... );
+    }
+
+    template <typename Executor, typename... Functors>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, std::tuple<ThenableFuture<recursive_result_of<Functors>>...>>::type
+    parallel2( Executor &executor, Functors &&... fns ) {
+        //Implicit conversion to ThenableFuture
+        return parallel( executor, std::forward<Functors>( fns )... );
+    }
+
+    template <typename Executor, typename... Functors>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, std::tuple<ThenableFuture<recursive_result_of<Functors>>...>>::type
+    parallel2( participate_t, Executor &executor, Functors &&... fns ) {
+        //Implicit conversion to ThenableFuture
+        return parallel( participate, executor, std::forward<Functors>( fns )... );
+    }
+
+    /*
+     * parallel_n function
+     *
+     * Runs the functors on up to concurrency workers, each on a thread of its own. Workers claim functors one at a time
+     * from a shared cursor until there are none left.
+     * */
+    template <typename... Functors>
+    inline std::tuple<std::future<recursive_result_of<Functors>>...> parallel_n( size_t concurrency, Functors &&... fns ) {
+        return detail::parallel_launch( then_launch::detached, concurrency, false, std::forward<Functors>( fns )... );
+    }
+
+    template <typename... Functors>
+    inline std::tuple<std::future<recursive_result_of<Functors>>...> parallel_n( participate_t, size_t concurrency, Functors &&... fns ) {
+        return detail::parallel_launch( then_launch::detached, concurrency, true, std::forward<Functors>( fns )... );
+    }
+
+    template <typename... Functors>
+    inline std::tuple<std::future<recursive_result_of<Functors>>...> parallel( Functors &&... fns ) {
+        return parallel_n( std::thread::hardware_concurrency(), std::forward<Functors>( fns )... );
+    }
+
+    template <typename... Functors>
+    inline std::tuple<std::future<recursive_result_of<Functors>>...> parallel( participate_t, Functors &&... fns ) {
+        return parallel_n( participate, std::thread::hardware_concurrency(), std::forward<Functors>( fns )... );
+    }
+
+    template <typename... Functors>
+    inline std::tuple<ThenableFuture<recursive_result_of<Functors>>...> parallel2_n( size_t concurrency, Functors &&... fns ) {
+        //Implicit conversion to ThenableFuture
+        return parallel_n( concurrency, std::forward<Functors>( fns )... );
+    }
+
+    template <typename... Functors>
+    inline std::tuple<ThenableFuture<recursive_result_of<Functors>>...> parallel2_n( participate_t, size_t concurrency, Functors &&... fns ) {
+        //Implicit conversion to ThenableFuture
+        return parallel_n( participate, concurrency, std::forward<Functors>( fns )... );
+    }
+
+    template <typename... Functors>
+    inline std::tuple<ThenableFuture<recursive_result_of<Functors>>...> parallel2( Functors &&... fns ) {
+        //Implicit conversion to ThenableFuture
+        return parallel( std::forward<Functors>( fns )... );
+    }
+
+    template <typename... Functors>
+    inline std::tuple<ThenableFuture<recursive_result_of<Functors>>...> parallel2( participate_t, Functors &&... fns ) {
+        //Implicit conversion to ThenableFuture
+        return parallel( participate, std::forward<Functors>( fns )... );
+    }
+
+    //////////
+
+    namespace detail {
+        /*
+         * range_job structure
+         *
+         * Shared by the workers of parallel_for and parallel_invoke. Indices in [0, count) are claimed a chunk at a time from a single cursor,
+         * so the cost of scheduling is spread over every item in the chunk.
+         * */
+        template <typename Body>
+        struct range_job {
+            std::atomic_size_t next;
+            const size_t       count;
+            const size_t       chunk;
+            Body               body;
+
+            inline range_job( size_t n, size_t c, Body &&b ) : next( 0 ), count( n ), chunk( c ), body( std::move( b )) {}
+        };
+
+        template <typename Body>
+        inline void run_range_job( range_job<Body> &job ) THENABLE_NOEXCEPT {
+            for( size_t begin = job.next.fetch_add( job.chunk, std::memory_order_relaxed ); begin < job.count;
+                 begin = job.next.fetch_add( job.chunk, std::memory_order_relaxed )) {
+                job.body( begin, std::min( begin + job.chunk, job.count ));
+            }
+        }
+
+        /*
+         * Splits the range into about four chunks per worker, which is enough to even out uneven items without
+         * going back to the cursor for every one of them.
+         * */
+        template <typename LaunchPolicy, typename Body>
+        void launch_range( LaunchPolicy policy, size_t concurrency, bool participate, size_t count, Body &&body ) {
+            if( count == 0 ) {
+                return;
+            }
+
+            size_t workers = std::min( std::max<size_t>( concurrency, 1 ), count );
+            size_t chunk   = std::max<size_t>( count / ( workers * 4 ), 1 );
+
+            auto job = make_state<range_job<typename std::decay<Body>::type>>( count, chunk, std::forward<Body>( body ));
+
+            for( size_t i = participate ? 1 : 0; i < workers; ++i ) {
+                launch( policy, [job]() THENABLE_NOEXCEPT {
+                    run_range_job( *job );
+                } );
+            }
+
+            if( participate ) {
+                run_range_job( *job );
+            }
+        }
+
+        template <typename Iterator>
+        inline size_t range_count( Iterator first, Iterator last, std::true_type ) {
+            return last > first ? static_cast<size_t>( last - first ) : 0;
+        }
+
+        template <typename Iterator>
+        inline size_t range_count( Iterator first, Iterator last, std::false_type ) {
+            return static_cast<size_t>( std::distance( first, last ));
+        }
+
+        template <typename Iterator>
+        inline Iterator range_element( Iterator first, size_t i, std::true_type ) {
+            return first + static_cast<Iterator>( i );
+        }
+
+        template <typename Iterator>
+        inline decltype( auto ) range_element( Iterator first, size_t i, std::false_type ) {
+            return *( first + i );
+        }
+
+        /*
+         * The first exception thrown by any item is the one the resulting future holds. Whichever chunk finishes
+         * last resolves it, so it's only resolved once every item has run or been skipped.
+         * */
+        struct for_join {
+            std::atomic_size_t                  remaining;
+            std::atomic_bool                    failed;
+            std::exception_ptr                  error;
+            std::shared_ptr<shared_state<void>> result;
+
+            inline explicit for_join( size_t n ) : remaining( n ), failed( false ), result( make_state<shared_state<void>>()) {}
+
+            inline void finish( size_t n ) THENABLE_NOEXCEPT {
+                if( remaining.fetch_sub( n, std::memory_order_acq_rel ) == n ) {
+                    if( failed.load( std::memory_order_relaxed )) {
+                        result->set_exception( error );
+
+                    } else {
+                        result->set_value();
+                    }
+                }
+            }
+        };
+
+        template <typename LaunchPolicy, typename Iterator, typename Functor>
+        ThenableFuture<void> parallel_for_launch( LaunchPolicy policy, size_t concurrency, bool participate, Iterator first, Iterator last, Functor &&f ) {
+            typedef typename std::is_integral<Iterator>::type is_index;
+            typedef typename std::decay<Functor>::type        functor_type;
+
+            size_t count = range_count( first, last, is_index());
+
+            auto join   = make_state<for_join>( count );
+            auto result = join->result;
+
+            if( count == 0 ) {
+                result->set_value();
+
+            } else {
+                launch_range( policy, concurrency, participate, count, [join, first, f2 = functor_type( std::forward<Functor>( f ))]( size_t begin, size_t end ) mutable {
+                    try {
+                        for( size_t i = begin; i < end; ++i ) {
+                            f2( range_element( first, i, is_index()));
+                        }
+
+                    } catch( ... ) {
+                        if( !join->failed.exchange( true, std::memory_order_relaxed )) {
+                            join->error = std::current_exception();
+                        }
+                    }
+
+                    join->finish( end - begin );
+                } );
+            }
+
+            return state_access::make_future( std::move( result ));
+        }
+
+        template <typename LaunchPolicy, typename Functor>
+        std::vector<ThenableFuture<recursive_result_of<Functor>>> parallel_invoke_launch( LaunchPolicy policy, size_t concurrency, bool participate,
+                                                                                          std::vector<Functor> &&fns ) {
+            typedef recursive_result_of<Functor> R;
+
+            std::vector<std::shared_ptr<shared_state<R>>> states;
+            std::vector<ThenableFuture<R>>                results;
+
+            states.reserve( fns.size());
+            results.reserve( fns.size());
+
+            for( size_t i = 0; i < fns.size(); ++i ) {
+                states.push_back( make_state<shared_state<R>>());
+                results.push_back( state_access::make_future( std::shared_ptr<shared_state<R>>( states.back())));
+            }
+
+            size_t count = fns.size();
+
+            launch_range( policy, concurrency, participate, count, [states2 = std::move( states ), fns2 = std::move( fns )]( size_t begin, size_t end ) mutable {
+                for( size_t i = begin; i < end; ++i ) {
+                    fulfill( states2[i], [&fns2, i]() noexcept( noexcept( fns2[i]())) -> decltype( auto ) {
+                        return fns2[i]();
+                    } );
+                }
+            } );
+
+            return results;
+        }
+    }
+
+    /*
+     * parallel_for function
+     *
+     * Calls the functor with every index in [first, last), or with every element if given random-access iterators.
+     * The range is split into chunks run by the same kind of workers as parallel_n, and the resulting future is resolved
+     * once every item has run, holding the first exception thrown if any.
+     *
+     * Every worker shares the one functor, so it may be called concurrently.
+     * */
+    template <typename Iterator, typename Functor>
+    inline ThenableFuture<void> parallel_for( Iterator first, Iterator last, Functor &&f ) {
+        return detail::parallel_for_launch( then_launch::detached, std::thread::hardware_concurrency(), false, first, last, std::forward<Functor>( f ));
+    }
+
+    template <typename Iterator, typename Functor>
+    inline ThenableFuture<void> parallel_for( participate_t, Iterator first, Iterator last, Functor &&f ) {
+        return detail::parallel_for_launch( then_launch::detached, std::thread::hardware_concurrency(), true, first, last, std::forward<Functor>( f ));
+    }
+
+    template <typename Executor, typename Iterator, typename Functor>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<void>>::type
+    parallel_for( Executor &executor, Iterator first, Iterator last, Functor &&f ) {
+        return detail::parallel_for_launch( detail::executor_ref<Executor>( executor ), std::thread::hardware_concurrency(), false, first, last,
+                                            std::forward<Functor>( f ));
+    }
+
+    template <typename Executor, typename Iterator, typename Functor>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<void>>::type
+    parallel_for( participate_t, Executor &executor, Iterator first, Iterator last, Functor &&f ) {
+        return detail::parallel_for_launch( detail::executor_ref<Executor>( executor ), std::thread::hardware_concurrency(), true, first, last,
+                                            std::forward<Functor>( f ));
+    }
+
+    /*
+     * parallel_invoke function
+     *
+     * Like parallel, but for any number of functors of the same type, with a future for each of them.
+     * */
+    template <typename Functor>
+    inline std::vector<ThenableFuture<recursive_result_of<Functor>>> parallel_invoke( std::vector<Functor> fns ) {
+        return detail::parallel_invoke_launch( then_launch::detached, std::thread::hardware_concurrency(), false, std::move( fns ));
+    }
+
+    template <typename Functor>
+    inline std::vector<ThenableFuture<recursive_result_of<Functor>>> parallel_invoke( participate_t, std::vector<Functor> fns ) {
+        return detail::parallel_invoke_launch( then_launch::detached, std::thread::hardware_concurrency(), true, std::move( fns ));
+    }
+
+    template <typename Executor, typename Functor>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, std::vector<ThenableFuture<recursive_result_of<Functor>>>>::type
+    parallel_invoke( Executor &executor, std::vector<Functor> fns ) {
+        return detail::parallel_invoke_launch( detail::executor_ref<Executor>( executor ), std::thread::hardware_concurrency(), false, std::move( fns ));
+    }
+
+    template <typename Executor, typename Functor>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, std::vector<ThenableFuture<recursive_result_of<Functor>>>>::type
+    parallel_invoke( participate_t, Executor &executor, std::vector<Functor> fns ) {
+        return detail::parallel_invoke_launch( detail::executor_ref<Executor>( executor ), std::thread::hardware_concurrency(), true, std::move( fns ));
+    }
+
+    //////////
+
+    namespace detail {
+        /*
+         * all_join structure
+         *
+         * Holds the shared states given to await_all and counts how many are still pending. Whichever state resolves last
+         * assembles the resulting tuple, so no thread has to wait on any of them.
+         * */
+        template <typename... Results>
+        struct all_join {
+            std::atomic_size_t                                     remaining;
+            std::tuple<std::shared_ptr<shared_state<Results>>...> states;
+            std::shared_ptr<shared_state<std::tuple<Results...>>>  result;
+
+            inline all_join( std::tuple<std::shared_ptr<shared_state<Results>>...> &&s )
+                : remaining( sizeof...( Results )),
+                  states( std::move( s )),
+                  result( make_state<shared_state<std::tuple<Results...>>>()) {}
+        };
+
+        template <typename T>
+        inline T state_value( shared_state<T> &s, take_tag ) {
+            return s.take();
+        }
+
+        template <typename T>
+        inline decltype( auto ) state_value( shared_state<T> &s, peek_tag ) {
+            return s.peek();
+        }
+
+        /*
+         * Braced initialization so the values are taken in order, and the first exception by index is the one that's rethrown
+         * */
+        template <typename Tag, typename... Results, std::size_t... S>
+        inline std::tuple<Results...> take_join_values( std::tuple<std::shared_ptr<shared_state<Results>>...> &states, std::index_sequence<S...> ) {
+            return std::tuple<Results...>{ state_value( *std::get<S>( states ), Tag())... };
+        }
+
+        /*
+         * await_states function
+         *
+         * A deferred policy leaves waiting on each state to whoever waits on the result, just like the std::async version.
+         *
+         * Otherwise each state counts down as it resolves, and the last one assembles the tuple on the thread that resolved it.
+         * That's only a few moves, so dedicated policies don't bother launching anything for it, while executors still get it submitted.
+         * */
+        template <typename Tag, typename LaunchPolicy, typename... Results, std::size_t... S>
+        ThenableFuture<std::tuple<Results...>> await_states( std::tuple<std::shared_ptr<shared_state<Results>>...> &&states, LaunchPolicy policy,
+                                                             std::index_sequence<S...> ) {
+            typedef std::tuple<Results...> R;
+
+            int checked[] = { 0, ( check_state( std::get<S>( states )), 0 )... };
+
+            (void)checked;
+
+            if( is_lazy( policy )) {
+                auto result = make_state<shared_state<R>>();
+
+                std::weak_ptr<shared_state<R>> weak = result;
+
+                result->set_deferred( make_continuation( [weak, states2 = std::move( states )]() mutable THENABLE_NOEXCEPT {
+                    if( auto result2 = weak.lock()) {
+                        int waited[] = { 0, ( std::get<S>( states2 )->wait(), 0 )... };
+
+                        (void)waited;
+
+                        fulfill( result2, [&states2] {
+                            return take_join_values<Tag>( states2, std::index_sequence<S...>());
+                        } );
+                    }
+                } ));
+
+                return state_access::make_future( std::move( result ));
+            }
+
+            auto join   = make_state<all_join<Results...>>( std::move( states ));
+            auto result = join->result;
+
+            auto assemble = [join]() THENABLE_NOEXCEPT {
+                fulfill( join->result, [&join] {
+                    return take_join_values<Tag>( join->states, std::index_sequence<S...>());
+                } );
+            };
+
+            if( sizeof...( Results ) == 0 ) {
+                assemble();
+            }
+
+            int attached[] = { 0, ( attach_continuation( std::get<S>( join->states ), make_continuation( [join, policy, assemble]() mutable THENABLE_NOEXCEPT {
+                if( --join->remaining == 0 ) {
+                    if( is_dedicated( policy )) {
+                        assemble();
+
+                    } else {
+                        try {
+                            launch( policy, std::move( assemble ));
+
+                        } catch( ... ) {
+                            join->result->set_exception( std::current_exception());
+                        }
+                    }
+                }
+            } )), 0 )... };
+
+            (void)attached;
+
+            return state_access::make_future( std::move( result ));
+        }
+
+        /*
+         * Pull the shared states out of a tuple of futures, adapting standard futures along the way
+         * */
+
+        template <typename... Results, std::size_t... S>
+        inline std::tuple<std::shared_ptr<shared_state<Results>>...> tuple_states( std::tuple<ThenableFuture<Results>...> &&futures, std::index_sequence<S...> ) {
+            return std::make_tuple( std::move( state_access::get( std::get<S>( futures )))... );
+        }
+
+        template <typename... Results, std::size_t... S>
+        inline std::tuple<std::shared_ptr<shared_state<Results>>...> tuple_states( std::tuple<ThenableSharedFuture<Results>...> &&futures, std::index_sequence<S...> ) {
+            return std::make_tuple( std::move( state_access::get( std::get<S>( futures )))... );
+        }
+
+        template <typename... Results, std::size_t... S>
+        inline std::tuple<std::shared_ptr<shared_state<Results>>...> tuple_states( std::tuple<ThenablePromise<Results>...> &&promises, std::index_sequence<S...> ) {
+            return std::make_tuple( std::shared_ptr<shared_state<Results>>( state_access::get( std::get<S>( promises )))... );
+        }
+
+        template <typename... Results, std::size_t... S>
+        inline std::tuple<std::shared_ptr<shared_state<Results>>...> tuple_states( std::tuple<std::future<Results>...> &&futures, std::index_sequence<S...> ) {
+            return std::make_tuple( adapt_future<Results>( std::move( std::get<S>( futures )))... );
+        }
+
+        template <typename... Results, std::size_t... S>
+        inline std::tuple<std::shared_ptr<shared_state<Results>>...> tuple_states( std::tuple<std::shared_future<Results>...> &&futures, std::index_sequence<S...> ) {
+            return std::make_tuple( adapt_future<Results>( std::move( std::get<S>( futures )))... );
+        }
+
+        template <typename... Results, std::size_t... S>
+        inline std::tuple<std::shared_ptr<shared_state<Results>>...> tuple_states( std::tuple<std::promise<Results>...> &&promises, std::index_sequence<S...> ) {
+            return std::make_tuple( adapt_future<Results>( std::get<S>( promises ).get_future())... );
+        }
+    }
+
+    /*
+     * await_all function
+     *
+     * Each future counts down as it resolves, and the last one to do so resolves the result, so no thread is parked
+     * waiting on any of them. Standard futures can't notify anyone, so each one that isn't ready yet still needs
+     * a thread blocking on it.
+     *
+     * Promises are given up by await_all, so any that weren't fulfilled beforehand end up as broken promises.
+     * */
+
+    template <typename... Results>
+    std::future<std::tuple<Results...>> await_all( std::tuple<std::future<Results>...> &&results, std::launch policy = default_policy ) {
+        return to_std_future( detail::await_states<detail::take_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>() ), policy, std::index_sequence_for<Results...>() ) );
+    }
+
+    template <typename... Results>
+    std::future<std::tuple<Results...>> await_all( std::tuple<std::shared_future<Results>...> &&results, std::launch policy = default_policy ) {
+        return to_std_future( detail::await_states<detail::take_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>() ), policy, std::index_sequence_for<Results...>() ) );
+    }
+
+    template <typename... Results>
+    ThenableFuture<std::tuple<Results...>> await_all( std::tuple<ThenableFuture<Results>...> &&results, std::launch policy = default_policy ) {
+        return detail::await_states<detail::take_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>() ), policy, std::index_sequence_for<Results...>() );
+    }
+
+    template <typename... Results>
+    ThenableFuture<std::tuple<Results...>> await_all( std::tuple<ThenableSharedFuture<Results>...> &&results, std::launch policy = default_policy ) {
+        return detail::await_states<detail::peek_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>() ), policy, std::index_sequence_for<Results...>() );
+    }
+
+    template <typename... Results>
+    std::future<std::tuple<Results...>> await_all( std::tuple<std::promise<Results>...> &&results, std::launch policy = default_policy ) {
+        return to_std_future( detail::await_states<detail::take_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>() ), policy, std::index_sequence_for<Results...>() ) );
+    }
+
+    template <typename... Results>
+    ThenableFuture<std::tuple<Results...>> await_all( std::tuple<ThenablePromise<Results>...> &&results, std::launch policy = default_policy ) {
+        return detail::await_states<detail::take_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>() ), policy, std::index_sequence_for<Results...>() );
+    }
+
+    //////////
+
+    template <typename... Results>
+    std::future<std::tuple<Results...>> await_all( std::tuple<std::future<Results>...> &&results, then_launch policy ) {
+        return to_std_future( detail::await_states<detail::take_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>() ), policy, std::index_sequence_for<Results...>() ) );
+    }
+
+    template <typename... Results>
+    std::future<std::tuple<Results...>> await_all( std::tuple<std::shared_future<Results>...> &&results, then_launch policy ) {
+        return to_std_future( detail::await_states<detail::take_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>() ), policy, std::index_sequence_for<Results...>() ) );
+    }
+
+    template <typename... Results>
+    ThenableFuture<std::tuple<Results...>> await_all( std::tuple<ThenableFuture<Results>...> &&results, then_launch policy ) {
+        return detail::await_states<detail::take_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>() ), policy, std::index_sequence_for<Results...>() );
+    }
+
+    template <typename... Results>
+    ThenableFuture<std::tuple<Results...>> await_all( std::tuple<ThenableSharedFuture<Results>...> &&results, then_launch policy ) {
+        return detail::await_states<detail::peek_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>() ), policy, std::index_sequence_for<Results...>() );
+    }
+
+    template <typename... Results>
+    std::future<std::tuple<Results...>> await_all( std::tuple<std::promise<Results>...> &&results, then_launch policy ) {
+        return to_std_future( detail::await_states<detail::take_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>() ), policy, std::index_sequence_for<Results...>() ) );
+    }
+
+    template <typename... Results>
+    ThenableFuture<std::tuple<Results...>> await_all( std::tuple<ThenablePromise<Results>...> &&results, then_launch policy ) {
+        return detail::await_states<detail::take_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>() ), policy, std::index_sequence_for<Results...>() );
+    }
+
+    /*
+     * await_all with an executor
+     *
+     * Same as above, but the task that builds the resulting tuple is submitted to the executor.
+     * */
+
+    template <typename Executor, typename... Results>
+    typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<std::tuple<Results...>>>::type
+    await_all( std::tuple<std::future<Results>...> &&results, Executor &executor ) {
+        return detail::await_states<detail::take_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>()),
+                                                       detail::executor_ref<Executor>( executor ), std::index_sequence_for<Results...>());
+    }
+
+    template <typename Executor, typename... Results>
+    typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<std::tuple<Results...>>>::type
+    await_all( std::tuple<std::shared_future<Results>...> &&results, Executor &executor ) {
+        return detail::await_states<detail::take_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>()),
+                                                       detail::executor_ref<Executor>( executor ), std::index_sequence_for<Results...>());
+    }
+
+    template <typename Executor, typename... Results>
+    typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<std::tuple<Results...>>>::type
+    await_all( std::tuple<ThenableFuture<Results>...> &&results, Executor &executor ) {
+        return detail::await_states<detail::take_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>()),
+                                                       detail::executor_ref<Executor>( executor ), std::index_sequence_for<Results...>());
+    }
+
+    template <typename Executor, typename... Results>
+    typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<std::tuple<Results...>>>::type
+    await_all( std::tuple<ThenableSharedFuture<Results>...> &&results, Executor &executor ) {
+        return detail::await_states<detail::peek_tag>( detail::tuple_states( std::move( results ), std::index_sequence_for<Results...>()),
+                                                       detail::executor_ref<Executor>( executor ), std::index_sequence_for<Results...>());
+    }
+
+    //////////
+
+    namespace detail {
+        /*
+         * Values can only be stored into their slots as they arrive if the slots exist up front and can be written independently.
+         * std::vector<bool> packs its elements into shared words, so writing two of them from different threads would race.
+         * */
+        template <typename T>
+        struct stores_in_place : std::integral_constant<bool, std::is_default_constructible<T>::value && !std::is_same<T, bool>::value> {};
+
+        /*
+         * vector_join structure
+         *
+         * The runtime-sized version of all_join. The results vector is allocated once up front, and when stores_in_place is true
+         * each value is moved into its slot as soon as its future resolves, releasing that future's state right away.
+         * Otherwise the values are moved in order once every future has resolved.
+         * */
+        template <typename T>
+        struct vector_join {
+            std::atomic_size_t                             remaining;
+            std::atomic_bool                               failed;
+            std::exception_ptr                             error;
+            std::vector<std::shared_ptr<shared_state<T>>>  states;
+            std::vector<T>                                 values;
+            std::shared_ptr<shared_state<std::vector<T>>> result;
+
+            inline vector_join( std::vector<std::shared_ptr<shared_state<T>>> &&s )
+                : remaining( s.size()),
+                  failed( false ),
+                  states( std::move( s )),
+                  result( make_state<shared_state<std::vector<T>>>()) {
+
+                allocate( stores_in_place<T>());
+            }
+
+            inline void allocate( std::true_type ) {
+                values.resize( states.size());
+            }
+
+            inline void allocate( std::false_type ) {
+                values.reserve( states.size());
+            }
+        };
+
+        template <typename T, typename Tag>
+        inline std::vector<T> take_vector_values( std::vector<std::shared_ptr<shared_state<T>>> &states, Tag ) {
+            std::vector<T> values;
+
+            values.reserve( states.size());
+
+            for( auto &s : states ) {
+                values.push_back( state_value( *s, Tag()));
+            }
+
+            return values;
+        }
+
+        template <typename T, typename Tag>
+        inline void store_vector_value( vector_join<T> &join, size_t i, Tag, std::true_type ) THENABLE_NOEXCEPT {
+            try {
+                join.values[i] = state_value( *join.states[i], Tag());
+
+            } catch( ... ) {
+                if( !join.failed.exchange( true )) {
+                    join.error = std::current_exception();
+                }
+            }
+
+            join.states[i].reset();
+        }
+
+        template <typename T, typename Tag>
+        inline void store_vector_value( vector_join<T> &, size_t, Tag, std::false_type ) THENABLE_NOEXCEPT {
+            //Taken in order once they're all resolved
+        }
+
+        template <typename T, typename Tag>
+        inline std::vector<T> &&collect_vector_values( vector_join<T> &join, Tag, std::true_type ) {
+            return std::move( join.values );
+        }
+
+        template <typename T, typename Tag>
+        inline std::vector<T> &&collect_vector_values( vector_join<T> &join, Tag, std::false_type ) {
+            for( auto &s : join.states ) {
+                join.values.push_back( state_value( *s, Tag()));
+            }
+
+            return std::move( join.values );
+        }
+
+        template <typename Tag, typename T, typename LaunchPolicy>
+        ThenableFuture<std::vector<T>> await_vector( std::vector<std::shared_ptr<shared_state<T>>> &&states, LaunchPolicy policy ) {
+            static_assert( !std::is_void<T>::value, "await_all over a vector requires futures with a value" );
+
+            typedef std::vector<T>                                    R;
+            typedef stores_in_place<T>                                in_place;
+
+            for( auto &s : states ) {
+                check_state( s );
+            }
+
+            if( is_lazy( policy )) {
+                auto result = make_state<shared_state<R>>();
+
+                std::weak_ptr<shared_state<R>> weak = result;
+
+                result->set_deferred( make_continuation( [weak, states2 = std::move( states )]() mutable THENABLE_NOEXCEPT {
+                    if( auto result2 = weak.lock()) {
+                        for( auto &s : states2 ) {
+                            s->wait();
+                        }
+
+                        fulfill( result2, [&states2] {
+                            return take_vector_values( states2, Tag());
+                        } );
+                    }
+                } ));
+
+                return state_access::make_future( std::move( result ));
+            }
+
+            auto join   = make_state<vector_join<T>>( std::move( states ));
+            auto result = join->result;
+
+            auto assemble = [join]() THENABLE_NOEXCEPT {
+                if( join->failed.load()) {
+                    join->result->set_exception( join->error );
+
+                } else {
+                    fulfill( join->result, [&join]() -> R {
+                        return collect_vector_values( *join, Tag(), in_place());
+                    } );
+                }
+            };
+
+            if( join->states.empty()) {
+                assemble();
+            }
+
+            //Each continuation may release its state as soon as it's attached, so they're attached through a copy
+            const size_t count = join->states.size();
+
+            for( size_t i = 0; i < count; ++i ) {
+                attach_continuation( std::shared_ptr<shared_state<T>>( join->states[i] ), make_continuation( [join, i, policy, assemble]() mutable THENABLE_NOEXCEPT {
+                    store_vector_value( *join, i, Tag(), in_place());
+
+                    if( --join->remaining == 0 ) {
+                        if( is_dedicated( policy )) {
+                            assemble();
+
+                        } else {
+                            try {
+                                launch( policy, std::move( assemble ));
+
+                            } catch( ... ) {
+                                join->result->set_exception( std::current_exception());
+                            }
+                        }
+                    }
+                } ));
+            }
+
+            return state_access::make_future( std::move( result ));
+        }
+
+        template <typename T>
+        inline std::vector<std::shared_ptr<shared_state<T>>> vector_states( std::vector<ThenableFuture<T>> &&futures ) {
+            std::vector<std::shared_ptr<shared_state<T>>> states;
+
+            states.reserve( futures.size());
+
+            for( auto &f : futures ) {
+                states.push_back( std::move( state_access::get( f )));
+            }
+
+            return states;
+        }
+
+        template <typename T>
+        inline std::vector<std::shared_ptr<shared_state<T>>> vector_states( std::vector<ThenableSharedFuture<T>> &&futures ) {
+            std::vector<std::shared_ptr<shared_state<T>>> states;
+
+            states.reserve( futures.size());
+
+            for( auto &f : futures ) {
+                states.push_back( std::move( state_access::get( f )));
+            }
+
+            return states;
+        }
+    }
 
     /*
-     * Overload for promise references. The promise is NOT moved, but rather the future is acquired
-     * from it and the promise is left intact, so it can be used elsewhere.
+     * await_all for a runtime number of futures
+     *
+     * Works like the tuple versions, resolving to a vector of the values in the same order as the futures.
+     * Shared futures have their values copied, since other shared futures may still be reading them.
      * */
-    template <typename T, typename Functor>
-    inline std::future<implicit_result_of<Functor, std::future<T>>> then( std::promise<T> &s, Functor &&f, std::launch policy ) {
-        return then( s.get_future(), std::forward<Functor>( f ), policy );
-    };
+
+    template <typename T>
+    inline ThenableFuture<std::vector<T>> await_all( std::vector<ThenableFuture<T>> &&results, std::launch policy = default_policy ) {
+        return detail::await_vector<detail::take_tag>( detail::vector_states( std::move( results )), policy );
+    }
+
+    template <typename T>
+    inline ThenableFuture<std::vector<T>> await_all( std::vector<ThenableSharedFuture<T>> &&results, std::launch policy = default_policy ) {
+        return detail::await_vector<detail::peek_tag>( detail::vector_states( std::move( results )), policy );
+    }
+
+    template <typename T>
+    inline ThenableFuture<std::vector<T>> await_all( std::vector<ThenableFuture<T>> &&results, then_launch policy ) {
+        return detail::await_vector<detail::take_tag>( detail::vector_states( std::move( results )), policy );
+    }
+
+    template <typename T>
+    inline ThenableFuture<std::vector<T>> await_all( std::vector<ThenableSharedFuture<T>> &&results, then_launch policy ) {
+        return detail::await_vector<detail::peek_tag>( detail::vector_states( std::move( results )), policy );
+    }
+
+    template <typename Executor, typename T>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<std::vector<T>>>::type
+    await_all( std::vector<ThenableFuture<T>> &&results, Executor &executor ) {
+        return detail::await_vector<detail::take_tag>( detail::vector_states( std::move( results )), detail::executor_ref<Executor>( executor ));
+    }
+
+    template <typename Executor, typename T>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<std::vector<T>>>::type
+    await_all( std::vector<ThenableSharedFuture<T>> &&results, Executor &executor ) {
+        return detail::await_vector<detail::peek_tag>( detail::vector_states( std::move( results )), detail::executor_ref<Executor>( executor ));
+    }
 
     //////////
 
+    namespace detail {
+        /*
+         * any_join structure
+         *
+         * Shared by the continuations when_any attaches to each of its futures. The first one to flip done resolves the result,
+         * while the rest see it already set and return without touching anything else, so there's no lock for them to contend on.
+         *
+         * The winner also takes the result out of the join, so the losers only keep the flag alive until they resolve.
+         * */
+        template <typename R>
+        struct any_join {
+            std::atomic_bool                 done;
+            std::shared_ptr<shared_state<R>> result;
+
+            inline any_join() : done( false ), result( make_state<shared_state<R>>()) {}
+
+            inline std::shared_ptr<shared_state<R>> claim() THENABLE_NOEXCEPT {
+                if( done.load( std::memory_order_relaxed ) || done.exchange( true, std::memory_order_acq_rel )) {
+                    return nullptr;
+                }
+
+                return std::move( result );
+            }
+        };
+
+        /*
+         * Pairs the value of a future with its index, or just the index for void futures
+         * */
+        template <typename T>
+        struct any_value {
+            typedef std::pair<size_t, T> type;
+        };
+
+        template <>
+        struct any_value<void> {
+            typedef size_t type;
+        };
+
+        template <typename T, typename Tag>
+        inline std::pair<size_t, T> indexed_value( size_t i, shared_state<T> &s, Tag ) {
+            return std::pair<size_t, T>( i, state_value( s, Tag()));
+        }
+
+        template <typename Tag>
+        inline size_t indexed_value( size_t i, shared_state<void> &s, Tag ) {
+            state_value( s, Tag());
+
+            return i;
+        }
+
+        template <typename Tag, typename T>
+        ThenableFuture<typename any_value<T>::type> any_vector( std::vector<std::shared_ptr<shared_state<T>>> &&states ) {
+            typedef typename any_value<T>::type R;
+
+            for( auto &s : states ) {
+                check_state( s );
+            }
+
+            auto join   = make_state<any_join<R>>();
+            auto result = join->result;
+
+            if( states.empty()) {
+                result->set_exception( std::make_exception_ptr( std::future_error( std::future_errc::broken_promise )));
+            }
+
+            for( size_t i = 0; i < states.size(); ++i ) {
+                std::weak_ptr<shared_state<T>> weak = states[i];
+
+                attach_continuation( states[i], make_continuation( [join, weak, i]() THENABLE_NOEXCEPT {
+                    auto s = weak.lock();
+
+                    if( s ) {
+                        if( auto won = join->claim()) {
+                            fulfill( won, [&s, i] {
+                                return indexed_value( i, *s, Tag());
+                            } );
+                        }
+                    }
+                } ));
+            }
+
+            return state_access::make_future( std::move( result ));
+        }
+
+#ifdef THENABLE_HAS_CXX17
+        template <typename T>
+        struct any_alternative {
+            typedef T type;
+        };
+
+        template <>
+        struct any_alternative<void> {
+            typedef std::monostate type;
+        };
+
+        template <size_t i, typename R, typename T, typename Tag>
+        inline R variant_value( shared_state<T> &s, Tag ) {
+            return R( std::in_place_index<i>, state_value( s, Tag()));
+        }
+
+        template <size_t i, typename R, typename Tag>
+        inline R variant_value( shared_state<void> &s, Tag ) {
+            state_value( s, Tag());
+
+            return R( std::in_place_index<i> );
+        }
+
+        template <typename Tag, typename... Results, std::size_t... S>
+        ThenableFuture<std::variant<typename any_alternative<Results>::type...>> any_tuple( std::tuple<std::shared_ptr<shared_state<Results>>...> &&states,
+                                                                                            std::index_sequence<S...> ) {
+            typedef std::variant<typename any_alternative<Results>::type...> R;
+
+            static_assert( sizeof...( Results ) > 0, "when_any requires at least one future" );
+
+            int checked[] = { 0, ( check_state( std::get<S>( states )), 0 )... };
+
+            auto join   = make_state<any_join<R>>();
+            auto result = join->result;
+
+            int attached[] = { 0, ( attach_continuation( std::get<S>( states ), make_continuation(
+                    [join, weak = std::weak_ptr<shared_state<Results>>( std::get<S>( states ))]() THENABLE_NOEXCEPT {
+                        auto s = weak.lock();
+
+                        if( s ) {
+                            if( auto won = join->claim()) {
+                                fulfill( won, [&s] {
+                                    return variant_value<S, R>( *s, Tag());
+                                } );
+                            }
+                        }
+                    } )), 0 )... };
+
+            (void)checked;
+            (void)attached;
+
+            return state_access::make_future( std::move( result ));
+        }
+#endif
+    }
+
     /*
-     * then function with detached launch flag.
+     * when_any function
      *
-     * These are the same as the normal then functions, but launch the future resolution in a new thread
-     * to immediately wait on them and execute the callbacks. That way the future destructors don't block the main thread.
+     * Resolves with whichever future resolves first, value or exception. For vectors that's the index of the future paired
+     * with its value, or just the index for void futures. For tuples it's a std::variant holding the value at the index
+     * of the future, with std::monostate standing in for void, which needs C++17.
+     *
+     * The rest of the futures are left alone, and their results are dropped once they resolve.
      * */
 
-    /*
-     * Overload for simple futures
-     * */
-    template <typename T, typename Functor>
-    std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &&s, Functor &&f, then_launch policy ) {
-        //I don't really like having to do this, but I don't feel like rewriting almost all the recursive template logic above
-        typedef implicit_result_of<Functor, std::future<T>> P;
+    template <typename T>
+    inline ThenableFuture<typename detail::any_value<T>::type> when_any( std::vector<ThenableFuture<T>> &&futures ) {
+        return detail::any_vector<detail::take_tag>( detail::vector_states( std::move( futures )));
+    }
+
+    template <typename T>
+    inline ThenableFuture<typename detail::any_value<T>::type> when_any( std::vector<ThenableSharedFuture<T>> &&futures ) {
+        return detail::any_vector<detail::peek_tag>( detail::vector_states( std::move( futures )));
+    }
+
+#ifdef THENABLE_HAS_CXX17
+
+    template <typename... Results>
+    inline ThenableFuture<std::variant<typename detail::any_alternative<Results>::type...>> when_any( std::tuple<ThenableFuture<Results>...> &&futures ) {
+        return detail::any_tuple<detail::take_tag>( detail::tuple_states( std::move( futures ), std::index_sequence_for<Results...>()),
+                                                    std::index_sequence_for<Results...>());
+    }
+
+    template <typename... Results>
+    inline ThenableFuture<std::variant<typename detail::any_alternative<Results>::type...>> when_any( std::tuple<ThenableSharedFuture<Results>...> &&futures ) {
+        return detail::any_tuple<detail::peek_tag>( detail::tuple_states( std::move( futures ), std::index_sequence_for<Results...>()),
+                                                    std::index_sequence_for<Results...>());
+    }
+
+#endif
 
-        assert( policy == then_launch::detached );
+    //////////
 
+    namespace detail {
         /*
-         * A shared pointer is used to keep the shared state of the future alive in both threads until it's resolved
+         * some_join structure
+         *
+         * Collects results for when_some until enough have succeeded, every future has resolved, or the deadline passes,
+         * whichever comes first. Unlike when_any, every result up to that point is kept, so this is guarded by a mutex.
          * */
+        template <typename T>
+        struct some_join {
+            typedef typename any_value<T>::type value_type;
+            typedef std::vector<value_type>     R;
+
+            std::mutex                       mtx;
+            bool                             done;
+            const size_t                     k;
+            size_t                           pending;
+            std::exception_ptr               error;
+            R                                values;
+            std::shared_ptr<shared_state<R>> result;
+
+            inline some_join( size_t _k, size_t n ) : done( false ), k( _k ), pending( n ), result( make_state<shared_state<R>>()) {
+                values.reserve( std::min( k, n ));
+            }
 
-        auto p = std::make_shared<std::promise<P>>();
+            /*
+             * If nothing succeeded and every future failed, the first exception is forwarded rather than resolving with nothing.
+             * */
+            inline void finish( std::unique_lock<std::mutex> &lock ) THENABLE_NOEXCEPT {
+                done = true;
 
-        std::thread( [p]( std::future<T> &&s2, Functor &&f2 ) {
-            detail::detached_then_helper<P>::dispatch( *p, std::forward<std::future<T>>( s2 ), std::forward<Functor>( f2 ));
-        }, std::forward<std::future<T>>( s ), std::forward<Functor>( f )).detach();
+                auto s = std::move( result );
 
-        return p->get_future();
-    };
+                R                  v = std::move( values );
+                std::exception_ptr e = ( v.empty() && pending == 0 ) ? error : nullptr;
 
-    /*
-     * Overload for futures by references. It will take ownership and move the future,
-     * calling the above overload.
-     * */
-    template <typename T, typename Functor>
-    inline std::future<implicit_result_of<Functor, std::future<T>>> then( std::future<T> &s, Functor &&f, then_launch policy ) {
-        return then( std::move( s ), std::forward<Functor>( f ), policy );
-    };
+                lock.unlock();
+
+                if( e ) {
+                    s->set_exception( e );
+
+                } else {
+                    s->set_value( std::move( v ));
+                }
+            }
+
+            template <typename Tag>
+            inline void arrive( size_t i, shared_state<T> &s, Tag ) THENABLE_NOEXCEPT {
+                std::unique_lock<std::mutex> lock( mtx );
+
+                --pending;
+
+                if( done ) {
+                    return;
+                }
+
+                try {
+                    values.push_back( indexed_value( i, s, Tag()));
+
+                } catch( ... ) {
+                    if( !error ) {
+                        error = std::current_exception();
+                    }
+                }
+
+                if( values.size() >= k || pending == 0 ) {
+                    finish( lock );
+                }
+            }
+
+            inline void expire() THENABLE_NOEXCEPT {
+                std::unique_lock<std::mutex> lock( mtx );
+
+                if( !done ) {
+                    finish( lock );
+                }
+            }
+        };
+
+        /*
+         * The deadline is handed to the timer queue, which only holds the join weakly so it doesn't outlive the futures.
+         * Expiring it is passed on to a thread of its own, since it resolves the result and runs whatever is attached to it.
+         * */
+        template <typename Tag, typename T>
+        ThenableFuture<std::vector<typename any_value<T>::type>> some_vector( size_t k, std::vector<std::shared_ptr<shared_state<T>>> &&states,
+                                                                              std::chrono::steady_clock::time_point deadline ) {
+            for( auto &s : states ) {
+                check_state( s );
+            }
+
+            auto join   = make_state<some_join<T>>( k, states.size());
+            auto result = join->result;
+
+            if( k == 0 || states.empty()) {
+                std::unique_lock<std::mutex> lock( join->mtx );
+
+                join->finish( lock );
+
+            } else if( deadline != std::chrono::steady_clock::time_point::max()) {
+                std::weak_ptr<some_join<T>> weak = join;
+
+                timer_queue::instance().schedule( deadline, unique_task( [weak]() THENABLE_NOEXCEPT {
+                    if( !weak.expired()) {
+                        try {
+                            spawn_detached( [weak]() THENABLE_NOEXCEPT {
+                                if( auto join2 = weak.lock()) {
+                                    join2->expire();
+                                }
+                            } );
+
+                        } catch( ... ) {
+                            if( auto join2 = weak.lock()) {
+                                join2->expire();
+                            }
+                        }
+                    }
+                } ));
+            }
+
+            for( size_t i = 0; i < states.size(); ++i ) {
+                std::weak_ptr<shared_state<T>> weak = states[i];
+
+                attach_continuation( states[i], make_continuation( [join, weak, i]() THENABLE_NOEXCEPT {
+                    if( auto s = weak.lock()) {
+                        join->arrive( i, *s, Tag());
+                    }
+                } ));
+            }
+
+            return state_access::make_future( std::move( result ));
+        }
+
+        template <typename Clock, typename Duration>
+        inline std::chrono::steady_clock::time_point steady_deadline( const std::chrono::time_point<Clock, Duration> &deadline ) {
+            return std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>( deadline - Clock::now());
+        }
+
+        inline std::chrono::steady_clock::time_point steady_deadline( const std::chrono::steady_clock::time_point &deadline ) {
+            return deadline;
+        }
+    }
 
     /*
-     * Overload for shared_futures, passed by value because they can be copied.
-     * It's similar to the first overload, but can capture the shared_future in the lambda.
+     * when_some function
+     *
+     * Resolves once k of the futures have succeeded, with the index and value of each in the order they arrived.
+     * If every future resolves before then, or the deadline passes first, it resolves with whatever has arrived so far.
+     * Futures that fail are skipped, unless all of them fail, in which case the first exception is forwarded instead.
+     *
+     * No thread waits on any of the futures, and deadlines are tracked by a single timer thread shared by every call.
      * */
-    template <typename T, typename Functor>
-    inline std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T> &&s, Functor &&f, then_launch policy ) {
-        //I don't really like having to do this, but I don't feel like rewriting almost all the recursive template logic above
-        typedef implicit_result_of<Functor, std::shared_future<T>> P;
 
-        assert( policy == then_launch::detached );
+    template <typename T>
+    inline ThenableFuture<std::vector<typename detail::any_value<T>::type>> when_some( size_t k, std::vector<ThenableFuture<T>> &&futures ) {
+        return detail::some_vector<detail::take_tag>( k, detail::vector_states( std::move( futures )), std::chrono::steady_clock::time_point::max());
+    }
+
+    template <typename T>
+    inline ThenableFuture<std::vector<typename detail::any_value<T>::type>> when_some( size_t k, std::vector<ThenableSharedFuture<T>> &&futures ) {
+        return detail::some_vector<detail::peek_tag>( k, detail::vector_states( std::move( futures )), std::chrono::steady_clock::time_point::max());
+    }
+
+    template <typename T, typename Clock, typename Duration>
+    inline ThenableFuture<std::vector<typename detail::any_value<T>::type>> when_some( size_t k, std::vector<ThenableFuture<T>> &&futures,
+                                                                                       const std::chrono::time_point<Clock, Duration> &deadline ) {
+        return detail::some_vector<detail::take_tag>( k, detail::vector_states( std::move( futures )), detail::steady_deadline( deadline ));
+    }
+
+    template <typename T, typename Clock, typename Duration>
+    inline ThenableFuture<std::vector<typename detail::any_value<T>::type>> when_some( size_t k, std::vector<ThenableSharedFuture<T>> &&futures,
+                                                                                       const std::chrono::time_point<Clock, Duration> &deadline ) {
+        return detail::some_vector<detail::peek_tag>( k, detail::vector_states( std::move( futures )), detail::steady_deadline( deadline ));
+    }
 
+    namespace detail {
         /*
-         * A shared pointer is used to keep the shared state of the future alive in both threads until it's resolved
+         * These are very similar to the detached_then_helper helper structures, exception it bypasses the then_helper::dispatch part since this doesn't have to wait
+         * on a future. It just invokes it with a value using then_invoke_helper, and sets the promise to the result
          * */
+        template <typename T>
+        struct detached_waterfall_helper {
+            template <typename Functor>
+            static inline void dispatch( std::promise<T> &p, Functor &&f ) {
+                try {
+                    p.set_value( then_invoke_helper<Functor>::invoke( std::forward<Functor>( f )));
 
-        auto p = std::make_shared<std::promise<P>>();
+                } catch( ... ) {
+                    p.set_exception( std::current_exception());
+                }
+            }
+        };
 
-        std::thread( [p]( std::shared_future<T> &&s2, Functor &&f2 ) {
-            detail::detached_then_helper<P>::dispatch( *p, std::forward<std::shared_future<T>>( s2 ), std::forward<Functor>( f2 ));
-        }, std::forward<std::shared_future<T>>( s ), std::forward<Functor>( f )).detach();
+        template <>
+        struct detached_waterfall_helper<void> {
+            template <typename Functor>
+            static inline void dispatch( std::promise<void> &p, Functor &&f ) {
+                try {
+                    then_invoke_helper<Functor>::invoke( std::forward<Functor>( f ));
 
-        return p->get_future();
-    };
+                    p.set_value();
+
+                } catch( ... ) {
+                    p.set_exception( std::current_exception());
+                }
+            }
+        };
+    }
 
-    template <typename T, typename Functor>
-    inline std::future<implicit_result_of<Functor, std::shared_future<T>>> then( std::shared_future<T> s, Functor &&f, then_launch policy ) {
-        return then( std::move( s ), std::forward<Functor>( f ), policy );
-    };
 
     /*
-     * Overload for promise references. The promise is NOT moved, but rather the future is acquired
-     * from it and the promise is left intact, so it can be used elsewhere.
+     * So because of the nature of variadic templates, the actual waterfall implementation needed to be in reverse.
+     * It goes from the last functor to first
      * */
-    template <typename T, typename Functor>
-    inline std::future<implicit_result_of<Functor, std::future<T>>> then( std::promise<T> &s, Functor &&f, then_launch policy ) {
-        return then( s.get_future(), std::forward<Functor>( f ), policy );
-    };
+    template <typename Functor>
+    inline THENABLE_DECLTYPE_AUTO_HINTED( std::future ) reverse_waterfall( std::launch policy, Functor &&f ) {
+        return std::async( policy, []( Functor &&f2 ) {
+            return detail::then_invoke_helper<Functor>::invoke( std::forward<Functor>( f2 ));
+        }, std::forward<Functor>( f ));
+    }
+
+    template <typename Functor>
+    THENABLE_DECLTYPE_AUTO_HINTED( std::future ) reverse_waterfall( then_launch policy, Functor &&f ) {
+        typedef decltype( detail::then_invoke_helper<Functor>::invoke( std::forward<Functor>( f ))) P;
+
+        std::promise<P> p      = detail::make_std_promise<P>();
+        std::future<P>  result = p.get_future();
+
+        if( policy == then_launch::immediate ) {
+            detail::detached_waterfall_helper<P>::dispatch( p, std::forward<Functor>( f ));
+
+        } else {
+            detail::spawn_detached( [p2 = std::move( p ), f2 = std::forward<Functor>( f )]() mutable {
+                detail::detached_waterfall_helper<P>::dispatch( p2, std::forward<Functor>( f2 ));
+            } );
+        }
 
-    //////////
+        return result;
+    }
+
+    template <typename Executor, typename Functor>
+    inline typename std::enable_if<detail::is_executor<Executor>::value, ThenableFuture<recursive_result_of<Functor>>>::type
+    reverse_waterfall( Executor &executor, Functor &&f ) {
+        return detail::launch_state<recursive_result_of<Functor>>( detail::executor_ref<Executor>( executor ), std::forward<Functor>( f ));
+    }
 
     /*
-     * then2 is a variation of then that returns a ThenableFuture instead of a normal future
+     * The policy is forwarded so executors are passed along by reference
      * */
-    template <typename FutureType, typename Functor, typename LaunchPolicy>
-    inline ThenableFuture<implicit_result_of<Functor, FutureType>> then2( FutureType &&s, Functor &&f, LaunchPolicy policy ) {
-        return to_thenable( then( std::forward<FutureType>( s ), std::forward<Functor>( f ), policy ));
+    template <typename PolicyType, typename Functor, typename... Functors>
+    inline THENABLE_DECLTYPE_AUTO_HINTED( std::future ) reverse_waterfall( PolicyType &&policy, Functor &&f, Functors &&... fns ) {
+        return then( reverse_waterfall( policy, std::forward<Functors>( fns )... ), std::forward<Functor>( f ), policy );
     }
 
-    template <typename FutureType, typename Functor, typename LaunchPolicy>
-    inline ThenableFuture<implicit_result_of<Functor, FutureType>> then2( FutureType &s, Functor &&f, LaunchPolicy policy ) {
-        return to_thenable( then( s, std::forward<Functor>( f ), policy ));
-    }
 
-    //////////
+    namespace detail {
+        /*
+         * Found this solution at http://stackoverflow.com/a/15907838
+         *
+         * It applies variadic templates to a function in reverse by recursively calling itself with the template parameters shifted over
+         * */
 
-    template <typename T>
-    class ThenablePromise : public std::promise<T> {
-        public:
-            inline ThenablePromise() : std::promise<T>() {}
+        template <typename... Head>
+        struct forward_waterfall;
+
+        template <>
+        struct forward_waterfall<> {
+            template <typename... Rest>
+            static inline decltype( auto ) apply( Rest &&... rest ) {
+                return reverse_waterfall( std::forward<Rest>( rest )... );
+            }
+        };
 
-            inline ThenablePromise( std::promise<T> &&p ) : std::promise<T>( std::forward<std::promise<T>>( p )) {}
+        template <typename First, typename... Head>
+        struct forward_waterfall<First, Head...> {
+            template <typename... Rest>
+            static inline decltype( auto ) apply( First &&first, Head &&... head, Rest &&... rest ) {
+                return forward_waterfall<Head...>::apply( std::forward<Head>( head )..., std::forward<First>( first ), std::forward<Rest>( rest )... );
+            }
+        };
+    }
 
-            inline ThenablePromise( ThenablePromise &&p ) : std::promise<T>( std::forward<std::promise<T>>( p )) {}
 
-            ThenablePromise( const ThenablePromise & ) = delete;
+    /*
+     * Actual waterfall implementations that just forward the policy and functors through the forward_waterfall
+     * which reverses them and calls reverse_waterfall
+     * */
 
-            ThenablePromise &operator=( const ThenablePromise & ) = delete;
+    template <typename... Functors>
+    inline THENABLE_DECLTYPE_AUTO_HINTED( std::future ) waterfall( std::launch policy, Functors &&... fns ) {
+        return detail::forward_waterfall<Functors..., std::launch>::apply( std::forward<Functors>( fns )..., std::forward<std::launch>( policy ));
+    }
 
-            constexpr operator std::promise<T> &() THENABLE_NOEXCEPT {
-                return *static_cast<std::promise<T> *>(this);
-            }
+    template <typename... Functors>
+    inline THENABLE_DECLTYPE_AUTO_HINTED( std::future ) waterfall( then_launch policy, Functors &&... fns ) {
+        return detail::forward_waterfall<Functors..., then_launch>::apply( std::forward<Functors>( fns )..., std::forward<then_launch>( policy ));
+    }
 
-            constexpr operator std::promise<T> &&() THENABLE_NOEXCEPT {
-                return std::move( *static_cast<std::promise<T> *>(this));
-            }
+    template <typename Executor, typename... Functors, typename = typename std::enable_if<detail::is_executor<Executor>::value>::type>
+    inline THENABLE_DECLTYPE_AUTO_HINTED( ThenableFuture ) waterfall( Executor &executor, Functors &&... fns ) {
+        return detail::forward_waterfall<Functors..., Executor &>::apply( std::forward<Functors>( fns )..., executor );
+    }
 
-            inline ThenableFuture<T> get_thenable_future() {
-                return this->get_future(); //Automatically converts it
-            }
+    template <typename... Functors>
+    inline THENABLE_DECLTYPE_AUTO_HINTED( std::future ) waterfall( Functors &&... fns ) {
+        return waterfall( default_policy, std::forward<Functors>( fns )... );
+    }
 
-            template <typename Functor, typename LaunchPolicy = std::launch>
-            inline ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( Functor &&f, LaunchPolicy policy = default_policy ) {
-                return then2( this->get_future(), std::forward<Functor>( f ), policy );
-            }
+    template <typename... Args>
+    inline THENABLE_DECLTYPE_AUTO_HINTED( std::future ) waterfall2( Args &&... args ) {
+        return to_thenable( waterfall( std::forward<Args>( args )... ));
     };
 
-    /*
-     * This is a future object functionally equivalent to std::future,
-     * but with a .then function to chain together many futures.
-     * */
+#ifdef THENABLE_HAS_COROUTINES
 
     template <typename T>
-    class ThenableFuture : public std::future<T> {
-        public:
-            constexpr ThenableFuture() THENABLE_NOEXCEPT : std::future<T>() {}
+    class task;
 
-            inline ThenableFuture( std::future<T> &&f ) THENABLE_NOEXCEPT : std::future<T>( std::forward<std::future<T>>( f )) {}
+    namespace detail {
+        /*
+         * future_awaiter structure
+         *
+         * Suspends a coroutine until a future is resolved by attaching a continuation to its state, so no thread is blocked waiting on it.
+         * The coroutine is resumed on whichever thread resolves the future.
+         *
+         * The continuation and await_suspend race to set arrived, and whichever is second resumes the coroutine. If the state was
+         * resolved before the coroutine finished suspending, that's await_suspend, which simply doesn't suspend.
+         * */
+        template <typename Future>
+        struct future_awaiter {
+            Future            f;
+            std::atomic<bool> arrived{ false };
 
-            inline ThenableFuture( ThenableFuture &&f ) THENABLE_NOEXCEPT : std::future<T>( std::forward<std::future<T>>( f )) {}
+            template <typename F>
+            inline explicit future_awaiter( F &&_f ) : f( std::forward<F>( _f )) {}
 
-            ThenableFuture( const ThenableFuture & ) = delete;
+            inline bool await_ready() const {
+                return f.is_ready();
+            }
 
-            ThenableFuture &operator=( const ThenableFuture & ) = delete;
+            inline bool await_suspend( std::coroutine_handle<> h ) {
+                attach_continuation( state_access::get( f ), make_continuation( [this, h]() THENABLE_NOEXCEPT {
+                    if( arrived.exchange( true, std::memory_order_acq_rel )) {
+                        h.resume();
+                    }
+                } ));
 
-            constexpr operator std::future<T> &() {
-                return *static_cast<std::future<T> *>(this);
+                return !arrived.exchange( true, std::memory_order_acq_rel );
             }
 
-            constexpr operator std::future<T> &&() {
-                return std::move( *static_cast<std::future<T> *>(this));
+            inline decltype( auto ) await_resume() {
+                return f.get();
             }
+        };
 
-            template <typename Functor, typename LaunchPolicy = std::launch>
-            inline ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( Functor &&f, LaunchPolicy policy = default_policy ) {
-                return then2( std::move( *this ), std::forward<Functor>( f ), policy );
+        /*
+         * Coroutine frames come from the recycling pool like everything else
+         * */
+        struct pooled_frame {
+            static inline void *operator new( size_t size ) {
+                return pool_allocate( size, alignof( std::max_align_t ));
             }
 
-            inline ThenableSharedFuture<T> share_thenable() {
-                return ThenableSharedFuture<T>( this->share());
+            static inline void operator delete( void *p, size_t size ) THENABLE_NOEXCEPT {
+                pool_deallocate( p, size, alignof( std::max_align_t ));
             }
-    };
+        };
 
-    template <typename T>
-    class ThenableSharedFuture : public std::shared_future<T> {
-        public:
-            constexpr ThenableSharedFuture() THENABLE_NOEXCEPT : std::shared_future<T>() {}
+        /*
+         * task_promise structure
+         *
+         * The promise type of task. The result is kept in the coroutine frame until it reaches its final suspension point.
+         *
+         * When the task is awaited by another coroutine, that one is resumed directly and takes the result out of the frame itself.
+         * Otherwise, the frame is destroyed before the result is moved into the shared state, so anything resumed by that
+         * can't run into a coroutine that hasn't finished yet.
+         * */
+        template <typename T>
+        struct task_promise_base : pooled_frame {
+            ready_value<T>                   result;
+            std::shared_ptr<shared_state<T>> state;
+            std::coroutine_handle<>          awaiting;
+
+            struct final_awaiter {
+                inline bool await_ready() const THENABLE_NOEXCEPT {
+                    return false;
+                }
 
-            inline ThenableSharedFuture( const std::shared_future<T> &f ) THENABLE_NOEXCEPT : std::shared_future<T>( f ) {}
+                template <typename Promise>
+                inline std::coroutine_handle<> await_suspend( std::coroutine_handle<Promise> h ) THENABLE_NOEXCEPT {
+                    if( h.promise().awaiting ) {
+                        return h.promise().awaiting;
+                    }
 
-            inline ThenableSharedFuture( const ThenableSharedFuture &f ) THENABLE_NOEXCEPT : std::shared_future<T>( f ) {}
+                    auto           s = std::move( h.promise().state );
+                    ready_value<T> r( std::move( h.promise().result ));
 
-            inline ThenableSharedFuture( std::future<T> &&f ) THENABLE_NOEXCEPT : std::shared_future<T>( std::forward<std::shared_future<T>>( f )) {}
+                    h.destroy();
 
-            inline ThenableSharedFuture( ThenableFuture<T> &&f ) THENABLE_NOEXCEPT : std::shared_future<T>( std::forward<std::shared_future<T>>( f )) {}
+                    try {
+                        r.store( *s );
 
-            inline ThenableSharedFuture( std::shared_future<T> &&f ) THENABLE_NOEXCEPT : std::shared_future<T>( std::forward<std::shared_future<T>>( f )) {}
+                    } catch( ... ) {
+                        s->set_exception( std::current_exception());
+                    }
 
-            inline ThenableSharedFuture( ThenableSharedFuture &&f ) THENABLE_NOEXCEPT : std::shared_future<T>( std::forward<std::shared_future<T>>( f )) {}
+                    return std::noop_coroutine();
+                }
 
-            constexpr operator std::shared_future<T> &() {
-                return *static_cast<std::shared_future<T> *>(this);
-            }
+                inline void await_resume() const THENABLE_NOEXCEPT {}
+            };
 
-            constexpr operator std::shared_future<T> &&() {
-                return std::move( *static_cast<std::shared_future<T> *>(this));
+            inline std::suspend_always initial_suspend() const THENABLE_NOEXCEPT {
+                return {};
             }
 
-            template <typename Functor, typename LaunchPolicy = std::launch>
-            inline ThenableFuture<implicit_result_of<Functor, std::shared_future<T>>> then( Functor &&f, LaunchPolicy policy = default_policy ) {
-                return then2( *this, std::forward<Functor>( f ), policy );
+            inline final_awaiter final_suspend() const THENABLE_NOEXCEPT {
+                return {};
             }
-    };
-
-    //////////
 
-    namespace detail {
-        template <typename T>
-        inline typename recursive_get_future_type<T>::type recursive_get( ThenableFuture<T> &&t ) {
-            return recursive_get( t.get());
+            inline void unhandled_exception() THENABLE_NOEXCEPT {
+                result.set_exception( std::current_exception());
+            }
         };
 
         template <typename T>
-        inline typename recursive_get_future_type<T>::type recursive_get( ThenableSharedFuture<T> &&t ) {
-            return recursive_get( t.get());
-        };
+        struct task_promise : task_promise_base<T> {
+            inline task<T> get_return_object() THENABLE_NOEXCEPT {
+                return task<T>( std::coroutine_handle<task_promise>::from_promise( *this ));
+            }
 
-        template <>
-        inline typename recursive_get_future_type<void>::type recursive_get<void>( ThenableFuture<void> &&t ) {
-            t.get();
+            template <typename U>
+            inline void return_value( U &&value ) {
+                this->result.set_value( std::forward<U>( value ));
+            }
         };
 
         template <>
-        inline typename recursive_get_future_type<void>::type recursive_get<void>( ThenableSharedFuture<void> &&t ) {
-            t.get();
+        struct task_promise<void> : task_promise_base<void> {
+            inline task<void> get_return_object() THENABLE_NOEXCEPT;
+
+            inline void return_void() THENABLE_NOEXCEPT {
+                this->result.set_value();
+            }
         };
 
+        /*
+         * task_awaiter structure
+         *
+         * Starts an awaited task by transferring straight to it, and it transfers straight back once it's done,
+         * so awaiting a task needs neither a shared state nor any more stack however deeply tasks await each other.
+         * */
         template <typename T>
-        inline typename recursive_get_future_type<T>::type recursive_get( ThenablePromise<T> &&t ) {
-            return recursive_get( t.get_future());
-        };
-    }
+        struct task_awaiter {
+            std::coroutine_handle<task_promise<T>> handle;
 
-    //////////
+            inline explicit task_awaiter( std::coroutine_handle<task_promise<T>> h ) THENABLE_NOEXCEPT : handle( h ) {}
 
-    /*
-     * These just convert future, shared_future and promise to their Thenable equivalent
-     * */
+            task_awaiter( const task_awaiter & ) = delete;
 
-    template <typename T>
-    constexpr ThenableFuture<T> to_thenable( std::future<T> &&t ) {
-        return ThenableFuture<T>( std::forward<std::future<T>>( t ));
-    }
+            inline ~task_awaiter() {
+                handle.destroy();
+            }
 
-    template <typename T>
-    constexpr ThenableSharedFuture<T> to_thenable( const std::shared_future<T> &t ) {
-        return ThenableSharedFuture<T>( t );
-    }
+            inline bool await_ready() const THENABLE_NOEXCEPT {
+                return false;
+            }
 
-    template <typename T>
-    constexpr ThenableSharedFuture<T> to_thenable( std::shared_future<T> &&t ) {
-        return ThenableSharedFuture<T>( std::forward<std::shared_future<T>>( t ));
-    }
+            inline std::coroutine_handle<> await_suspend( std::coroutine_handle<> h ) THENABLE_NOEXCEPT {
+                handle.promise().awaiting = h;
 
-    template <typename T>
-    constexpr ThenablePromise<T> to_thenable( std::promise<T> &&t ) {
-        return ThenablePromise<T>( std::forward<std::promise<T>>( t ));
+                return handle;
+            }
+
+            inline decltype( auto ) await_resume() {
+                return handle.promise().result.take();
+            }
+        };
     }
 
-    //////////
+    /*
+     * Awaiting a ThenableFuture consumes it just like get() does, while awaiting a ThenableSharedFuture gives a reference to its value.
+     *
+     * Awaiting a ThenablePromise awaits the future it was going to give out, so get_future can't be called on it afterwards.
+     * */
 
     template <typename T>
-    constexpr ThenableFuture<T> to_thenable( ThenableFuture<T> &&t ) {
-        return std::forward<ThenableFuture<T>>( t );
+    inline detail::future_awaiter<ThenableFuture<T> &> operator co_await( ThenableFuture<T> &f ) {
+        return detail::future_awaiter<ThenableFuture<T> &>( f );
     }
 
     template <typename T>
-    constexpr ThenableSharedFuture<T> to_thenable( const ThenableSharedFuture<T> &t ) {
-        return std::forward<ThenableSharedFuture<T>>( t );
+    inline detail::future_awaiter<ThenableFuture<T> &> operator co_await( ThenableFuture<T> &&f ) {
+        return detail::future_awaiter<ThenableFuture<T> &>( f );
     }
 
     template <typename T>
-    constexpr ThenableSharedFuture<T> to_thenable( ThenableSharedFuture<T> &&t ) {
-        return std::forward<ThenableSharedFuture<T>>( t );
+    inline detail::future_awaiter<const ThenableSharedFuture<T> &> operator co_await( const ThenableSharedFuture<T> &f ) {
+        return detail::future_awaiter<const ThenableSharedFuture<T> &>( f );
     }
 
     template <typename T>
-    constexpr ThenablePromise<T> to_thenable( ThenablePromise<T> &&t ) {
-        return std::forward<ThenablePromise<T>>( t );
-    }
-
-    //////////
-
-    template <typename... Results>
-    constexpr std::tuple<ThenableFuture<Results>...> to_thenable( std::tuple<std::future<Results>...> &&futures ) {
-        return std::tuple<ThenableFuture<Results>...>( std::forward<std::tuple<std::future<Results>...>>( futures ));
-    }
-
-    template <typename... Results>
-    constexpr std::tuple<ThenableSharedFuture<Results>...> to_thenable( std::tuple<std::shared_future<Results>...> &&futures ) {
-        return std::tuple<ThenableSharedFuture<Results>...>( std::forward<std::tuple<std::shared_future<Results>...>>( futures ));
-    }
-
-    template <typename... Results>
-    constexpr std::tuple<ThenablePromise<Results>...> to_thenable( std::tuple<std::promise<Results>...> &&promises ) {
-        return std::tuple<ThenablePromise<Results>...>( std::forward<std::tuple<std::promise<Results>...>>( promises ));
-    }
-
-    //////////
-
-    template <typename... Results>
-    constexpr std::tuple<ThenableFuture<Results>...> to_thenable( std::tuple<ThenableFuture<Results>...> &&futures ) {
-        return std::forward<std::tuple<ThenableFuture<Results>...>>( futures );
-    }
-
-    template <typename... Results>
-    constexpr std::tuple<ThenableSharedFuture<Results>...> to_thenable( std::tuple<ThenableSharedFuture<Results>...> &&futures ) {
-        return std::forward<std::tuple<ThenableSharedFuture<Results>...>>( futures );
-    }
-
-    template <typename... Results>
-    constexpr std::tuple<ThenablePromise<Results>...> to_thenable( std::tuple<ThenablePromise<Results>...> &&promises ) {
-        return std::forward<std::tuple<ThenablePromise<Results>...>>( promises );
+    inline detail::future_awaiter<ThenableFuture<T>> operator co_await( ThenablePromise<T> &p ) {
+        return detail::future_awaiter<ThenableFuture<T>>( p.get_future());
     }
 
-    //////////
-
-    template <typename T, typename Functor, typename LaunchPolicy>
-    std::future<T> make_promise( Functor &&f, LaunchPolicy policy ) {
-        auto p = std::make_shared<std::promise<T>>();
-
-        return then( defer( [p]( Functor &&f2 ) THENABLE_NOEXCEPT {
-            detail::make_promise_helper<T>::dispatch( std::forward<Functor>( f2 ), p );
-
-        }, std::forward<Functor>( f )), [p] {
-            return p->get_future();
-
-        }, policy );
-    }
-
-    template <typename T, typename Functor, typename LaunchPolicy>
-    ThenableFuture<T> make_promise2( Functor &&f, LaunchPolicy policy ) {
-        auto p = std::make_shared<std::promise<T>>();
-
-        return then2( defer( [p]( Functor &&f2 ) THENABLE_NOEXCEPT {
-            detail::make_promise_helper<T>::dispatch( std::forward<Functor>( f2 ), p );
-
-        }, std::forward<Functor>( f )), [p] {
-            return p->get_future();
+    /*
+     * task class
+     *
+     * A coroutine return type that doesn't start running until it's either awaited by another coroutine or converted into
+     * a ThenableFuture, be that explicitly with start or by get or then. Once converted, the coroutine owns itself and
+     * cleans up after it finishes, so the task can go away while it's still suspended.
+     *
+     * A task that is destroyed without ever being started just destroys the coroutine.
+     * */
+    template <typename T>
+    class task {
+            friend struct detail::task_promise<T>;
 
-        }, policy );
-    }
+            template <typename U>
+            friend detail::task_awaiter<U> operator co_await( task<U> && );
 
-    //////////
+            std::coroutine_handle<detail::task_promise<T>> handle;
 
-    namespace detail {
-        template <typename... Functors>
-        using promise_tuple = std::tuple<std::promise<typename recursive_get_future_type<fn_traits::fn_result_of<Functors>>::type>...>;
+            inline explicit task( std::coroutine_handle<detail::task_promise<T>> h ) THENABLE_NOEXCEPT : handle( h ) {}
 
-        template <typename... Functors>
-        using result_tuple = std::tuple<std::future<typename detail::recursive_get_future_type<fn_traits::fn_result_of<Functors>>::type>...>;
+        public:
+            typedef detail::task_promise<T> promise_type;
 
-        template <size_t i, typename... Functors>
-        constexpr typename std::enable_if<i == sizeof...( Functors )>::type
-        initialize_parallel_futures( result_tuple<Functors...> &, promise_tuple<Functors...> & ) {
-            //No-op
-        };
+            task() THENABLE_NOEXCEPT = default;
 
-        template <size_t i, typename... Functors>
-        inline typename std::enable_if<i < sizeof...( Functors )>::type
-        initialize_parallel_futures( result_tuple<Functors...> &result, promise_tuple<Functors...> &promises ) {
-            std::get<i>( result ) = std::get<i>( promises ).get_future();
+            inline task( task &&t ) THENABLE_NOEXCEPT : handle( std::exchange( t.handle, nullptr )) {}
 
-            initialize_parallel_futures<i + 1, Functors...>( result, promises );
-        };
+            task( const task & ) = delete;
 
-        template <typename Functor, typename R = fn_traits::fn_result_of<Functor>>
-        struct tagged_functor {
-            std::atomic_bool ran;
-            Functor          f;
+            task &operator=( const task & ) = delete;
 
-            inline tagged_functor( Functor &&_f ) : f( std::forward<Functor>( _f )) {}
+            inline task &operator=( task &&t ) THENABLE_NOEXCEPT {
+                task( std::move( t )).swap( *this );
 
-            inline void invoke( std::promise<typename recursive_get_future_type<fn_traits::fn_result_of<Functor>>::type> &p ) THENABLE_NOEXCEPT {
-                try {
-                    p.set_value( recursive_get( f()));
+                return *this;
+            }
 
-                } catch( ... ) {
-                    p.set_exception( std::current_exception());
+            inline ~task() {
+                if( handle ) {
+                    handle.destroy();
                 }
             }
-        };
 
-        template <typename Functor>
-        struct tagged_functor<Functor, void> {
-            std::atomic_bool ran;
-            Functor          f;
-
-            inline tagged_functor( Functor &&_f ) : f( std::forward<Functor>( _f )) {}
-
-            inline void invoke( std::promise<void> &p ) THENABLE_NOEXCEPT {
-                try {
-                    f();
+            inline void swap( task &other ) THENABLE_NOEXCEPT {
+                std::swap( handle, other.handle );
+            }
 
-                    p.set_value();
+            inline bool valid() const THENABLE_NOEXCEPT {
+                return static_cast<bool>( handle );
+            }
 
-                } catch( ... ) {
-                    p.set_exception( std::current_exception());
+            /*
+             * Runs the coroutine up to its first suspension point, and returns a future for its result
+             * */
+            inline ThenableFuture<T> start() && {
+                if( !handle ) {
+                    throw std::future_error( std::future_errc::no_state );
                 }
-            }
-        };
 
-        template <size_t i, typename... Functors>
-        constexpr typename std::enable_if<i == sizeof...( Functors )>::type
-        invoke_parallel_functors( promise_tuple<Functors...> &, std::tuple<tagged_functor<Functors>...> & ) THENABLE_NOEXCEPT {
-            //No-op
-        };
+                auto s = detail::make_state<detail::shared_state<T>>();
 
-        template <size_t i, typename... Functors>
-        inline typename std::enable_if<i < sizeof...( Functors )>::type
-        invoke_parallel_functors( promise_tuple<Functors...> &promises, std::tuple<tagged_functor<Functors>...> &fns ) THENABLE_NOEXCEPT {
-            bool expect_ran = false;
+                auto h = std::exchange( handle, nullptr );
 
-            auto &func = std::get<i>( fns );
+                h.promise().state = s;
 
-            func.ran.compare_exchange_strong( expect_ran, true );
+                h.resume();
 
-            if( !expect_ran ) {
-                func.invoke( std::get<i>( promises ));
+                return detail::state_access::make_future( std::move( s ));
             }
 
-            invoke_parallel_functors<i + 1, Functors...>( promises, fns );
-        };
+            inline operator ThenableFuture<T>() && {
+                return std::move( *this ).start();
+            }
 
-        template <typename K, typename T, std::size_t... S>
-        inline K get_tuple_futures( T &&t, std::index_sequence<S...> ) {
-            return K( recursive_get( std::get<S>( std::forward<T>( t )))... );
-        }
+            inline decltype( auto ) get() && {
+                return std::move( *this ).start().get();
+            }
+
+            template <typename Functor, typename LaunchPolicy = std::launch>
+            inline ThenableFuture<implicit_result_of<Functor, std::future<T>>> then( Functor &&f, LaunchPolicy &&policy = std::launch( default_policy )) && {
+                return std::move( *this ).start().then( std::forward<Functor>( f ), std::forward<LaunchPolicy>( policy ));
+            }
+    };
 
-        template <typename K, typename T, std::size_t... S>
-        inline K get_tuple_futures_from_promises( T &&t, std::index_sequence<S...> ) {
-            return K( recursive_get( std::get<S>( std::forward<T>( t )).get_future())... );
+    inline task<void> detail::task_promise<void>::get_return_object() THENABLE_NOEXCEPT {
+        return task<void>( std::coroutine_handle<task_promise>::from_promise( *this ));
+    }
+
+    template <typename T>
+    inline detail::task_awaiter<T> operator co_await( task<T> &&t ) {
+        if( !t.handle ) {
+            throw std::future_error( std::future_errc::no_state );
         }
+
+        return detail::task_awaiter<T>( std::exchange( t.handle, nullptr ));
     }
 
-    template <typename... Functors>
-    std::tuple<std::future<recursive_result_of<Functors>>...> parallel_n( size_t concurrency, Functors &&... fns ) {
-        static_assert( sizeof...( Functors ) > 0 );
-        assert( concurrency > 0 );
+    //////////
 
-        typedef detail::promise_tuple<Functors...>              promise_tuple;
-        typedef detail::result_tuple<Functors...>               result_tuple;
-        typedef std::tuple<detail::tagged_functor<Functors>...> tagged_functors;
+    template <typename T>
+    class async_generator;
 
-        result_tuple result;
+    namespace detail {
+        /*
+         * stream_state class
+         *
+         * The shared state behind an async_generator, a queue of values between one producer and one consumer.
+         *
+         * Up to depth values are buffered before the producer is made to wait. Pushing past that still buffers the value, but gives
+         * the producer a pending future which is resolved once the consumer has taken enough values for it to fit, so a producer
+         * that waits on those futures never has more than depth values outstanding.
+         *
+         * Consumers waiting on an empty queue are handed values directly. Futures are only resolved once the lock is released.
+         * */
+        template <typename T>
+        class stream_state {
+                typedef std::shared_ptr<shared_state<std::optional<T>>> reader_type;
+                typedef std::shared_ptr<shared_state<void>>             writer_type;
+
+                std::mutex                       mtx;
+                std::deque<T, pool_allocator<T>> buffer;
+                std::deque<reader_type>          readers;
+                std::deque<writer_type>          writers;
+                std::exception_ptr               error;
+                size_t                           depth;
+                bool                             closed    = false;
+                bool                             abandoned = false;
+
+                /*
+                 * The writers are waiting on the last values in the buffer, so the first one can go once the rest fit
+                 * */
+                inline writer_type admit() THENABLE_NOEXCEPT {
+                    writer_type w;
+
+                    if( !writers.empty() && buffer.size() - writers.size() < depth ) {
+                        w = std::move( writers.front());
+
+                        writers.pop_front();
+                    }
+
+                    return w;
+                }
 
-        auto p = std::make_shared<promise_tuple>();
-        auto f = std::make_shared<tagged_functors>( std::forward<Functors>( fns )... );
+            public:
+                inline explicit stream_state( size_t d ) : depth( d ? d : 1 ) {}
 
-        detail::initialize_parallel_futures<0, Functors...>( result, *p );
+                template <typename U>
+                inline ThenableFuture<void> push( U &&value ) {
+                    std::unique_lock<std::mutex> lock( mtx );
 
-        for( size_t i = 0, min_concurrency = std::min( concurrency, sizeof...( Functors )); i < min_concurrency; ++i ) {
-            std::thread( [p, f]() THENABLE_NOEXCEPT {
-                detail::invoke_parallel_functors<0, Functors...>( *p, *f );
-            } ).detach();
-        }
+                    if( closed ) {
+                        throw std::future_error( std::future_errc::promise_already_satisfied );
+                    }
 
-        return std::move( result );
-    }
+                    if( abandoned ) {
+                        return make_exceptional_future<void>( std::future_error( std::future_errc::broken_promise ));
+                    }
 
-    template <typename... Functors>
-    inline std::tuple<std::future<recursive_result_of<Functors>>...> parallel( Functors &&... fns ) {
-        return parallel_n( std::thread::hardware_concurrency(), std::forward<Functors>( fns )... );
-    }
+                    if( !readers.empty()) {
+                        reader_type r = std::move( readers.front());
 
-    template <typename... Functors>
-    inline std::tuple<ThenableFuture<recursive_result_of<Functors>>...> parallel2_n( size_t concurrency, Functors &&... fns ) {
-        //Implicit conversion to ThenableFuture
-        return parallel_n( concurrency, std::forward<Functors>( fns )... );
-    }
+                        readers.pop_front();
 
-    template <typename... Functors>
-    inline std::tuple<ThenableFuture<recursive_result_of<Functors>>...> parallel2( Functors &&... fns ) {
-        //Implicit conversion to ThenableFuture
-        return parallel( std::forward<Functors>( fns )... );
-    }
+                        lock.unlock();
 
-    //////////
+                        r->set_value( std::optional<T>( std::forward<U>( value )));
 
-    template <typename... Results>
-    std::future<std::tuple<Results...>> await_all( std::tuple<std::future<Results>...> &&results, std::launch policy = default_policy ) {
-        typedef std::tuple<std::future<Results>...> tuple_type;
-        constexpr auto                              Size = std::tuple_size<tuple_type>::value;
+                        return make_ready_future();
+                    }
 
-        return std::async( policy, []( tuple_type &&inner_results ) {
-            return detail::get_tuple_futures<std::tuple<Results...>>( std::forward<tuple_type>( inner_results ), std::make_index_sequence<Size>());
-        }, std::forward<tuple_type>( results ));
-    }
+                    buffer.emplace_back( std::forward<U>( value ));
 
-    template <typename... Results>
-    std::future<std::tuple<Results...>> await_all( std::tuple<std::shared_future<Results>...> &&results, std::launch policy = default_policy ) {
-        typedef std::tuple<std::shared_future<Results>...> tuple_type;
-        constexpr auto                                     Size = std::tuple_size<tuple_type>::value;
+                    if( buffer.size() <= depth ) {
+                        return make_ready_future();
+                    }
 
-        return std::async( policy, []( tuple_type &&inner_results ) {
-            return detail::get_tuple_futures<std::tuple<Results...>>( std::forward<tuple_type>( inner_results ), std::make_index_sequence<Size>());
-        }, std::forward<tuple_type>( results ));
-    }
+                    auto w = make_state<shared_state<void>>();
 
-    template <typename... Results>
-    ThenableFuture<std::tuple<Results...>> await_all( std::tuple<ThenableFuture<Results>...> &&results, std::launch policy = default_policy ) {
-        typedef std::tuple<ThenableFuture<Results>...> tuple_type;
-        constexpr auto                                 Size = std::tuple_size<tuple_type>::value;
+                    writers.push_back( w );
 
-        return std::async( policy, []( tuple_type &&inner_results ) {
-            return detail::get_tuple_futures<std::tuple<Results...>>( std::forward<tuple_type>( inner_results ), std::make_index_sequence<Size>());
-        }, std::forward<tuple_type>( results ));
-    }
+                    return state_access::make_future( std::move( w ));
+                }
 
-    template <typename... Results>
-    ThenableFuture<std::tuple<Results...>> await_all( std::tuple<ThenableSharedFuture<Results>...> &&results, std::launch policy = default_policy ) {
-        typedef std::tuple<ThenableSharedFuture<Results>...> tuple_type;
-        constexpr auto                                       Size = std::tuple_size<tuple_type>::value;
+                inline ThenableFuture<std::optional<T>> pop() {
+                    std::unique_lock<std::mutex> lock( mtx );
 
-        return std::async( policy, []( tuple_type &&inner_results ) {
-            return detail::get_tuple_futures<std::tuple<Results...>>( std::forward<tuple_type>( inner_results ), std::make_index_sequence<Size>());
-        }, std::forward<tuple_type>( results ));
-    }
+                    if( !buffer.empty()) {
+                        std::optional<T> value( std::move( buffer.front()));
 
-    template <typename... Results>
-    std::future<std::tuple<Results...>> await_all( std::tuple<std::promise<Results>...> &&results, std::launch policy = default_policy ) {
-        typedef std::tuple<ThenableSharedFuture<Results>...> tuple_type;
-        constexpr auto                                       Size = std::tuple_size<tuple_type>::value;
+                        buffer.pop_front();
 
-        return std::async( policy, []( tuple_type &&inner_results ) {
-            return detail::get_tuple_futures_from_promises<std::tuple<Results...>>( std::forward<tuple_type>( inner_results ), std::make_index_sequence<Size>());
-        }, std::forward<tuple_type>( results ));
-    }
+                        writer_type w = admit();
 
-    template <typename... Results>
-    ThenableFuture<std::tuple<Results...>> await_all( std::tuple<ThenablePromise<Results>...> &&results, std::launch policy = default_policy ) {
-        typedef std::tuple<ThenableSharedFuture<Results>...> tuple_type;
-        constexpr auto                                       Size = std::tuple_size<tuple_type>::value;
+                        lock.unlock();
 
-        return std::async( policy, []( tuple_type &&inner_results ) {
-            return detail::get_tuple_futures_from_promises<std::tuple<Results...>>( std::forward<tuple_type>( inner_results ), std::make_index_sequence<Size>());
-        }, std::forward<tuple_type>( results ));
-    }
+                        if( w ) {
+                            w->set_value();
+                        }
 
-    //////////
+                        return make_ready_future( std::move( value ));
+                    }
 
-    template <typename... Results>
-    std::future<std::tuple<Results...>> await_all( std::tuple<std::future<Results>...> &&results, then_launch policy ) {
-        typedef std::tuple<std::future<Results>...> tuple_type;
-        constexpr auto                              Size = std::tuple_size<tuple_type>::value;
+                    if( closed ) {
+                        return error ? make_exceptional_future<std::optional<T>>( error ) : make_ready_future( std::optional<T>());
+                    }
 
-        assert( policy == then_launch::detached );
+                    auto r = make_state<shared_state<std::optional<T>>>();
 
-        auto p = std::make_shared<std::promise<std::tuple<Results...>>>();
+                    readers.push_back( r );
 
-        std::thread( [p]( tuple_type &&inner_results ) {
-            try {
-                p->set_value( detail::get_tuple_futures<std::tuple<Results...>>( std::forward<tuple_type>( inner_results ), std::make_index_sequence<Size>()));
+                    return state_access::make_future( std::move( r ));
+                }
 
-            } catch( ... ) {
-                p->set_exception( std::current_exception());
-            }
-        }, std::forward<tuple_type>( results )).detach();
+                /*
+                 * Ends the stream, with an error if one is given. Returns false if it was already closed.
+                 * */
+                inline bool close( std::exception_ptr e ) {
+                    std::deque<reader_type> waiting;
 
-        return p->get_future();
-    }
+                    {
+                        std::lock_guard<std::mutex> lock( mtx );
 
-    template <typename... Results>
-    std::future<std::tuple<Results...>> await_all( std::tuple<std::shared_future<Results>...> &&results, then_launch policy ) {
-        typedef std::tuple<std::shared_future<Results>...> tuple_type;
-        constexpr auto                                     Size = std::tuple_size<tuple_type>::value;
+                        if( closed ) {
+                            return false;
+                        }
 
-        assert( policy == then_launch::detached );
+                        closed = true;
+                        error  = e;
 
-        auto p = std::make_shared<std::promise<std::tuple<Results...>>>();
+                        waiting.swap( readers );
+                    }
 
-        std::thread( [p]( tuple_type &&inner_results ) {
-            try {
-                p->set_value( detail::get_tuple_futures<std::tuple<Results...>>( std::forward<tuple_type>( inner_results ), std::make_index_sequence<Size>()));
+                    for( auto &r : waiting ) {
+                        if( e ) {
+                            r->set_exception( e );
 
-            } catch( ... ) {
-                p->set_exception( std::current_exception());
-            }
-        }, std::forward<tuple_type>( results )).detach();
+                        } else {
+                            r->set_value( std::optional<T>());
+                        }
+                    }
 
-        return p->get_future();
-    }
+                    return true;
+                }
 
-    template <typename... Results>
-    ThenableFuture<std::tuple<Results...>> await_all( std::tuple<ThenableFuture<Results>...> &&results, then_launch policy ) {
-        typedef std::tuple<ThenableFuture<Results>...> tuple_type;
-        constexpr auto                                 Size = std::tuple_size<tuple_type>::value;
+                /*
+                 * Called when the consumer goes away. Anything buffered is dropped, and waiting or later pushes get a broken_promise error.
+                 * */
+                inline void abandon() {
+                    std::deque<T, pool_allocator<T>> dropped;
+                    std::deque<writer_type>          blocked;
 
-        assert( policy == then_launch::detached );
+                    {
+                        std::lock_guard<std::mutex> lock( mtx );
 
-        auto p = std::make_shared<std::promise<std::tuple<Results...>>>();
+                        abandoned = true;
 
-        std::thread( [p]( tuple_type &&inner_results ) {
-            try {
-                p->set_value( detail::get_tuple_futures<std::tuple<Results...>>( std::forward<tuple_type>( inner_results ), std::make_index_sequence<Size>()));
+                        dropped.swap( buffer );
+                        blocked.swap( writers );
+                    }
 
-            } catch( ... ) {
-                p->set_exception( std::current_exception());
-            }
-        }, std::forward<tuple_type>( results )).detach();
+                    auto e = std::make_exception_ptr( std::future_error( std::future_errc::broken_promise ));
 
-        return p->get_future();
-    }
+                    for( auto &w : blocked ) {
+                        w->set_exception( e );
+                    }
+                }
 
-    template <typename... Results>
-    ThenableFuture<std::tuple<Results...>> await_all( std::tuple<ThenableSharedFuture<Results>...> &&results, then_launch policy ) {
-        typedef std::tuple<ThenableSharedFuture<Results>...> tuple_type;
-        constexpr auto                                       Size = std::tuple_size<tuple_type>::value;
+                inline void set_depth( size_t d ) {
+                    std::unique_lock<std::mutex> lock( mtx );
 
-        assert( policy == then_launch::detached );
+                    depth = d ? d : 1;
 
-        auto p = std::make_shared<std::promise<std::tuple<Results...>>>();
+                    while( writer_type w = admit()) {
+                        lock.unlock();
 
-        std::thread( [p]( tuple_type &&inner_results ) {
-            try {
-                p->set_value( detail::get_tuple_futures<std::tuple<Results...>>( std::forward<tuple_type>( inner_results ), std::make_index_sequence<Size>()));
+                        w->set_value();
 
-            } catch( ... ) {
-                p->set_exception( std::current_exception());
-            }
-        }, std::forward<tuple_type>( results )).detach();
+                        lock.lock();
+                    }
+                }
+        };
 
-        return p->get_future();
+        template <typename X>
+        struct is_awaitable : std::integral_constant<bool, requires( X &&x ) { operator co_await( std::forward<X>( x )); }> {};
     }
 
+    /*
+     * async_writer class
+     *
+     * The producing end of an async_generator, for code that isn't a coroutine itself.
+     *
+     * push returns a future that is resolved once the value fits within the prefetch depth, so a producer that waits on it
+     * never runs too far ahead. Like ThenablePromise, if the writer is destroyed without being closed,
+     * the consumer gets a broken_promise error after the last value.
+     * */
+    template <typename T>
+    class async_writer {
+            std::shared_ptr<detail::stream_state<T>> state;
+            bool                                     retrieved = false;
 
-    template <typename... Results>
-    std::future<std::tuple<Results...>> await_all( std::tuple<std::promise<Results>...> &&results, then_launch policy ) {
-        typedef std::tuple<ThenableSharedFuture<Results>...> tuple_type;
-        constexpr auto                                       Size = std::tuple_size<tuple_type>::value;
+            inline void check_state() const {
+                if( !state ) {
+                    throw std::future_error( std::future_errc::no_state );
+                }
+            }
 
-        assert( policy == then_launch::detached );
+        public:
+            inline explicit async_writer( size_t depth = generator_prefetch_depth ) : state( detail::make_state<detail::stream_state<T>>( depth )) {}
 
-        auto p = std::make_shared<std::promise<std::tuple<Results...>>>();
+            inline async_writer( async_writer &&w ) THENABLE_NOEXCEPT : state( std::move( w.state )), retrieved( w.retrieved ) {}
 
-        std::thread( [p]( tuple_type &&inner_results ) {
-            try {
-                p->set_value( detail::get_tuple_futures_from_promises<std::tuple<Results...>>( std::forward<tuple_type>( inner_results ), std::make_index_sequence<Size>()));
+            async_writer( const async_writer & ) = delete;
 
-            } catch( ... ) {
-                p->set_exception( std::current_exception());
+            async_writer &operator=( const async_writer & ) = delete;
+
+            inline async_writer &operator=( async_writer &&w ) THENABLE_NOEXCEPT {
+                async_writer( std::move( w )).swap( *this );
+
+                return *this;
             }
-        }, std::forward<tuple_type>( results )).detach();
 
-        return p->get_future();
-    }
+            inline ~async_writer() {
+                if( state ) {
+                    state->close( std::make_exception_ptr( std::future_error( std::future_errc::broken_promise )));
+                }
+            }
 
-    template <typename... Results>
-    ThenableFuture<std::tuple<Results...>> await_all( std::tuple<ThenablePromise<Results>...> &&results, then_launch policy ) {
-        typedef std::tuple<ThenableSharedFuture<Results>...> tuple_type;
-        constexpr auto                                       Size = std::tuple_size<tuple_type>::value;
+            inline void swap( async_writer &other ) THENABLE_NOEXCEPT {
+                std::swap( state, other.state );
+                std::swap( retrieved, other.retrieved );
+            }
 
-        assert( policy == then_launch::detached );
+            inline async_generator<T> get_generator();
 
-        auto p = std::make_shared<std::promise<std::tuple<Results...>>>();
+            template <typename U>
+            inline ThenableFuture<void> push( U &&value ) {
+                check_state();
 
-        std::thread( [p]( tuple_type &&inner_results ) {
-            try {
-                p->set_value( detail::get_tuple_futures_from_promises<std::tuple<Results...>>( std::forward<tuple_type>( inner_results ), std::make_index_sequence<Size>()));
+                return state->push( std::forward<U>( value ));
+            }
 
-            } catch( ... ) {
-                p->set_exception( std::current_exception());
+            inline void close() {
+                check_state();
+
+                if( !state->close( nullptr )) {
+                    throw std::future_error( std::future_errc::promise_already_satisfied );
+                }
             }
-        }, std::forward<tuple_type>( results )).detach();
 
-        return p->get_future();
-    }
+            inline void set_exception( std::exception_ptr e ) {
+                check_state();
+
+                if( !state->close( e )) {
+                    throw std::future_error( std::future_errc::promise_already_satisfied );
+                }
+            }
+    };
 
     namespace detail {
         /*
-         * These are very similar to the detached_then_helper helper structures, exception it bypasses the then_helper::dispatch part since this doesn't have to wait
-         * on a future. It just invokes it with a value using then_invoke_helper, and sets the promise to the result
+         * generator_promise structure
+         *
+         * The promise type of an async_generator coroutine. co_yield waits on the pushed value's future, so the coroutine
+         * only suspends once it's a full prefetch depth ahead, and is resumed by the consumer taking a value.
+         *
+         * If the consumer goes away, the coroutine is resumed with a broken_promise error from its co_yield and unwinds.
+         * Once it's done, the frame is destroyed before the stream is closed.
          * */
         template <typename T>
-        struct detached_waterfall_helper {
-            template <typename Functor>
-            static inline void dispatch( std::promise<T> &p, Functor &&f ) {
-                try {
-                    p.set_value( then_invoke_helper<Functor>::invoke( std::forward<Functor>( f )));
+        struct generator_promise : pooled_frame {
+            std::shared_ptr<stream_state<T>> state = make_state<stream_state<T>>( generator_prefetch_depth );
+            std::exception_ptr               error;
 
-                } catch( ... ) {
-                    p.set_exception( std::current_exception());
+            struct final_awaiter {
+                inline bool await_ready() const THENABLE_NOEXCEPT {
+                    return false;
                 }
-            }
-        };
 
-        template <>
-        struct detached_waterfall_helper<void> {
-            template <typename Functor>
-            static inline void dispatch( std::promise<void> &p, Functor &&f ) {
-                try {
-                    then_invoke_helper<Functor>::invoke( std::forward<Functor>( f ));
+                inline void await_suspend( std::coroutine_handle<generator_promise> h ) THENABLE_NOEXCEPT {
+                    auto s = std::move( h.promise().state );
+                    auto e = h.promise().error;
 
-                    p.set_value();
+                    h.destroy();
 
-                } catch( ... ) {
-                    p.set_exception( std::current_exception());
+                    s->close( e );
                 }
+
+                inline void await_resume() const THENABLE_NOEXCEPT {}
+            };
+
+            inline async_generator<T> get_return_object() THENABLE_NOEXCEPT {
+                return async_generator<T>( state, std::coroutine_handle<generator_promise>::from_promise( *this ));
+            }
+
+            inline std::suspend_always initial_suspend() const THENABLE_NOEXCEPT {
+                return {};
+            }
+
+            inline final_awaiter final_suspend() const THENABLE_NOEXCEPT {
+                return {};
+            }
+
+            template <typename U>
+            inline future_awaiter<ThenableFuture<void>> yield_value( U &&value ) {
+                return future_awaiter<ThenableFuture<void>>( state->push( std::forward<U>( value )));
+            }
+
+            inline void return_void() THENABLE_NOEXCEPT {}
+
+            inline void unhandled_exception() THENABLE_NOEXCEPT {
+                error = std::current_exception();
             }
         };
     }
 
-
     /*
-     * So because of the nature of variadic templates, the actual waterfall implementation needed to be in reverse.
-     * It goes from the last functor to first
+     * async_generator class
+     *
+     * A stream of values, produced either by a coroutine that co_yields them or through an async_writer.
+     *
+     * next gives a future for the next value, or for an empty optional once the stream has ended, so a coroutine can consume it with
+     *
+     *     while( auto value = co_await generator.next()) { ... }
+     *
+     * and anything else can use get or then on it, or hand every value to a callback with for_each.
+     *
+     * A generator coroutine doesn't start until the first value is asked for, and then runs until it's as far ahead as the
+     * prefetch depth allows. The consumer can change that depth at any time.
      * */
-    template <typename Functor>
-    inline THENABLE_DECLTYPE_AUTO_HINTED( std::future ) reverse_waterfall( std::launch policy, Functor &&f ) {
-        return std::async( policy, []( Functor &&f2 ) {
-            return detail::then_invoke_helper<Functor>::invoke( std::forward<Functor>( f2 ));
-        }, std::forward<Functor>( f ));
-    }
+    template <typename T>
+    class async_generator {
+            static_assert( !std::is_reference<T>::value && !std::is_void<T>::value, "async_generator must produce values" );
 
-    template <typename Functor>
-    THENABLE_DECLTYPE_AUTO_HINTED( std::future ) reverse_waterfall( then_launch policy, Functor &&f ) {
-        typedef decltype( detail::then_invoke_helper<Functor>::invoke( std::forward<Functor>( f ))) P;
+            friend class async_writer<T>;
 
-        assert( policy == then_launch::detached );
+            friend struct detail::generator_promise<T>;
 
-        auto p = std::make_shared<std::promise<P>>();
+            std::shared_ptr<detail::stream_state<T>> state;
+            std::coroutine_handle<>                  producer;
 
-        std::thread( [p]( Functor &&f2 ) {
-            detail::detached_waterfall_helper<P>::dispatch( *p, std::forward<Functor>( f2 ));
-        }, std::forward<Functor>( f )).detach();
+            inline async_generator( std::shared_ptr<detail::stream_state<T>> s, std::coroutine_handle<> h ) THENABLE_NOEXCEPT
+                : state( std::move( s )), producer( h ) {}
 
-        return p->get_future();
-    }
+            template <typename Functor>
+            static task<void> drain( async_generator g, Functor f ) {
+                while( auto value = co_await g.next()) {
+                    if constexpr( detail::is_awaitable<decltype( f( std::move( *value )))>::value ) {
+                        co_await f( std::move( *value ));
+
+                    } else {
+                        f( std::move( *value ));
+                    }
+                }
+            }
 
-    template <typename PolicyType, typename Functor, typename... Functors>
-    inline THENABLE_DECLTYPE_AUTO_HINTED( std::future ) reverse_waterfall( PolicyType policy, Functor &&f, Functors &&... fns ) {
-        return then( reverse_waterfall( policy, std::forward<Functors>( fns )... ), std::forward<Functor>( f ), policy );
-    }
+        public:
+            typedef detail::generator_promise<T> promise_type;
 
+            async_generator() THENABLE_NOEXCEPT = default;
 
-    namespace detail {
-        /*
-         * Found this solution at http://stackoverflow.com/a/15907838
-         *
-         * It applies variadic templates to a function in reverse by recursively calling itself with the template parameters shifted over
-         * */
+            inline async_generator( async_generator &&g ) THENABLE_NOEXCEPT : state( std::move( g.state )), producer( std::exchange( g.producer, nullptr )) {}
 
-        template <typename... Head>
-        struct forward_waterfall;
+            async_generator( const async_generator & ) = delete;
 
-        template <>
-        struct forward_waterfall<> {
-            template <typename... Rest>
-            static inline decltype( auto ) apply( Rest &&... rest ) {
-                return reverse_waterfall( std::forward<Rest>( rest )... );
+            async_generator &operator=( const async_generator & ) = delete;
+
+            inline async_generator &operator=( async_generator &&g ) THENABLE_NOEXCEPT {
+                async_generator( std::move( g )).swap( *this );
+
+                return *this;
             }
-        };
 
-        template <typename First, typename... Head>
-        struct forward_waterfall<First, Head...> {
-            template <typename... Rest>
-            static inline decltype( auto ) apply( First &&first, Head &&... head, Rest &&... rest ) {
-                return forward_waterfall<Head...>::apply( std::forward<Head>( head )..., std::forward<First>( first ), std::forward<Rest>( rest )... );
+            inline ~async_generator() {
+                if( producer ) {
+                    producer.destroy();
+                }
+
+                if( state ) {
+                    state->abandon();
+                }
             }
-        };
-    }
 
+            inline void swap( async_generator &other ) THENABLE_NOEXCEPT {
+                std::swap( state, other.state );
+                std::swap( producer, other.producer );
+            }
 
-    /*
-     * Actual waterfall implementations that just forward the policy and functors through the forward_waterfall
-     * which reverses them and calls reverse_waterfall
-     * */
+            inline bool valid() const THENABLE_NOEXCEPT {
+                return state != nullptr;
+            }
 
-    template <typename... Functors>
-    inline THENABLE_DECLTYPE_AUTO_HINTED( std::future ) waterfall( std::launch policy, Functors &&... fns ) {
-        return detail::forward_waterfall<Functors..., std::launch>::apply( std::forward<Functors>( fns )..., std::forward<std::launch>( policy ));
-    }
+            inline async_generator &prefetch( size_t depth ) & {
+                if( !state ) {
+                    throw std::future_error( std::future_errc::no_state );
+                }
 
-    template <typename... Functors>
-    inline THENABLE_DECLTYPE_AUTO_HINTED( std::future ) waterfall( then_launch policy, Functors &&... fns ) {
-        return detail::forward_waterfall<Functors..., then_launch>::apply( std::forward<Functors>( fns )..., std::forward<then_launch>( policy ));
-    }
+                state->set_depth( depth );
 
-    template <typename... Functors>
-    inline THENABLE_DECLTYPE_AUTO_HINTED( std::future ) waterfall( Functors &&... fns ) {
-        return waterfall( default_policy, std::forward<Functors>( fns )... );
+                return *this;
+            }
+
+            inline async_generator &&prefetch( size_t depth ) && {
+                return std::move( prefetch( depth ));
+            }
+
+            inline ThenableFuture<std::optional<T>> next() {
+                if( !state ) {
+                    throw std::future_error( std::future_errc::no_state );
+                }
+
+                if( producer ) {
+                    std::exchange( producer, nullptr ).resume();
+                }
+
+                return state->pop();
+            }
+
+            /*
+             * Calls f with every value in order, and resolves once the stream has ended. If f returns something that can be awaited,
+             * such as a ThenableFuture or a task, the next value isn't taken until it's resolved.
+             *
+             * Like ThenableFuture::then, this consumes the generator.
+             * */
+            template <typename Functor>
+            inline ThenableFuture<void> for_each( Functor &&f ) {
+                return drain<typename std::decay<Functor>::type>( std::move( *this ), std::forward<Functor>( f )).start();
+            }
+    };
+
+    template <typename T>
+    inline async_generator<T> async_writer<T>::get_generator() {
+        check_state();
+
+        if( retrieved ) {
+            throw std::future_error( std::future_errc::future_already_retrieved );
+        }
+
+        retrieved = true;
+
+        return async_generator<T>( state, nullptr );
     }
 
-    template <typename... Args>
-    inline THENABLE_DECLTYPE_AUTO_HINTED( std::future ) waterfall2( Args &&... args ) {
-        return to_thenable( waterfall( std::forward<Args>( args )... ));
+#endif
+}
+
+namespace std {
+    template <typename T, typename Alloc>
+    struct uses_allocator<thenable::ThenablePromise<T>, Alloc> : true_type {
     };
 }
 
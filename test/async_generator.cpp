@@ -0,0 +1,196 @@
+#include <thenable/thenable.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+#ifdef THENABLE_HAS_COROUTINES
+
+using namespace thenable;
+
+static std::atomic<int> produced{ 0 };
+
+static async_generator<int> count( int n ) {
+    for( int i = 0; i < n; ++i ) {
+        ++produced;
+
+        co_yield i;
+    }
+}
+
+static async_generator<std::string> fail() {
+    co_yield std::string( "a" );
+
+    throw std::runtime_error( "x" );
+}
+
+static async_generator<int> forward( std::vector<ThenablePromise<int>> &ps ) {
+    for( auto &p : ps ) {
+        co_yield co_await p;
+    }
+}
+
+static std::atomic<int> unwound{ 0 };
+
+struct unwind_counter {
+    ~unwind_counter() {
+        ++unwound;
+    }
+};
+
+static async_generator<int> forever() {
+    unwind_counter c;
+
+    for( int i = 0;; ++i ) {
+        co_yield i;
+    }
+}
+
+static task<long> sum( async_generator<int> g ) {
+    long s = 0;
+
+    while( auto v = co_await g.next()) {
+        s += *v;
+    }
+
+    co_return s;
+}
+
+int main() {
+    //The producer only runs ahead of the consumer by the prefetch depth
+    {
+        produced = 0;
+
+        auto g = count( 100 );
+
+        assert( produced == 0 );
+
+        auto v = g.next().get();
+
+        assert( v && *v == 0 );
+        assert( produced == static_cast<int>( generator_prefetch_depth ) + 2 );
+
+        long s = *v;
+
+        while( auto x = g.next().get()) {
+            s += *x;
+        }
+
+        assert( s == 4950 );
+    }
+
+    //Consumed by coroutines and for_each
+    {
+        assert( sum( count( 1000 )).get() == 499500 );
+
+        std::vector<ThenablePromise<int>> ps( 100 );
+
+        auto f = sum( forward( ps )).start();
+
+        std::thread t( [&] {
+            for( auto &p : ps ) {
+                p.set_value( 2 );
+            }
+        } );
+
+        assert( f.get() == 200 );
+
+        t.join();
+
+        std::vector<int> seen;
+
+        count( 10 ).prefetch( 2 ).for_each( [&]( int x ) { seen.push_back( x ); } ).get();
+
+        assert( seen.size() == 10 && seen[9] == 9 );
+    }
+
+    //Errors come after the last value
+    {
+        auto g = fail();
+
+        assert( *g.next().get() == "a" );
+
+        bool threw = false;
+
+        try {
+            g.next().get();
+
+        } catch( std::runtime_error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+    }
+
+    //Dropping the generator unwinds its coroutine
+    {
+        unwound = 0;
+
+        {
+            auto g = forever();
+
+            assert( *g.next().get() == 0 );
+        }
+
+        assert( unwound == 1 );
+    }
+
+    //Writers wait for room once they're a full depth ahead
+    {
+        async_writer<int> w( 2 );
+
+        auto g = w.get_generator();
+
+        assert( w.push( 1 ).is_ready());
+        assert( w.push( 2 ).is_ready());
+
+        auto third = w.push( 3 );
+
+        assert( !third.is_ready());
+        assert( *g.next().get() == 1 );
+        assert( third.is_ready());
+
+        w.close();
+
+        assert( *g.next().get() == 2 );
+        assert( *g.next().get() == 3 );
+        assert( !g.next().get());
+    }
+
+    //Writers on other threads
+    {
+        async_writer<int> w( 4 );
+
+        auto g = w.get_generator();
+
+        std::thread producer( [&w] {
+            for( int i = 1; i <= 10000; ++i ) {
+                w.push( i ).wait();
+            }
+
+            w.close();
+        } );
+
+        long s = 0;
+
+        while( auto v = g.next().get()) {
+            s += *v;
+        }
+
+        assert( s == 50005000 );
+
+        producer.join();
+    }
+
+    std::cout << "ok" << std::endl;
+}
+
+#else
+
+int main() {
+    std::cout << "coroutines aren't supported" << std::endl;
+
+    return 77;
+}
+
+#endif
@@ -0,0 +1,115 @@
+#include <thenable/experimental.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+using namespace thenable;
+
+int main() {
+    //Resolves only once every future has, without a thread waiting on them
+    {
+        ThenablePromise<int>         a;
+        ThenablePromise<std::string> b;
+
+        auto all = await_all( std::make_tuple( a.get_future(), b.get_future()));
+
+        assert( !all.is_ready());
+
+        a.set_value( 1 );
+
+        assert( !all.is_ready());
+
+        b.set_value( "x" );
+
+        assert( all.is_ready());
+
+        auto t = all.get();
+
+        assert( std::get<0>( t ) == 1 && std::get<1>( t ) == "x" );
+    }
+
+    //Many joins at once
+    {
+        std::vector<ThenablePromise<int>>                   ps( 2000 );
+        std::vector<ThenableFuture<std::tuple<int, int>>> fs;
+
+        for( size_t i = 0; i < ps.size(); i += 2 ) {
+            fs.push_back( await_all( std::make_tuple( ps[i].get_future(), ps[i + 1].get_future()), then_launch::detached ));
+        }
+
+        for( size_t i = 0; i < ps.size(); ++i ) {
+            ps[i].set_value( static_cast<int>( i ));
+        }
+
+        long total = 0;
+
+        for( auto &f : fs ) {
+            auto t = f.get();
+
+            total += std::get<0>( t ) + std::get<1>( t );
+        }
+
+        assert( total == 1999L * 2000 / 2 );
+    }
+
+    //std::futures, deferred policies and shared futures
+    {
+        auto all = await_all( std::make_tuple( std::async( std::launch::async, [] { return 1; } ),
+                                               std::async( std::launch::deferred, [] { return 2; } )));
+
+        auto t = all.get();
+
+        assert( std::get<0>( t ) == 1 && std::get<1>( t ) == 2 );
+
+        ThenablePromise<int> p;
+
+        p.set_value( 3 );
+
+        auto d = await_all( std::make_tuple( p.get_future()), std::launch::deferred );
+
+        assert( std::get<0>( d.get()) == 3 );
+
+        std::shared_future<int> s = std::async( std::launch::async, [] { return 5; } ).share();
+
+        assert( std::get<0>( await_all( std::make_tuple( s ), then_launch::immediate ).get()) == 5 );
+    }
+
+    //The first exception fails the join
+    {
+        ThenablePromise<int> a, b;
+
+        auto s = a.get_future().share();
+
+        auto all = await_all( std::make_tuple( s, b.get_future().share()));
+
+        a.set_value( 1 );
+        b.set_exception( std::make_exception_ptr( std::runtime_error( "b" )));
+
+        bool threw = false;
+
+        try {
+            all.get();
+
+        } catch( std::runtime_error & ) {
+            threw = true;
+        }
+
+        assert( threw && s.get() == 1 );
+    }
+
+    //On an executor
+    {
+        experimental::ThreadPool pool( 2 );
+
+        ThenablePromise<int> a;
+
+        auto all = await_all( std::make_tuple( a.get_future()), pool );
+
+        a.set_value( 4 );
+
+        assert( std::get<0>( all.get()) == 4 );
+    }
+
+    std::cout << "ok" << std::endl;
+}
@@ -0,0 +1,145 @@
+#include <thenable/experimental.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+using namespace thenable;
+
+struct move_only {
+    int value;
+
+    explicit move_only( int v ) : value( v ) {}
+
+    move_only( move_only && ) = default;
+
+    move_only( const move_only & ) = delete;
+
+    move_only &operator=( move_only && ) = default;
+};
+
+int main() {
+    //Values come back in the order of the futures, not the order they resolve in
+    {
+        std::vector<ThenablePromise<int>> ps( 5000 );
+        std::vector<ThenableFuture<int>>  fs;
+
+        for( auto &p : ps ) {
+            fs.push_back( p.get_future());
+        }
+
+        auto all = await_all( std::move( fs ));
+
+        for( size_t i = ps.size(); i-- > 0; ) {
+            ps[i].set_value( static_cast<int>( i ));
+        }
+
+        auto v = all.get();
+
+        assert( v.size() == 5000 );
+
+        for( size_t i = 0; i < v.size(); ++i ) {
+            assert( v[i] == static_cast<int>( i ));
+        }
+    }
+
+    //Types that can't be default constructed or copied
+    {
+        std::vector<ThenablePromise<move_only>> ps( 10 );
+        std::vector<ThenableFuture<move_only>>  fs;
+
+        for( auto &p : ps ) {
+            fs.push_back( p.get_future());
+        }
+
+        auto all = await_all( std::move( fs ), then_launch::immediate );
+
+        for( size_t i = 0; i < ps.size(); ++i ) {
+            ps[i].set_value( move_only( static_cast<int>( i )));
+        }
+
+        assert( all.get()[9].value == 9 );
+    }
+
+    //Shared futures, deferred policies and empty vectors
+    {
+        ThenablePromise<std::string> p;
+
+        auto s = p.get_future().share();
+
+        std::vector<ThenableSharedFuture<std::string>> fs{ s, s };
+
+        auto all = await_all( std::move( fs ), std::launch::deferred );
+
+        p.set_value( "hi" );
+
+        auto v = all.get();
+
+        assert( v[0] == "hi" && v[1] == "hi" && s.get() == "hi" );
+
+        assert( await_all( std::vector<ThenableFuture<int>>()).get().empty());
+    }
+
+    //Values of std::vector<bool> share words, so they can't be stored from different threads as they arrive
+    for( int round = 0; round < 200; ++round ) {
+        std::vector<ThenablePromise<bool>> ps( 64 );
+        std::vector<ThenableFuture<bool>>  fs;
+
+        for( auto &p : ps ) {
+            fs.push_back( p.get_future());
+        }
+
+        auto all = await_all( std::move( fs ), then_launch::immediate );
+
+        std::vector<std::thread> threads;
+
+        for( size_t t = 0; t < 8; ++t ) {
+            threads.emplace_back( [&ps, t] {
+                for( size_t i = t; i < ps.size(); i += 8 ) {
+                    ps[i].set_value( i % 3 != 0 );
+                }
+            } );
+        }
+
+        for( auto &t : threads ) {
+            t.join();
+        }
+
+        auto v = all.get();
+
+        for( size_t i = 0; i < v.size(); ++i ) {
+            assert( v[i] == ( i % 3 != 0 ));
+        }
+    }
+
+    //Exceptions, on an executor
+    {
+        std::vector<ThenablePromise<int>> ps( 3 );
+        std::vector<ThenableFuture<int>>  fs;
+
+        for( auto &p : ps ) {
+            fs.push_back( p.get_future());
+        }
+
+        experimental::ThreadPool pool( 2 );
+
+        auto all = await_all( std::move( fs ), pool );
+
+        ps[0].set_value( 1 );
+        ps[1].set_exception( std::make_exception_ptr( std::runtime_error( "x" )));
+        ps[2].set_value( 3 );
+
+        bool threw = false;
+
+        try {
+            all.get();
+
+        } catch( std::runtime_error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+    }
+
+    std::cout << "ok" << std::endl;
+}
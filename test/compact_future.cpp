@@ -0,0 +1,178 @@
+#include <thenable/experimental.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+using namespace thenable;
+using namespace thenable::experimental;
+
+static_assert( sizeof( compact_future<int> ) == 8, "compact_future is a single word" );
+
+int main() {
+    //Basic resolution, across threads
+    {
+        compact_promise<int> p;
+
+        auto f = p.get_future();
+
+        assert( f.valid() && !f.is_ready());
+        assert( f.wait_for( std::chrono::milliseconds( 1 )) == std::future_status::timeout );
+
+        p.set_value( 5 );
+
+        assert( f.is_ready() && f.get() == 5 && !f.valid());
+
+        compact_promise<std::string> q;
+
+        auto g = q.get_future();
+
+        std::thread t( [&] { q.set_value( std::string( 100, 'x' )); } );
+
+        assert( g.get().size() == 100 );
+
+        t.join();
+
+        compact_promise<void> v;
+
+        auto h = v.get_future();
+
+        v.set_value();
+
+        h.get();
+    }
+
+    //Errors
+    {
+        compact_future<int> f;
+
+        {
+            compact_promise<int> p;
+
+            f = p.get_future();
+        }
+
+        bool broken = false;
+
+        try {
+            f.get();
+
+        } catch( std::future_error &e ) {
+            broken = e.code() == std::future_errc::broken_promise;
+        }
+
+        assert( broken );
+
+        compact_promise<int> p;
+
+        auto g = p.get_future();
+
+        bool retrieved = false;
+
+        try {
+            p.get_future();
+
+        } catch( std::future_error &e ) {
+            retrieved = e.code() == std::future_errc::future_already_retrieved;
+        }
+
+        assert( retrieved );
+
+        p.set_exception( std::make_exception_ptr( std::runtime_error( "x" )));
+
+        bool threw = false;
+
+        try {
+            g.get();
+
+        } catch( std::runtime_error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+    }
+
+    //A moved-from handle has no state
+    {
+        compact_promise<int> p;
+
+        auto f = p.get_future();
+        auto g = std::move( f );
+
+        assert( !f.valid());
+
+        bool no_state = false;
+
+        try {
+            f.is_ready();
+
+        } catch( std::future_error &e ) {
+            no_state = e.code() == std::future_errc::no_state;
+        }
+
+        assert( no_state );
+
+        p.set_value( 1 );
+
+        assert( g.get() == 1 );
+    }
+
+    //then and await_all
+    {
+        compact_promise<int> p;
+
+        auto f = p.get_future().then( []( int x ) { return x * 3; }, then_launch::immediate );
+
+        p.set_value( 4 );
+
+        assert( f.get() == 12 );
+
+        std::vector<compact_promise<int>> ps( 10000 );
+        std::vector<compact_future<int>>  fs;
+
+        for( auto &q : ps ) {
+            fs.push_back( q.get_future());
+        }
+
+        auto all = await_all( std::move( fs ), then_launch::immediate );
+
+        std::thread t( [&] {
+            for( size_t i = 0; i < ps.size(); ++i ) {
+                ps[i].set_value( static_cast<int>( i ));
+            }
+        } );
+
+        auto v = all.get();
+
+        t.join();
+
+        for( size_t i = 0; i < v.size(); ++i ) {
+            assert( v[i] == static_cast<int>( i ));
+        }
+    }
+
+    //Slots are recycled between threads
+    {
+        std::vector<std::thread> threads;
+
+        for( int t = 0; t < 4; ++t ) {
+            threads.emplace_back( [] {
+                for( int i = 0; i < 20000; ++i ) {
+                    compact_promise<int> p;
+
+                    auto f = p.get_future();
+
+                    p.set_value( i );
+
+                    assert( f.get() == i );
+                }
+            } );
+        }
+
+        for( auto &t : threads ) {
+            t.join();
+        }
+    }
+
+    std::cout << "ok" << std::endl;
+}
@@ -0,0 +1,69 @@
+#include <thenable/thenable.hpp>
+
+#include <cassert>
+#include <iostream>
+
+using namespace thenable;
+
+static const int length = 100000;
+
+int main() {
+    //A long deferred chain on a pending promise is evaluated without recursing
+    {
+        ThenablePromise<int> p;
+
+        ThenableFuture<int> f = p.get_future();
+
+        for( int i = 0; i < length; ++i ) {
+            f = f.then( []( int x ) { return x + 1; }, std::launch::deferred );
+        }
+
+        p.set_value( 0 );
+
+        assert( f.get() == length );
+    }
+
+    //Or on a ready one
+    {
+        ThenableFuture<int> f = make_ready_future( 0 );
+
+        for( int i = 0; i < length; ++i ) {
+            f = f.then( []( int x ) { return x + 1; }, std::launch::deferred );
+        }
+
+        assert( f.get() == length );
+    }
+
+    //A long chain that is never run is released without recursing either
+    {
+        ThenablePromise<int> p;
+
+        ThenableFuture<int> f = p.get_future();
+
+        for( int i = 0; i < length; ++i ) {
+            f = f.then( []( int x ) { return x + 1; }, std::launch::deferred );
+        }
+    }
+
+    //An exception is passed through the whole chain
+    {
+        ThenableFuture<int> f = make_exceptional_future<int>( std::runtime_error( "x" ));
+
+        for( int i = 0; i < length; ++i ) {
+            f = f.then( []( int x ) { return x + 1; }, std::launch::deferred );
+        }
+
+        bool threw = false;
+
+        try {
+            f.get();
+
+        } catch( std::runtime_error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+    }
+
+    std::cout << "ok" << std::endl;
+}
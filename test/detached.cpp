@@ -0,0 +1,82 @@
+#include <thenable/thenable.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <vector>
+
+using namespace thenable;
+
+ThenableFuture<int> resolved( int x ) {
+    ThenablePromise<int> p;
+
+    p.set_value( x );
+
+    return p.get_future();
+}
+
+int main() {
+    //Detached callbacks reuse parked threads instead of starting one each
+    {
+        std::set<std::thread::id> threads;
+        std::mutex                mtx;
+
+        for( int i = 0; i < 50; ++i ) {
+            auto f = resolved( i ).then( [&]( int x ) {
+                std::lock_guard<std::mutex> lock( mtx );
+
+                threads.insert( std::this_thread::get_id());
+
+                return x;
+            }, then_launch::detached );
+
+            assert( f.get() == i );
+
+            //Give the thread a moment to park itself again
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ));
+        }
+
+        assert( threads.size() < 50 );
+    }
+
+    //A detached callback that blocks doesn't hold up any others
+    {
+        std::promise<void> gate;
+
+        std::shared_future<void> opened = gate.get_future().share();
+
+        std::vector<ThenableFuture<int>> blocked;
+
+        for( int i = 0; i < 8; ++i ) {
+            blocked.push_back( resolved( 1 ).then( [opened]( int x ) {
+                opened.wait();
+
+                return x;
+            }, then_launch::detached ));
+        }
+
+        auto other = resolved( 2 ).then( []( int x ) { return x; }, then_launch::detached );
+
+        assert( other.get() == 2 );
+
+        gate.set_value();
+
+        for( auto &f : blocked ) {
+            assert( f.get() == 1 );
+        }
+    }
+
+    //await_all and waterfall
+    {
+        auto a = await_all( std::make_tuple( std::async( std::launch::async, [] { return 1; } )), then_launch::detached );
+
+        assert( std::get<0>( a.get()) == 1 );
+
+        auto w = waterfall( then_launch::detached, [] { return 1; }, []( int x ) { return x + 1; } );
+
+        assert( w.get() == 2 );
+    }
+
+    std::cout << "ok" << std::endl;
+}
@@ -0,0 +1,135 @@
+#include <thenable/thenable.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace thenable;
+
+//A minimal executor, which counts what was submitted to it
+class counting_executor {
+        std::mutex                        mtx;
+        std::condition_variable           cv;
+        std::deque<std::function<void()>> queue;
+        std::vector<std::thread>          threads;
+        bool                              stopping = false;
+
+    public:
+        std::atomic<int> submitted{ 0 };
+
+        explicit counting_executor( int n ) {
+            for( int i = 0; i < n; ++i ) {
+                threads.emplace_back( [this] {
+                    for( ;; ) {
+                        std::function<void()> task;
+
+                        {
+                            std::unique_lock<std::mutex> lock( mtx );
+
+                            cv.wait( lock, [this] { return stopping || !queue.empty(); } );
+
+                            if( queue.empty()) {
+                                return;
+                            }
+
+                            task = std::move( queue.front());
+
+                            queue.pop_front();
+                        }
+
+                        task();
+                    }
+                } );
+            }
+        }
+
+        ~counting_executor() {
+            {
+                std::lock_guard<std::mutex> lock( mtx );
+
+                stopping = true;
+            }
+
+            cv.notify_all();
+
+            for( auto &t : threads ) {
+                t.join();
+            }
+        }
+
+        template <typename Functor>
+        void submit( Functor &&f ) {
+            ++submitted;
+
+            {
+                std::lock_guard<std::mutex> lock( mtx );
+
+                queue.emplace_back( std::forward<Functor>( f ));
+            }
+
+            cv.notify_one();
+        }
+};
+
+static_assert( detail::is_executor<counting_executor>::value, "counting_executor is an executor" );
+static_assert( !detail::is_executor<std::launch>::value, "launch policies aren't executors" );
+
+int main() {
+    counting_executor executor( 2 );
+
+    //then runs callbacks on the executor
+    {
+        ThenablePromise<int> p;
+
+        auto f = p.then( []( int x ) { return x + 1; }, executor ).then( []( int x ) { return x * 2; }, executor );
+
+        p.set_value( 3 );
+
+        assert( f.get() == 8 );
+        assert( executor.submitted == 2 );
+    }
+
+    //std::futures and shared futures
+    {
+        auto f = then( std::async( std::launch::async, [] { return 1; } ), []( int x ) { return x + 1; }, executor );
+
+        assert( f.get() == 2 );
+
+        ThenablePromise<int> p;
+
+        auto s = p.get_future().share();
+        auto g = s.then( []( int x ) { return x; }, executor );
+
+        p.set_value( 9 );
+
+        assert( g.get() == 9 );
+    }
+
+    //await_all, waterfall and make_promise
+    {
+        ThenablePromise<int>    a;
+        ThenablePromise<double> b;
+
+        auto r = await_all( std::make_tuple( a.get_future(), b.get_future()), executor )
+            .then( []( int x, double y ) { return x + y; }, executor );
+
+        b.set_value( 0.5 );
+        a.set_value( 2 );
+
+        assert( r.get() == 2.5 );
+
+        auto w = waterfall( executor, [] { return 1; }, []( int x ) { return x + 1; }, []( int x ) { return x * 10; } );
+
+        assert( w.get() == 20 );
+
+        auto m = make_promise2<int>( []( auto resolve, auto ) { resolve( 4 ); }, executor );
+
+        assert( m.get() == 4 );
+    }
+
+    std::cout << "ok" << std::endl;
+}
@@ -0,0 +1,167 @@
+#include <thenable/experimental.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <functional>
+
+#ifdef THENABLE_HAS_FIBERS
+
+using namespace thenable;
+using namespace thenable::experimental;
+
+int main() {
+    //Far more blocked tasks than threads, each staying on its own worker thread
+    {
+        const int n = 10000;
+
+        std::vector<ThenablePromise<int>> ps( n );
+        std::vector<ThenableFuture<int>>  fs;
+
+        std::atomic<int> started{ 0 }, same_thread{ 0 };
+
+        FiberPool pool( 2 );
+
+        for( int i = 0; i < n; ++i ) {
+            fs.push_back( make_ready_future().then( [&, i] {
+                auto id = std::this_thread::get_id();
+
+                ++started;
+
+                int v = ps[i].get_future().get();
+
+                if( id == std::this_thread::get_id()) {
+                    ++same_thread;
+                }
+
+                return v * 2;
+            }, pool ));
+        }
+
+        while( started < n ) {
+            std::this_thread::yield();
+        }
+
+        for( int i = 0; i < n; ++i ) {
+            ps[i].set_value( i );
+        }
+
+        long s = 0;
+
+        for( auto &f : fs ) {
+            s += f.get();
+        }
+
+        assert( s == long( n ) * ( n - 1 ));
+        assert( same_thread == n );
+    }
+
+    {
+        FiberPool pool( 1 );
+
+        assert( !pool.is_worker());
+        assert( make_ready_future().then( [&pool] { return pool.is_worker(); }, pool ).get());
+
+        //A task waiting on another task in a single threaded pool
+        auto f = make_ready_future().then( [&pool] {
+            return make_ready_future().then( [] { return 21; }, pool ).get() * 2;
+        }, pool );
+
+        assert( f.get() == 42 );
+
+        //Deferred upstreams are run on the fiber
+        auto d = make_ready_future().then( [] {
+            return make_ready_future( 1 ).then( []( int x ) { return x + 1; }, std::launch::deferred ).get();
+        }, pool );
+
+        assert( d.get() == 2 );
+
+        //Exceptions from the waited on future
+        auto e = make_ready_future().then( [] {
+            ThenableFuture<int> broken;
+
+            {
+                ThenablePromise<int> p;
+
+                broken = p.get_future();
+            }
+
+            return broken.get();
+        }, pool );
+
+        bool threw = false;
+
+        try {
+            e.get();
+
+        } catch( std::future_error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+    }
+
+    //Fibers suspended inside immediate callbacks don't leave them nested for the next fiber
+    {
+        FiberPool pool( 1 );
+
+        ThenablePromise<int> gate;
+
+        auto opened = gate.get_future().share();
+
+        std::vector<ThenableFuture<int>> fs;
+
+        for( int i = 0; i < 100; ++i ) {
+            fs.push_back( make_ready_future().then( [opened] {
+                ThenablePromise<void> p;
+
+                auto f = p.get_future().then( [opened] { return opened.get(); }, then_launch::immediate );
+
+                p.set_value();
+
+                return f.get();
+            }, pool ));
+        }
+
+        fs.push_back( make_ready_future().then( [&gate] {
+            ThenablePromise<void> p;
+
+            auto f = p.get_future().then( [&gate] { gate.set_value( 1 ); return 1; }, then_launch::immediate );
+
+            p.set_value();
+
+            return f.get();
+        }, pool ));
+
+        for( auto &f : fs ) {
+            assert( f.wait_for( std::chrono::seconds( 10 )) == std::future_status::ready );
+            assert( f.get() == 1 );
+        }
+    }
+
+    //Nested waits, each one on a new fiber
+    {
+        FiberPool pool( 2 );
+
+        std::function<int( int )> recurse = [&]( int k ) -> int {
+            if( k == 0 ) {
+                return 0;
+            }
+
+            return make_ready_future().then( [&, k] { return recurse( k - 1 ); }, pool ).get() + 1;
+        };
+
+        assert( make_ready_future().then( [&] { return recurse( 500 ); }, pool ).get() == 500 );
+    }
+
+    std::cout << "ok" << std::endl;
+}
+
+#else
+
+int main() {
+    std::cout << "fibers aren't supported" << std::endl;
+
+    return 77;
+}
+
+#endif
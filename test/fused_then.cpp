@@ -0,0 +1,121 @@
+#include <thenable/experimental.hpp>
+
+#include <cassert>
+#include <iostream>
+
+using namespace thenable;
+
+struct counted {
+    static std::atomic<int> live;
+
+    counted() { ++live; }
+
+    counted( const counted & ) { ++live; }
+
+    ~counted() { --live; }
+};
+
+std::atomic<int> counted::live{ 0 };
+
+int main() {
+    //The callback is released once it has run, even though the result lives on in the same block
+    {
+        ThenablePromise<int> p;
+
+        counted c;
+
+        auto f = p.get_future().then( [c]( int x ) { return x; }, then_launch::immediate );
+
+        assert( counted::live == 2 );
+
+        p.set_value( 1 );
+
+        assert( counted::live == 1 );
+        assert( f.get() == 1 );
+    }
+
+    //A broken promise breaks the whole chain
+    {
+        ThenableFuture<int> f;
+
+        {
+            ThenablePromise<int> p;
+
+            f = p.get_future();
+
+            for( int i = 0; i < 1000; ++i ) {
+                f = f.then( []( int x ) { return x + 1; }, then_launch::immediate );
+            }
+        }
+
+        bool broken = false;
+
+        try {
+            f.get();
+
+        } catch( std::future_error &e ) {
+            broken = e.code() == std::future_errc::broken_promise;
+        }
+
+        assert( broken );
+    }
+
+    //Deferred callbacks followed by other policies
+    {
+        ThenablePromise<int> p;
+
+        auto f = p.get_future().then( []( int x ) { return x + 1; }, std::launch::deferred )
+                  .then( []( int x ) { return x * 2; }, then_launch::detached );
+
+        p.set_value( 1 );
+
+        assert( f.get() == 4 );
+
+        experimental::ThreadPool pool( 2 );
+
+        ThenablePromise<int> q;
+
+        auto g = q.get_future().then( []( int x ) { return x + 1; }, std::launch::deferred )
+                  .then( []( int x ) { return x * 3; }, pool );
+
+        q.set_value( 1 );
+
+        assert( g.get() == 6 );
+    }
+
+    //The callback still runs when its future was dropped first
+    {
+        ThenablePromise<int> p;
+
+        ThenablePromise<void> ran;
+
+        {
+            auto f = p.get_future().then( [&]( int ) { ran.set_value(); } );
+        }
+
+        p.set_value( 1 );
+
+        ran.get_future().get();
+    }
+
+    //Fan-out from a shared future
+    {
+        ThenablePromise<int> p;
+
+        auto s = p.get_future().share();
+
+        std::vector<ThenableFuture<int>> fs;
+
+        for( int i = 0; i < 100; ++i ) {
+            fs.push_back( s.then( [i]( int x ) { return x + i; } ));
+        }
+
+        p.set_value( 1 );
+
+        for( int i = 0; i < 100; ++i ) {
+            assert( fs[i].get() == i + 1 );
+        }
+    }
+
+    std::cout << "ok" << std::endl;
+}
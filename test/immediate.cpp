@@ -0,0 +1,90 @@
+#include <thenable/thenable.hpp>
+
+#include <cassert>
+#include <iostream>
+
+using namespace thenable;
+
+int main() {
+    //A callback on a ready future runs on the calling thread before then returns
+    {
+        ThenablePromise<int> p;
+
+        p.set_value( 1 );
+
+        std::thread::id seen;
+
+        auto f = then( p.get_future(), [&]( int x ) {
+            seen = std::this_thread::get_id();
+
+            return x + 1;
+        }, then_launch::immediate );
+
+        assert( seen == std::this_thread::get_id());
+        assert( f.is_ready() && f.get() == 2 );
+    }
+
+    //A callback on a pending future runs on the thread that resolves it
+    {
+        ThenablePromise<int> p;
+
+        std::thread::id seen, resolver;
+
+        auto f = then( p.get_future(), [&]( int x ) {
+            seen = std::this_thread::get_id();
+
+            return x + 1;
+        }, then_launch::immediate );
+
+        std::thread t( [&] {
+            resolver = std::this_thread::get_id();
+
+            p.set_value( 5 );
+        } );
+
+        t.join();
+
+        assert( seen == resolver );
+        assert( f.get() == 6 );
+    }
+
+    //Long chains are run iteratively instead of recursing once per callback
+    {
+        ThenablePromise<int> p;
+
+        ThenableFuture<int> f = p.get_future();
+
+        for( int i = 0; i < 100000; ++i ) {
+            f = then( std::move( f ), []( int x ) { return x + 1; }, then_launch::immediate );
+        }
+
+        p.set_value( 0 );
+
+        assert( f.get() == 100000 );
+    }
+
+    //std::futures, waterfall and await_all
+    {
+        std::promise<int> p;
+
+        p.set_value( 3 );
+
+        auto f = then( p.get_future(), []( int x ) { return x * 2; }, then_launch::immediate );
+
+        assert( f.get() == 6 );
+
+        auto w = waterfall( then_launch::immediate, [] { return 1; }, []( int x ) { return x + 1; } );
+
+        assert( w.get() == 2 );
+
+        std::promise<int> q;
+
+        q.set_value( 4 );
+
+        auto a = await_all( std::make_tuple( q.get_future()), then_launch::immediate );
+
+        assert( std::get<0>( a.get()) == 4 );
+    }
+
+    std::cout << "ok" << std::endl;
+}
@@ -0,0 +1,83 @@
+#include <thenable/experimental.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+using namespace thenable;
+using namespace thenable::experimental;
+
+struct error {};
+
+int main() {
+    //Nothing runs until the chain is started
+    {
+        int ran = 0;
+
+        auto l = just( 1 ).then( [&]( int x ) {
+            ++ran;
+
+            return x + 1;
+        } ).then( []( int x ) { return x * 10; } );
+
+        assert( ran == 0 );
+        assert( std::move( l ).get() == 20 && ran == 1 );
+    }
+
+    //void, tuples unpacked into the next callback, and conversion to a future
+    {
+        int n = 0;
+
+        just().then( [&] { n = 5; } ).then( [&] { ++n; } ).get();
+
+        assert( n == 6 );
+
+        auto f = just( 2 ).then( []( int x ) { return std::make_tuple( x, x + 1 ); } ).then( []( int a, int b ) { return a * b; } ).start();
+
+        assert( f.get() == 6 );
+
+        ThenableFuture<int> g = just( 3 ).then( []( int x ) noexcept { return x; } );
+
+        assert( g.get() == 3 );
+    }
+
+    //Starting with a launch policy
+    {
+        assert( just( 3 ).then( []( int x ) { return x + 1; } ).start( then_launch::detached ).get() == 4 );
+        assert( just( 3 ).then( []( int x ) { return x + 1; } ).start( std::launch::deferred ).get() == 4 );
+    }
+
+    //Exceptions skip the rest of the chain
+    {
+        bool threw = false;
+
+        try {
+            just( 1 ).then( []( int ) -> int { throw error(); } ).then( []( int x ) { return x; } ).get();
+
+        } catch( error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+    }
+
+    //Futures returned from a callback, and move-only values
+    {
+        auto l = just( 1 ).then( []( int x ) { return make_ready_future( x + 1 ); } ).then( []( int x ) { return x * 2; } );
+
+        assert( std::move( l ).get() == 4 );
+
+        auto f = just( std::unique_ptr<int>( new int( 4 ))).then( []( std::unique_ptr<int> p ) { return *p; } ).start();
+
+        assert( f.get() == 4 );
+    }
+
+    //A chain of noexcept callbacks is started like a noexcept callback
+    {
+        auto f = just( 1 ).then( []( int x ) noexcept { return x + 1; } ).then( []( int x ) noexcept { return x * 2; } ).start( then_launch::immediate );
+
+        assert( f.is_ready() && f.get() == 4 );
+    }
+
+    std::cout << "ok" << std::endl;
+}
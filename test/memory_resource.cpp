@@ -0,0 +1,123 @@
+#include <thenable/experimental.hpp>
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+
+using namespace thenable;
+
+static std::atomic<long> global_allocations{ 0 };
+
+void *operator new( std::size_t n ) {
+    ++global_allocations;
+
+    if( void *p = std::malloc( n ? n : 1 )) {
+        return p;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete( void *p ) noexcept {
+    std::free( p );
+}
+
+void operator delete( void *p, std::size_t ) noexcept {
+    std::free( p );
+}
+
+class counting_resource : public std::pmr::memory_resource {
+        void *do_allocate( size_t n, size_t a ) override {
+            ++allocations;
+            ++live;
+
+            return std::pmr::new_delete_resource()->allocate( n, a );
+        }
+
+        void do_deallocate( void *p, size_t n, size_t a ) override {
+            --live;
+
+            std::pmr::new_delete_resource()->deallocate( p, n, a );
+        }
+
+        bool do_is_equal( const std::pmr::memory_resource &other ) const noexcept override {
+            return this == &other;
+        }
+
+    public:
+        std::atomic<long> allocations{ 0 }, live{ 0 };
+};
+
+int main() {
+    counting_resource resource;
+
+    assert( get_memory_resource() == nullptr );
+
+    {
+        memory_resource_guard guard( &resource );
+
+        assert( get_memory_resource() == &resource );
+
+        //A chain allocates nothing from the global heap while a resource is set
+        {
+            long before = global_allocations;
+
+            {
+                ThenablePromise<int> p;
+
+                auto f = p.get_future().then( []( int x ) { return x + 1; }, then_launch::immediate )
+                          .then( []( int x ) { return x * 2; }, then_launch::immediate );
+
+                p.set_value( 1 );
+
+                assert( f.get() == 4 );
+            }
+
+            assert( global_allocations == before );
+            assert( resource.allocations > 0 && resource.live == 0 );
+        }
+
+        //Blocks allocated here can be released on other threads
+        {
+            experimental::ThreadPool pool( 2 );
+
+            ThenablePromise<int> p;
+
+            auto f = p.get_future().then( []( int x ) { return x + 1; }, then_launch::detached )
+                      .then( []( int x ) { return x + 1; }, pool );
+
+            p.set_value( 1 );
+
+            assert( f.get() == 3 );
+        }
+    }
+
+    assert( get_memory_resource() == nullptr );
+
+    //The other threads can still be letting go of their last references
+    for( int i = 0; i < 1000 && resource.live != 0; ++i ) {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ));
+    }
+
+    assert( resource.live == 0 );
+
+    //Promises constructed with an allocator
+    {
+        ThenablePromise<int> p( std::allocator_arg, std::pmr::polymorphic_allocator<char>( &resource ));
+
+        long before = resource.allocations;
+
+        auto f = p.get_future();
+
+        p.set_value( 9 );
+
+        assert( f.get() == 9 );
+        assert( resource.allocations >= before );
+
+        static_assert( std::uses_allocator<ThenablePromise<int>, std::allocator<int>>::value, "promises take allocators" );
+    }
+
+    assert( resource.live == 0 );
+
+    std::cout << "ok" << std::endl;
+}
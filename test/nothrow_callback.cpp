@@ -0,0 +1,103 @@
+#include <thenable/thenable.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+using namespace thenable;
+
+struct error {};
+
+struct throws_on_move {
+    int value;
+
+    explicit throws_on_move( int v ) noexcept : value( v ) {}
+
+    throws_on_move( throws_on_move && ) noexcept( false ) {
+        throw error();
+    }
+};
+
+int main() {
+    auto nothrow  = []( int x ) noexcept { return x; };
+    auto throwing = []( int x ) { return x; };
+
+    static_assert( detail::nothrow_callback<int, decltype( nothrow ), detail::take_tag>::value, "noexcept callbacks are detected" );
+    static_assert( !detail::nothrow_callback<int, decltype( throwing ), detail::take_tag>::value, "other callbacks aren't" );
+
+    for( auto policy : { then_launch::immediate, then_launch::detached } ) {
+        //noexcept callbacks mixed with callbacks that throw
+        ThenablePromise<int> p;
+
+        auto f = p.get_future().then( []( int x ) noexcept { return x + 1; }, policy )
+                  .then( []( int ) -> int { throw error(); }, policy )
+                  .then( []( int x ) noexcept { return x; }, policy );
+
+        p.set_value( 1 );
+
+        bool threw = false;
+
+        try {
+            f.get();
+
+        } catch( error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+
+        //An exception upstream of a noexcept callback is still passed on
+        ThenablePromise<void> q;
+
+        auto g = q.get_future().then( []() noexcept { return 3; }, policy );
+
+        q.set_exception( std::make_exception_ptr( error()));
+
+        threw = false;
+
+        try {
+            g.get();
+
+        } catch( error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+    }
+
+    //A noexcept callback whose result throws while it's being stored still fails the future instead of terminating
+    for( auto policy : { then_launch::immediate, then_launch::detached } ) {
+        ThenablePromise<int> p;
+
+        auto f = p.get_future().then( []( int x ) noexcept { return throws_on_move( x ); }, policy );
+
+        p.set_value( 1 );
+
+        bool threw = false;
+
+        try {
+            f.get();
+
+        } catch( error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+    }
+
+    //Ready futures, shared futures and joins
+    {
+        assert( make_ready_future( 2 ).then( []( int x ) noexcept { return x + 1; } ).get() == 3 );
+        assert( make_ready_future( 2 ).then( []( int x ) noexcept { return make_ready_future( x + 1 ); } ).get() == 3 );
+
+        auto s = make_ready_future( std::string( "ab" )).share();
+
+        assert( s.then( []( const std::string &v ) noexcept { return v.size(); } ).get() == 2 );
+
+        auto all = await_all( std::make_tuple( make_ready_future( 1 ), make_ready_future( 2 )));
+
+        assert( all.then( []( int a, int b ) noexcept { return a + b; } ).get() == 3 );
+    }
+
+    std::cout << "ok" << std::endl;
+}
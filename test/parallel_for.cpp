@@ -0,0 +1,95 @@
+#include <thenable/experimental.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <functional>
+#include <numeric>
+
+using namespace thenable;
+
+int main() {
+    //Every index is visited exactly once
+    {
+        std::vector<std::atomic<int>> hits( 50000 );
+
+        parallel_for( 0, 50000, [&]( int i ) { ++hits[i]; } ).get();
+
+        for( auto &h : hits ) {
+            assert( h == 1 );
+        }
+
+        parallel_for( 5, 5, []( int ) { assert( false ); } ).get();
+    }
+
+    //Iterators, with the calling thread taking part
+    {
+        std::vector<int> data( 1000 );
+
+        std::iota( data.begin(), data.end(), 0 );
+
+        std::atomic<long> sum{ 0 };
+
+        parallel_for( participate, data.begin(), data.end(), [&]( int &x ) { sum += x; } ).get();
+
+        assert( sum == 999 * 1000 / 2 );
+    }
+
+    //An exception from any index fails the whole loop
+    {
+        bool threw = false;
+
+        try {
+            parallel_for( size_t( 0 ), size_t( 100 ), []( size_t i ) {
+                if( i == 42 ) {
+                    throw std::runtime_error( "x" );
+                }
+            } ).get();
+
+        } catch( std::runtime_error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+    }
+
+    //parallel_invoke gives one future per functor, in order
+    {
+        std::vector<std::function<int()>> fns;
+
+        for( int i = 0; i < 1000; ++i ) {
+            fns.push_back( [i] { return i; } );
+        }
+
+        auto r = parallel_invoke( fns );
+
+        for( int i = 0; i < 1000; ++i ) {
+            assert( r[i].get() == i );
+        }
+
+        experimental::ThreadPool pool( 4 );
+
+        std::atomic<int> count{ 0 };
+
+        parallel_for( pool, 0, 10000, [&]( int ) { ++count; } ).get();
+
+        assert( count == 10000 );
+
+        auto s = parallel_invoke( participate, pool, fns );
+
+        assert( s[500].get() == 500 );
+
+        std::vector<std::function<ThenableFuture<int>()>> nested;
+
+        nested.push_back( [] {
+            ThenablePromise<int> p;
+
+            p.set_value( 9 );
+
+            return p.get_future();
+        } );
+
+        assert( parallel_invoke( pool, nested )[0].get() == 9 );
+    }
+
+    std::cout << "ok" << std::endl;
+}
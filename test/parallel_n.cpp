@@ -0,0 +1,86 @@
+#include <thenable/experimental.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+using namespace thenable;
+
+int main() {
+    //Results, void and exceptions each end up in their own future
+    {
+        auto t = parallel_n( 2, [] { return 1; }, [] {}, [] { return std::string( "x" ); }, []() -> int { throw std::runtime_error( "e" ); } );
+
+        assert( std::get<0>( t ).get() == 1 );
+
+        std::get<1>( t ).get();
+
+        assert( std::get<2>( t ).get() == "x" );
+
+        bool threw = false;
+
+        try {
+            std::get<3>( t ).get();
+
+        } catch( std::runtime_error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+    }
+
+    //The calling thread takes part, and with a concurrency of one it runs everything
+    {
+        std::thread::id seen;
+
+        auto t = parallel_n( participate, 1, [&] {
+            seen = std::this_thread::get_id();
+
+            return 2;
+        } );
+
+        assert( seen == std::this_thread::get_id());
+        assert( std::get<0>( t ).get() == 2 );
+
+        auto f = [] { return 3; };
+
+        auto u = parallel2( participate, f, f );
+
+        assert( std::get<0>( u ).get() + std::get<1>( u ).get() == 6 );
+    }
+
+    //Every functor is claimed exactly once when there are fewer workers than functors
+    {
+        experimental::ThreadPool pool( 3 );
+
+        std::atomic<int> a{ 0 }, b{ 0 }, c{ 0 }, d{ 0 }, e{ 0 }, f{ 0 };
+
+        auto t = parallel_n( participate, pool, 4, [&] { ++a; }, [&] { ++b; }, [&] { ++c; }, [&] { ++d; }, [&] { ++e; }, [&] { ++f; } );
+
+        std::get<0>( t ).get();
+        std::get<1>( t ).get();
+        std::get<2>( t ).get();
+        std::get<3>( t ).get();
+        std::get<4>( t ).get();
+        std::get<5>( t ).get();
+
+        assert( a == 1 && b == 1 && c == 1 && d == 1 && e == 1 && f == 1 );
+
+        auto x = parallel2( pool, [] { return 7; } );
+
+        assert( std::get<0>( x ).get() == 7 );
+    }
+
+    //A concurrency of zero, as hardware_concurrency may report, still runs everything
+    {
+        auto t = parallel_n( 0, [] { return 1; }, [] { return 2; } );
+
+        assert( std::get<0>( t ).get() + std::get<1>( t ).get() == 3 );
+
+        auto u = parallel2_n( participate, 0, [] { return 4; } );
+
+        assert( std::get<0>( u ).get() == 4 );
+    }
+
+    std::cout << "ok" << std::endl;
+}
@@ -0,0 +1,119 @@
+#include <thenable/experimental.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+using namespace thenable;
+
+int main() {
+    //Callbacks on ready futures run inline for then_launch::immediate
+    {
+        auto f = make_ready_future( 41 );
+
+        assert( f.valid() && f.is_ready());
+
+        auto g = f.then( []( int x ) { return x + 1; }, then_launch::immediate );
+
+        assert( !f.valid() && g.is_ready());
+        assert( g.get() == 42 );
+
+        auto s = make_ready_future( std::string( "ab" )).then( []( std::string v ) { return v + "c"; }, then_launch::immediate );
+
+        assert( s.get() == "abc" );
+
+        int hit = 0;
+
+        make_ready_future().then( [&] { ++hit; }, then_launch::immediate ).get();
+
+        assert( hit == 1 );
+    }
+
+    //The default policy still launches them, instead of running them on the calling thread
+    {
+        std::promise<void> gate;
+
+        std::shared_future<void> opened = gate.get_future().share();
+
+        auto id = std::this_thread::get_id();
+
+        auto f = make_ready_future( 1 ).then( [opened, id]( int x ) {
+            opened.wait();
+
+            return std::this_thread::get_id() != id ? x : 0;
+        } );
+
+        assert( !f.is_ready());
+
+        gate.set_value();
+
+        assert( f.get() == 1 );
+    }
+
+    //Exceptional futures, and callbacks that throw
+    {
+        auto e = make_exceptional_future<int>( std::runtime_error( "x" )).then( []( int x ) { return x; } );
+
+        bool threw = false;
+
+        try {
+            e.get();
+
+        } catch( std::runtime_error &r ) {
+            threw = std::string( r.what()) == "x";
+        }
+
+        assert( threw );
+
+        auto t = make_ready_future( 1 ).then( []( int ) -> int { throw std::logic_error( "y" ); } );
+
+        threw = false;
+
+        try {
+            t.get();
+
+        } catch( std::logic_error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+    }
+
+    //Every other policy still behaves the same
+    {
+        bool ran = false;
+
+        auto d = make_ready_future( 5 ).then( [&]( int x ) {
+            ran = true;
+
+            return x + 1;
+        }, std::launch::deferred );
+
+        assert( !ran );
+        assert( d.get() == 6 && ran );
+
+        assert( make_ready_future( 5 ).then( []( int x ) { return x + 1; }, std::launch::async ).get() == 6 );
+        assert( make_ready_future( 5 ).then( []( int x ) { return x + 2; }, then_launch::detached ).get() == 7 );
+
+        experimental::ThreadPool pool( 2 );
+
+        assert( make_ready_future( 5 ).then( []( int x ) { return x + 4; }, pool ).get() == 9 );
+    }
+
+    //Callbacks returning futures, move-only values and references
+    {
+        assert( make_ready_future( 2 ).then( []( int x ) { return make_ready_future( x * 3 ); } ).get() == 6 );
+
+        auto u = make_ready_future( std::unique_ptr<int>( new int( 4 ))).then( []( std::unique_ptr<int> p ) { return *p; } );
+
+        assert( u.get() == 4 );
+
+        int x = 3;
+
+        auto r = make_ready_future( 0 ).then( [&]( int ) -> int & { return x; } );
+
+        assert( &r.get() == &x );
+    }
+
+    std::cout << "ok" << std::endl;
+}
@@ -0,0 +1,84 @@
+#include <thenable/thenable.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+using namespace thenable;
+
+int main() {
+    //A value written before the status is published is visible to anyone who sees it ready
+    for( int round = 0; round < 1000; ++round ) {
+        ThenablePromise<std::string> p;
+
+        auto s = p.get_future().share();
+
+        std::thread t( [&p, round] { p.set_value( std::to_string( round )); } );
+
+        while( !s.is_ready()) {
+            std::this_thread::yield();
+        }
+
+        assert( s.get() == std::to_string( round ));
+
+        t.join();
+    }
+
+    //Readers of a ready shared future from many threads
+    {
+        ThenablePromise<int> p;
+
+        auto s = p.get_future().share();
+
+        p.set_value( 7 );
+
+        std::vector<std::thread> threads;
+
+        std::atomic<long> total{ 0 };
+
+        for( int t = 0; t < 4; ++t ) {
+            threads.emplace_back( [s, &total] {
+                for( int i = 0; i < 100000; ++i ) {
+                    assert( s.is_ready());
+
+                    total += s.get();
+                }
+            } );
+        }
+
+        for( auto &t : threads ) {
+            t.join();
+        }
+
+        assert( total == 7L * 4 * 100000 );
+        assert( s.wait_for( std::chrono::seconds( 0 )) == std::future_status::ready );
+    }
+
+    //Exceptions are published the same way
+    {
+        ThenablePromise<int> p;
+
+        auto f = p.get_future();
+
+        std::thread t( [&p] { p.set_exception( std::make_exception_ptr( std::runtime_error( "x" ))); } );
+
+        while( !f.is_ready()) {
+            std::this_thread::yield();
+        }
+
+        bool threw = false;
+
+        try {
+            f.get();
+
+        } catch( std::runtime_error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+
+        t.join();
+    }
+
+    std::cout << "ok" << std::endl;
+}
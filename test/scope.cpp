@@ -0,0 +1,87 @@
+#include <thenable/experimental.hpp>
+
+#include <cassert>
+#include <iostream>
+
+using namespace thenable;
+
+static int request( int i ) {
+    ThenablePromise<int> p;
+    ThenableFuture<int>  f;
+
+    {
+        scope s;
+
+        assert( get_memory_resource() == s.resource());
+
+        f = p.get_future();
+
+        for( int j = 0; j < 15; ++j ) {
+            f = f.then( []( int x ) { return x + 1; }, then_launch::immediate );
+        }
+
+        auto all = await_all( std::make_tuple( std::move( f ), make_ready_future( 1 )), then_launch::immediate );
+
+        f = all.then( []( int a, int b ) { return a + b; }, then_launch::immediate );
+    }
+
+    //The chain outlives the scope that allocated it
+    assert( get_memory_resource() == nullptr );
+
+    p.set_value( i );
+
+    return f.get();
+}
+
+int main() {
+    for( int i = 0; i < 1000; ++i ) {
+        assert( request( i ) == i + 16 );
+    }
+
+    //Large allocations, released on other threads
+    {
+        experimental::ThreadPool pool( 2 );
+
+        ThenableFuture<std::vector<int>> f;
+
+        {
+            scope s;
+
+            std::vector<ThenableFuture<int>> fs;
+
+            for( int i = 0; i < 500; ++i ) {
+                fs.push_back( make_ready_future( i ).then( []( int x ) { return x; }, pool ));
+            }
+
+            f = await_all( std::move( fs ), pool );
+        }
+
+        auto v = f.get();
+
+        assert( v.size() == 500 && v[499] == 499 );
+    }
+
+    //Nested scopes
+    {
+        scope a;
+
+        auto fa = make_ready_future( 1 ).then( []( int x ) { return x; }, std::launch::deferred );
+
+        {
+            scope b;
+
+            assert( get_memory_resource() == b.resource());
+
+            auto fb = make_ready_future( 2 ).then( []( int x ) { return x; }, std::launch::deferred );
+
+            assert( fb.get() == 2 );
+        }
+
+        assert( get_memory_resource() == a.resource());
+        assert( fa.get() == 1 );
+    }
+
+    assert( get_memory_resource() == nullptr );
+
+    std::cout << "ok" << std::endl;
+}
@@ -0,0 +1,60 @@
+#include <thenable/thenable.hpp>
+
+#include <cassert>
+#include <iostream>
+
+using namespace thenable;
+
+static void chain( int i ) {
+    ThenablePromise<int> p;
+
+    auto f = p.get_future().then( []( int x ) { return x + 1; }, then_launch::immediate );
+
+    p.set_value( i );
+
+    assert( f.get() == i + 1 );
+}
+
+int main() {
+    //Once warmed up, a steady stream of chains is served entirely from the pool
+    {
+        for( int i = 0; i < 100; ++i ) {
+            chain( i );
+        }
+
+        pool_stats before = get_pool_stats();
+
+        for( int i = 0; i < 10000; ++i ) {
+            chain( i );
+        }
+
+        pool_stats after = get_pool_stats();
+
+        assert( after.allocations > before.allocations );
+        assert( after.misses == before.misses );
+    }
+
+    //Blocks allocated on one thread and freed on another, by threads that then exit
+    {
+        std::vector<std::thread> threads;
+
+        for( int t = 0; t < 4; ++t ) {
+            threads.emplace_back( [] {
+                for( int i = 0; i < 5000; ++i ) {
+                    auto f = make_ready_future( i ).then( []( int x ) { return x; }, then_launch::detached )
+                                                   .then( []( int x ) { return x * 2; } );
+
+                    assert( f.get() == i * 2 );
+                }
+            } );
+        }
+
+        for( auto &t : threads ) {
+            t.join();
+        }
+    }
+
+    assert( get_pool_stats().hit_rate() > 0.5 );
+
+    std::cout << "ok" << std::endl;
+}
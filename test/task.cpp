@@ -0,0 +1,157 @@
+#include <thenable/thenable.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+#ifdef THENABLE_HAS_COROUTINES
+
+using namespace thenable;
+
+static task<int> add( ThenableFuture<int> a, ThenableFuture<int> b ) {
+    int x = co_await std::move( a );
+    int y = co_await b;
+
+    co_return x + y;
+}
+
+static task<void> fail() {
+    co_await make_ready_future( 1 );
+
+    throw std::runtime_error( "x" );
+}
+
+static task<std::string> nested( ThenablePromise<int> &p ) {
+    int v = co_await p;
+    int w = co_await add( make_ready_future( v ), make_ready_future( 1 ));
+
+    co_return std::to_string( w );
+}
+
+static task<int> shared( ThenableSharedFuture<int> f ) {
+    const int &v = co_await f;
+
+    co_return v * 2;
+}
+
+static task<int> deep( int n ) {
+    if( n == 0 ) {
+        co_return 0;
+    }
+
+    co_return 1 + co_await deep( n - 1 );
+}
+
+static task<int> lazy( bool &started ) {
+    started = true;
+
+    co_return 1;
+}
+
+int main() {
+    //Suspends until the futures are resolved on another thread
+    {
+        ThenablePromise<int> a, b;
+
+        ThenableFuture<int> f = add( a.get_future(), b.get_future());
+
+        assert( !f.is_ready());
+
+        std::thread t( [&] {
+            a.set_value( 1 );
+            b.set_value( 2 );
+        } );
+
+        assert( f.get() == 3 );
+
+        t.join();
+    }
+
+    //Tasks don't start until they're awaited or converted
+    {
+        bool started = false;
+
+        {
+            auto t = lazy( started );
+        }
+
+        assert( !started );
+
+        assert( lazy( started ).get() == 1 && started );
+    }
+
+    //Exceptions, including broken promises
+    {
+        bool threw = false;
+
+        try {
+            fail().get();
+
+        } catch( std::runtime_error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+
+        ThenableFuture<int> f;
+
+        {
+            ThenablePromise<int> p;
+
+            f = add( p.get_future(), make_ready_future( 1 ));
+        }
+
+        bool broken = false;
+
+        try {
+            f.get();
+
+        } catch( std::future_error &e ) {
+            broken = e.code() == std::future_errc::broken_promise;
+        }
+
+        assert( broken );
+    }
+
+    //Awaiting promises, shared futures and other tasks
+    {
+        ThenablePromise<int> p;
+
+        auto f = nested( p ).then( []( std::string s ) { return s + "!"; } );
+
+        p.set_value( 41 );
+
+        assert( f.get() == "42!" );
+
+        ThenablePromise<int> q;
+
+        auto s = q.get_future().share();
+
+        ThenableFuture<int> a = shared( s ), b = shared( s );
+
+        q.set_value( 5 );
+
+        assert( a.get() == 10 && b.get() == 10 );
+
+        assert( deep( 1000 ).get() == 1000 );
+    }
+
+    //Deferred futures are run by the awaiting coroutine
+    {
+        ThenableFuture<int> f = add( make_ready_future( 1 ).then( []( int x ) { return x + 1; }, std::launch::deferred ), make_ready_future( 1 ));
+
+        assert( f.get() == 3 );
+    }
+
+    std::cout << "ok" << std::endl;
+}
+
+#else
+
+int main() {
+    std::cout << "coroutines aren't supported" << std::endl;
+
+    return 77;
+}
+
+#endif
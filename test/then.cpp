@@ -0,0 +1,254 @@
+#include <thenable/thenable.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace thenable;
+
+int main() {
+    //Continuations registered before the promise is resolved
+    {
+        ThenablePromise<int> p;
+
+        auto f = p.then( []( int x ) { return x + 1; } ).then( []( int x ) { return x * 2; } );
+
+        p.set_value( 3 );
+
+        assert( f.get() == 8 );
+    }
+
+    //Every launch policy
+    {
+        ThenablePromise<int> p;
+
+        auto f = p.then( []( int x ) { return std::to_string( x ); }, then_launch::detached );
+
+        p.set_value( 3 );
+
+        assert( f.get() == "3" );
+
+        ThenablePromise<int> q;
+
+        auto g = q.then( []( int x ) { return x + 1; }, std::launch::deferred )
+                  .then( []( int x ) { return x + 1; }, std::launch::deferred );
+
+        q.set_value( 1 );
+
+        assert( g.get() == 3 );
+
+        ThenablePromise<int> r;
+
+        auto h = r.then( []( int x ) { return x + 1; }, std::launch::deferred )
+                  .then( []( int x ) { return x + 1; }, std::launch::async );
+
+        r.set_value( 5 );
+
+        assert( h.get() == 7 );
+    }
+
+    //Exceptions skip the callbacks after them
+    {
+        ThenablePromise<int> p;
+
+        bool ran = false;
+
+        auto f = p.then( []( int ) -> int { throw std::runtime_error( "x" ); } ).then( [&]( int x ) {
+            ran = true;
+
+            return x;
+        } );
+
+        p.set_value( 1 );
+
+        bool threw = false;
+
+        try {
+            f.get();
+
+        } catch( std::runtime_error & ) {
+            threw = true;
+        }
+
+        assert( threw && !ran );
+    }
+
+    //A promise destroyed without a value breaks its continuations
+    {
+        ThenableFuture<int> f;
+
+        {
+            ThenablePromise<int> p;
+
+            f = p.then( []( int x ) { return x; } );
+        }
+
+        bool broken = false;
+
+        try {
+            f.get();
+
+        } catch( std::future_error &e ) {
+            broken = e.code() == std::future_errc::broken_promise;
+        }
+
+        assert( broken );
+    }
+
+    //Callbacks returning futures are unwrapped
+    {
+        ThenablePromise<int> p, k;
+
+        auto f = p.then( [&k]( int ) { return k.get_future(); } ).then( []( int x ) { return x + 1; } );
+
+        p.set_value( 1 );
+        k.set_value( 41 );
+
+        assert( f.get() == 42 );
+    }
+
+    //Shared futures give every continuation the value
+    {
+        ThenablePromise<std::string> p;
+
+        auto s = p.get_future().share();
+
+        auto a = s.then( []( const std::string &v ) { return v.size(); } );
+        auto b = s.then( []( std::string v ) { return v + "!"; } );
+
+        p.set_value( "hey" );
+
+        assert( a.get() == 3 && b.get() == "hey!" && s.get() == "hey" );
+    }
+
+    //A long chain of continuations on a pending promise
+    {
+        ThenablePromise<int> p;
+
+        ThenableFuture<int> f = p.get_future();
+
+        for( int i = 0; i < 1000; ++i ) {
+            f = f.then( []( int x ) { return x + 1; } );
+        }
+
+        p.set_value( 0 );
+
+        assert( f.get() == 1000 );
+    }
+
+    //Many pending continuations don't hold a thread each
+    {
+        std::vector<ThenablePromise<int>> ps( 2000 );
+        std::vector<ThenableFuture<int>>  fs;
+
+        for( auto &p : ps ) {
+            fs.push_back( p.then( []( int x ) { return x + 1; } ));
+        }
+
+        for( size_t i = 0; i < ps.size(); ++i ) {
+            ps[i].set_value( static_cast<int>( i ));
+        }
+
+        for( size_t i = 0; i < fs.size(); ++i ) {
+            assert( fs[i].get() == static_cast<int>( i ) + 1 );
+        }
+    }
+
+    //Plain std::futures are adapted
+    {
+        auto f = to_thenable( std::async( std::launch::async, [] { return 2; } )).then( []( int x ) { return x + 1; } );
+
+        assert( f.get() == 3 );
+
+        auto g = to_thenable( std::async( std::launch::deferred, [] { return 2; } )).then( []( int x ) { return x + 1; }, std::launch::deferred );
+
+        assert( g.get() == 3 );
+    }
+
+    //Converting back to standard futures, and taking over std::promises
+    {
+        ThenablePromise<int> p, k;
+
+        std::future<int> f = to_std_future( p.get_future());
+
+        auto s = k.get_future().share();
+
+        std::shared_future<int> sf = to_std_future( s );
+
+        assert( f.wait_for( std::chrono::seconds( 0 )) == std::future_status::timeout );
+
+        p.set_value( 4 );
+        k.set_value( 6 );
+
+        assert( f.get() == 4 && sf.get() == 6 && s.get() == 6 );
+
+        std::promise<int> fresh;
+
+        ThenablePromise<int> q = to_thenable( std::move( fresh ));
+
+        auto g = q.then( []( int x ) { return x * 2; } );
+
+        q.set_value( 5 );
+
+        assert( g.get() == 10 );
+
+        //Someone already waits on the std::promise, so they get the result instead
+        std::promise<std::string> taken;
+
+        std::future<std::string> waiting = taken.get_future();
+
+        ThenablePromise<std::string> r( std::move( taken ));
+
+        bool retrieved = false;
+
+        try {
+            r.get_future();
+
+        } catch( std::future_error &e ) {
+            retrieved = e.code() == std::future_errc::future_already_retrieved;
+        }
+
+        assert( retrieved );
+
+        r.set_value( "hi" );
+
+        assert( waiting.get() == "hi" );
+
+        std::promise<void> broken;
+
+        std::future<void> w = broken.get_future();
+
+        {
+            ThenablePromise<void> dropped( std::move( broken ));
+        }
+
+        bool threw = false;
+
+        try {
+            w.get();
+
+        } catch( std::future_error &e ) {
+            threw = e.code() == std::future_errc::broken_promise;
+        }
+
+        assert( threw );
+
+        assert( to_std_future( ThenablePromise<void>().then( [] {}, std::launch::deferred )).wait_for( std::chrono::seconds( 0 )) == std::future_status::deferred );
+    }
+
+    //wait_for on a pending state
+    {
+        ThenablePromise<int> p;
+
+        auto f = p.get_future();
+
+        assert( f.wait_for( std::chrono::milliseconds( 1 )) == std::future_status::timeout );
+
+        p.set_value( 1 );
+
+        assert( f.is_ready());
+    }
+
+    std::cout << "ok" << std::endl;
+}
@@ -0,0 +1,83 @@
+#include <thenable/experimental.hpp>
+
+#include <cassert>
+#include <iostream>
+
+using namespace thenable;
+using experimental::ThreadPool;
+
+static_assert( detail::is_executor<ThreadPool>::value, "ThreadPool is an executor" );
+
+int main() {
+    //Everything submitted runs before the pool is destroyed
+    {
+        std::atomic<int> count{ 0 };
+
+        {
+            ThreadPool pool( 2 );
+
+            for( int i = 0; i < 10000; ++i ) {
+                pool.submit( [&count] { ++count; } );
+            }
+        }
+
+        assert( count == 10000 );
+    }
+
+    {
+        ThreadPool pool( 4 );
+
+        assert( pool.size() == 4 );
+
+        //Continuations on the pool
+        std::vector<ThenableFuture<int>> fs;
+
+        for( int i = 0; i < 2000; ++i ) {
+            ThenablePromise<int> p;
+
+            fs.push_back( then( p.get_future(), []( int x ) { return x * 2; }, pool ));
+
+            p.set_value( i );
+        }
+
+        long total = 0;
+
+        for( auto &f : fs ) {
+            total += f.get();
+        }
+
+        assert( total == 2000L * 1999 );
+
+        //Tasks submitted from workers go to their own deque, and can be stolen by the others
+        std::atomic<int> nested{ 0 };
+
+        ThenablePromise<void> done;
+
+        pool.submit( [&] {
+            for( int i = 0; i < 1000; ++i ) {
+                pool.submit( [&] {
+                    if( ++nested == 1000 ) {
+                        done.set_value();
+                    }
+                } );
+            }
+        } );
+
+        done.get_future().get();
+
+        assert( nested == 1000 );
+
+        //parallel_n on the pool
+        std::atomic<int> sum{ 0 };
+
+        auto p = parallel_n( pool, 3, [&] { sum += 1; }, [&] { sum += 2; }, [&] { sum += 3; } );
+
+        std::get<0>( p ).get();
+        std::get<1>( p ).get();
+        std::get<2>( p ).get();
+
+        assert( sum == 6 );
+    }
+
+    std::cout << "ok" << std::endl;
+}
@@ -0,0 +1,129 @@
+#include <thenable/experimental.hpp>
+
+#include <cassert>
+#include <iostream>
+
+using namespace thenable;
+using detail::unique_task;
+
+struct large {
+    char buffer[200];
+    int  *out;
+
+    void operator()() {
+        *out += buffer[0];
+    }
+};
+
+struct counted {
+    static int live;
+
+    int *out;
+
+    explicit counted( int *o ) : out( o ) { ++live; }
+
+    counted( counted &&other ) noexcept : out( other.out ) { ++live; }
+
+    ~counted() { --live; }
+
+    void operator()() {
+        ++*out;
+    }
+};
+
+int counted::live = 0;
+
+int main() {
+    int x = 0;
+
+    //Small callables are stored inline and moved with the task
+    {
+        unique_task t( [&x] { ++x; } );
+
+        assert( t );
+
+        t();
+
+        unique_task u( std::move( t ));
+
+        assert( !t && u );
+
+        u();
+
+        t = std::move( u );
+
+        t();
+
+        assert( x == 3 );
+    }
+
+    //Large callables are boxed
+    {
+        large l{};
+
+        l.buffer[0] = 5;
+        l.out       = &x;
+
+        unique_task t( l );
+        unique_task u = std::move( t );
+
+        u();
+
+        assert( x == 8 );
+    }
+
+    //Moving never copies or leaks the callable
+    {
+        unique_task t{ counted( &x ) };
+
+        assert( counted::live == 1 );
+
+        unique_task u( std::move( t ));
+
+        assert( counted::live == 1 );
+
+        u();
+
+        t = std::move( u );
+    }
+
+    assert( counted::live == 0 );
+
+    //Captures are released with the task
+    {
+        auto p = std::make_shared<int>( 0 );
+
+        std::vector<unique_task> tasks;
+
+        for( int i = 0; i < 100; ++i ) {
+            tasks.emplace_back( [p] { ++*p; } );
+        }
+
+        for( auto &t : tasks ) {
+            t();
+        }
+
+        assert( *p == 100 );
+
+        tasks.clear();
+
+        assert( p.use_count() == 1 );
+    }
+
+    //Move-only captures can go through the thread pool
+    {
+        experimental::ThreadPool pool( 4 );
+
+        ThenablePromise<int> p;
+
+        auto f = p.get_future();
+
+        std::unique_ptr<int> value( new int( 7 ));
+
+        pool.submit( [v = std::move( value ), q = std::move( p )]() mutable { q.set_value( *v ); } );
+
+        assert( f.get() == 7 );
+    }
+
+    std::cout << "ok" << std::endl;
+}
@@ -0,0 +1,117 @@
+#include <thenable/thenable.hpp>
+
+#include <cassert>
+#include <iostream>
+#include <string>
+
+using namespace thenable;
+
+int main() {
+    //The first future to resolve wins, and later ones are ignored
+    {
+        std::vector<ThenablePromise<int>> ps( 3 );
+        std::vector<ThenableFuture<int>>  fs;
+
+        for( auto &p : ps ) {
+            fs.push_back( p.get_future());
+        }
+
+        auto any = when_any( std::move( fs ));
+
+        assert( !any.is_ready());
+
+        ps[1].set_value( 7 );
+        ps[0].set_value( 3 );
+
+        auto r = any.get();
+
+        assert( r.first == 1 && r.second == 7 );
+    }
+
+    //void futures only give the index
+    {
+        std::vector<ThenablePromise<void>> ps( 2 );
+        std::vector<ThenableFuture<void>>  fs;
+
+        for( auto &p : ps ) {
+            fs.push_back( p.get_future());
+        }
+
+        auto any = when_any( std::move( fs ));
+
+        ps[1].set_value();
+
+        assert( any.get() == 1 );
+    }
+
+    //Exceptions win like values, and an empty vector can never resolve
+    {
+        ThenablePromise<int> p;
+
+        std::vector<ThenableSharedFuture<int>> fs{ p.get_future().share() };
+
+        auto any = when_any( std::move( fs ));
+
+        p.set_exception( std::make_exception_ptr( std::runtime_error( "x" )));
+
+        bool threw = false;
+
+        try {
+            any.get();
+
+        } catch( std::runtime_error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+
+        bool empty = false;
+
+        try {
+            when_any( std::vector<ThenableFuture<int>>()).get();
+
+        } catch( std::future_error & ) {
+            empty = true;
+        }
+
+        assert( empty );
+    }
+
+    //The losers can outlive their promises
+    {
+        ThenableFuture<std::pair<size_t, int>> any;
+
+        {
+            ThenablePromise<int> a, b;
+
+            std::vector<ThenableFuture<int>> fs;
+
+            fs.push_back( a.get_future());
+            fs.push_back( b.get_future());
+
+            any = when_any( std::move( fs ));
+
+            b.set_value( 2 );
+        }
+
+        assert( any.get().second == 2 );
+    }
+
+    //Tuples of futures give a variant
+    {
+        ThenablePromise<int>         a;
+        ThenablePromise<std::string> b;
+        ThenablePromise<void>        c;
+
+        auto any = when_any( std::make_tuple( a.get_future(), b.get_future(), c.get_future()));
+
+        b.set_value( "s" );
+        a.set_value( 1 );
+
+        auto v = any.get();
+
+        assert( v.index() == 1 && std::get<1>( v ) == "s" );
+    }
+
+    std::cout << "ok" << std::endl;
+}
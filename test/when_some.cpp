@@ -0,0 +1,94 @@
+#include <thenable/thenable.hpp>
+
+#include <cassert>
+#include <iostream>
+
+using namespace thenable;
+
+int main() {
+    //Resolves with the first k values, in the order they arrived, skipping failures
+    {
+        std::vector<ThenablePromise<int>> ps( 5 );
+        std::vector<ThenableFuture<int>>  fs;
+
+        for( auto &p : ps ) {
+            fs.push_back( p.get_future());
+        }
+
+        auto some = when_some( 2, std::move( fs ));
+
+        ps[3].set_value( 3 );
+
+        assert( !some.is_ready());
+
+        ps[0].set_exception( std::make_exception_ptr( std::runtime_error( "x" )));
+
+        assert( !some.is_ready());
+
+        ps[4].set_value( 4 );
+
+        auto v = some.get();
+
+        assert( v.size() == 2 && v[0].first == 3 && v[1].first == 4 && v[1].second == 4 );
+    }
+
+    //A deadline resolves it with whatever has arrived so far
+    {
+        std::vector<ThenablePromise<int>> ps( 3 );
+        std::vector<ThenableFuture<int>>  fs;
+
+        for( auto &p : ps ) {
+            fs.push_back( p.get_future());
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        auto some = when_some( 3, std::move( fs ), start + std::chrono::milliseconds( 100 ));
+
+        ps[1].set_value( 1 );
+
+        auto v = some.get();
+
+        assert( v.size() == 1 && v[0].first == 1 );
+        assert( std::chrono::steady_clock::now() - start >= std::chrono::milliseconds( 90 ));
+    }
+
+    //Once k can't be reached anymore it fails with the first exception
+    {
+        std::vector<ThenablePromise<void>> ps( 2 );
+        std::vector<ThenableFuture<void>>  fs;
+
+        for( auto &p : ps ) {
+            fs.push_back( p.get_future());
+        }
+
+        auto some = when_some( 2, std::move( fs ), std::chrono::system_clock::now() + std::chrono::seconds( 10 ));
+
+        ps[1].set_exception( std::make_exception_ptr( std::runtime_error( "a" )));
+        ps[0].set_exception( std::make_exception_ptr( std::logic_error( "b" )));
+
+        bool threw = false;
+
+        try {
+            some.get();
+
+        } catch( std::runtime_error & ) {
+            threw = true;
+        }
+
+        assert( threw );
+    }
+
+    //Nothing is needed for k of zero
+    {
+        ThenablePromise<int> p;
+
+        auto s = p.get_future().share();
+
+        std::vector<ThenableSharedFuture<int>> fs{ s, s };
+
+        assert( when_some( 0, std::move( fs )).get().empty());
+    }
+
+    std::cout << "ok" << std::endl;
+}